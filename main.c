@@ -4,11 +4,38 @@
 #include <stdio.h>
 #include <math.h>
 #include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+// Build with -DSIM_FIXED_POINT=1 for simulation results that match bit for bit across platforms and compilers, see sim_length()
+#ifndef SIM_FIXED_POINT
+#define SIM_FIXED_POINT 0
+#endif
+
+#if SIM_FIXED_POINT
+#ifdef __FAST_MATH__
+#error "SIM_FIXED_POINT needs IEEE float arithmetic, build without -ffast-math"
+#endif
+// Fused multiply-adds round differently from separate operations
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#endif
+
+// Build with -DSIM_IMPACT_EVENTS=0 to test every player projectile against the enemies on every tick, as before impacts were
+// scheduled. A projectile then explodes where it is on the first tick it overlaps an enemy instead of at the exact contact
+// point, so the two builds play differently, see projectiles_update()
+#ifndef SIM_IMPACT_EVENTS
+#define SIM_IMPACT_EVENTS 1
+#endif
 
 #define SKYBLUE_LIGHT \
     (Color) { .r = 162, .g = 215, .b = 255, .a = 255 }
 
-float g_frame_time = 0;
 Vector2 g_mouse_position = {0};
 
 struct
@@ -38,7 +65,7 @@ typedef struct
     float twinkle_offset;
 } Star_t;
 
-struct
+typedef struct
 {
     int star_count;
     Star_t stars[200];
@@ -50,7 +77,9 @@ struct
     float twinkle_speed;
     int padding_x;
     float screen_scroll;
-} g_stars_data = {
+} Stars_Data_t;
+
+const Stars_Data_t g_stars_data_defaults = {
     .screen_scroll = 0,
     .speeds_count = 3,
     .twinkle_speed = 2.5f,
@@ -65,18 +94,11 @@ struct
     .star_speeds = {0},
     .padding_x = 0};
 
-float g_transition_time = 0;     // The amount of time spent in the current transition
-float g_transition_duration = 0; // The amount of time that will be spent in this transition
-float g_transition_progress = 0; // How many percent of the transition duration has passed
-
-Gamestate_e g_gamestate_previous = STATE_MAIN_MENU;
-Gamestate_e g_gamestate_current = STATE_MAIN_MENU;
-
+// Describes an explosion effect, spawning one bursts it into particles
 typedef struct
 {
     Vector2 position;
     float time_lifetime;
-    float time_alive;
     float size;
     Color color;
 } Explosion_t;
@@ -94,34 +116,52 @@ struct
 struct
 {
     bool weapon_ready_alert;
+    bool threaded_simulation; // Run levels on a separate thread at a fixed tick rate
 } g_player_settings = {
-    .weapon_ready_alert = false};
+    .weapon_ready_alert = false,
+    .threaded_simulation = true};
 
-struct
+enum
 {
-    const int EXPLOSIONS_COUNT;
-
-    Explosion_t explosions[50];
-} g_explosions_data = {
-    .EXPLOSIONS_COUNT = 50,
-    .explosions = {0}};
+    PARTICLES_COUNT = 4096
+};
 
+// Sparks and debris, one array per field so the update loop vectorizes
 typedef struct
 {
-    short damage;
-    float radius;
-    bool is_explosive;
-    Explosion_t explosion;
-} Projectile_Data_Player_t;
+    float position_x[PARTICLES_COUNT];
+    float position_y[PARTICLES_COUNT];
+    float velocity_x[PARTICLES_COUNT];
+    float velocity_y[PARTICLES_COUNT];
+    float time_alive[PARTICLES_COUNT];
+    float time_lifetime[PARTICLES_COUNT];
+    float size[PARTICLES_COUNT];
+    Color color[PARTICLES_COUNT];
+
+    int oldest;     // Slots are handed out in a ring, so the next one always holds the oldest particle
+    int live_count;  // The slots just before the oldest one that may still hold a live particle, everything before them is dead
+    int alive_count; // Kept up to date by the spawns and updates, so the telemetry never has to count them
+} Particle_Pool_t;
 
 typedef struct
 {
-    int damage;
-    int max_health;
-    float radius;
-    float speed;
-    bool is_destroyable;
-} Projectile_Data_Enemy_t;
+    const float DRAG;
+    const float SPARKS_PER_SIZE; // Sparks spawned per pixel of explosion radius
+    const int SPARKS_MIN;
+    const int SPARKS_MAX;
+    const float DEBRIS_FRACTION;
+
+    Particle_Pool_t pool;
+} Particles_Data_t;
+
+const Particles_Data_t g_particles_data_defaults = {
+    .DRAG = 2.5f,
+    .SPARKS_PER_SIZE = 0.8f,
+    .SPARKS_MIN = 8,
+    .SPARKS_MAX = 512,
+    .DEBRIS_FRACTION = 0.2f,
+
+    .pool = {0}};
 
 typedef enum
 {
@@ -141,22 +181,50 @@ typedef enum
     PROJECTILE_TYPE_ENEMY_COUNT,
 } Projectile_Type_Enemy_e;
 
+typedef struct
+{
+    float radius;
+    bool is_explosive;
+    Explosion_t explosion;
+} Projectile_Data_Player_t;
+
+typedef struct
+{
+    int damage;
+    int max_health;
+    float radius;
+    float speed;
+    bool is_destroyable;
+    bool intercepted_by[PROJECTILE_TYPE_PLAYER_COUNT]; // Player projectile types that collide with a destroyable projectile and damage it
+} Projectile_Data_Enemy_t;
+
+// Entities store small enums as bytes and their bools as bits of a flags byte, see flags_has()
+enum
+{
+    PROJECTILE_FLAG_SHOULD_REMOVE = 1 << 0,
+    PROJECTILE_FLAG_IS_LAUNCHED = 1 << 1, // Set once the projectile starts moving
+};
+
 typedef struct
 {
     float time_wait;
     Vector2 velocity;
     Vector2 position;
-    Projectile_Type_Player_e type;
-    bool should_remove;
+
+    // Where and when the projectile started moving, its impacts are predicted from these
+    float time_launched;
+    Vector2 launch_position;
+
+    unsigned char type; // Projectile_Type_Player_e
+    unsigned char flags;
 } Projectile_Player_t;
 
 typedef struct
 {
-    int health;
     Vector2 velocity;
     Vector2 position;
-    Projectile_Type_Enemy_e type;
-    bool should_remove;
+    short health;
+    unsigned char type; // Projectile_Type_Enemy_e
 } Projectile_Enemy_t;
 
 typedef struct
@@ -195,16 +263,113 @@ typedef enum
     ENEMY_TYPE_COUNT
 } Enemy_Type_e;
 
+enum
+{
+    ENEMY_FLAG_HAS_ATTEMPTED_FIRST_SHOT = 1 << 0,
+};
+
 typedef struct
 {
-    bool has_attempted_first_shot;
-    Enemy_Type_e type;
-    int current_health;
-    Vector2 position;
+    unsigned char type; // Enemy_Type_e
+    unsigned char flags;
+    short current_health;
+
+    Vector2 spawn_position; // Enemies move straight down at a constant speed, see enemy_get_position()
+    float time_spawned;
+
     float time_last_fired;
-    float time_healthbar_visible;
+    float time_last_damaged;
 } Enemy_t;
 
+bool flags_has(unsigned char flags, unsigned char flag)
+{
+    return (flags & flag) != 0;
+}
+
+void flags_set(unsigned char *flags, unsigned char flag, bool value)
+{
+    *flags = value ? *flags | flag : *flags & ~flag;
+}
+
+// One bit per slot of an entity pool, set while the slot holds a live entity
+enum
+{
+    POOL_WORDS_COUNT = 8 // Enough for the 512 player projectiles
+};
+
+typedef struct
+{
+    unsigned long long words[POOL_WORDS_COUNT];
+    int live_count;
+} Pool_Occupancy_t;
+
+bool pool_is_occupied(const Pool_Occupancy_t *POOL, int slot)
+{
+    return (POOL->words[slot >> 6] >> (slot & 63)) & 1;
+}
+
+void pool_occupy(Pool_Occupancy_t *pool, int slot)
+{
+    if (!pool_is_occupied(pool, slot))
+    {
+        pool->words[slot >> 6] |= 1ull << (slot & 63);
+        pool->live_count++;
+    }
+}
+
+void pool_vacate(Pool_Occupancy_t *pool, int slot)
+{
+    if (pool_is_occupied(pool, slot))
+    {
+        pool->words[slot >> 6] &= ~(1ull << (slot & 63));
+        pool->live_count--;
+    }
+}
+
+void pool_clear(Pool_Occupancy_t *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+}
+
+// The first occupied slot at or after the given one, -1 when there is none. Loops over a pool as
+// for (int i = pool_next(&pool, 0); i >= 0; i = pool_next(&pool, i + 1))
+int pool_next(const Pool_Occupancy_t *POOL, int slot)
+{
+    int word = slot >> 6;
+    if (word >= POOL_WORDS_COUNT)
+    {
+        return -1;
+    }
+
+    unsigned long long bits = POOL->words[word] & (~0ull << (slot & 63));
+    while (bits == 0)
+    {
+        if (++word == POOL_WORDS_COUNT)
+        {
+            return -1;
+        }
+        bits = POOL->words[word];
+    }
+
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+// The lowest free slot, -1 when all of the pool's slots are taken
+int pool_first_free(const Pool_Occupancy_t *POOL, int slots_count)
+{
+    for (int word = 0; word * 64 < slots_count; word++)
+    {
+        unsigned long long free_bits = ~POOL->words[word];
+        if (free_bits != 0)
+        {
+            int slot = word * 64 + __builtin_ctzll(free_bits);
+            return slot < slots_count ? slot : -1;
+        }
+    }
+
+    return -1;
+}
+
 typedef struct
 {
     Color color;
@@ -241,7 +406,7 @@ typedef struct
     float damage;
 } Weapon_Upgrade_Stat_Multipliers_t;
 
-struct
+typedef struct
 {
     int upgrade_cost[WEAPON_TYPE_COUNT];
     float cost_scaling;
@@ -265,7 +430,9 @@ struct
     unsigned char symbol_width;
     unsigned char symbol_height;
     short symbol_draw_area_y;
-} g_weapons_data =
+} Weapons_Data_t;
+
+const Weapons_Data_t g_weapons_data_defaults =
     {
         .upgrade_transition_duration = 0.15f,
         .upgrade_transitions = {0},
@@ -393,7 +560,7 @@ struct
                         .damage = 60,
                         .spread = 0}}};
 
-struct
+typedef struct
 {
     const short OFFSET_Y; // The padding between the player and the bottom of the screen
     short player_current_health;
@@ -411,7 +578,9 @@ struct
     float transaction_timer_buffer;
     float transaction_duration;
     int transaction_money_remaining;
-} g_player_data = {
+} Player_Data_t;
+
+const Player_Data_t g_player_data_defaults = {
     .OFFSET_Y = 200,
     .player_current_health = 20,
     .player_max_health = 20,
@@ -429,7 +598,69 @@ struct
     .transaction_timer = -1,
     .transaction_money_remaining = 0};
 
-struct
+// Shared by every game, never changes
+const Enemy_Data_t g_enemy_database[ENEMY_TYPE_COUNT] = {
+    {// NONE
+     .color = {0},
+     .damage = 0,
+     .max_health = 0,
+     .height = 0,
+     .width = 0,
+     .can_shoot = false,
+     .shoot_range = 0,
+     .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
+     .time_firing_interval = 0,
+     .speed = 0},
+
+    {// LIGHT
+     .color = LIGHTGRAY,
+     .damage = 4,
+     .max_health = 25,
+     .height = 40,
+     .width = 25,
+     .can_shoot = false,
+     .shoot_range = 0,
+     .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
+     .time_firing_interval = 0,
+     .speed = 25},
+
+    {// MEDIUM
+     .color = GRAY,
+     .damage = 10,
+     .max_health = 60,
+     .height = 60,
+     .width = 35,
+     .shoot_range = 0,
+     .can_shoot = false,
+     .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
+     .time_firing_interval = 0,
+     .speed = 25},
+
+    {// SHOOTER
+     .color = RED,
+     .damage = 4,
+     .max_health = 30,
+     .height = 40,
+     .width = 35,
+     .can_shoot = true,
+     .shoot_range = 250,
+     .projectile_type = PROJECTILE_TYPE_ENEMY_SHOOTER,
+     .time_firing_interval = 999,
+     .speed = 25},
+
+    {// HEAVY_SHOOTER
+     .color = DARKPURPLE,
+     .damage = 5,
+     .max_health = 45,
+     .height = 50,
+     .width = 40,
+     .can_shoot = true,
+     .shoot_range = 9999,
+     .projectile_type = PROJECTILE_TYPE_ENEMY_HEAVY_SHOOTER,
+     .time_firing_interval = 999,
+     .speed = 25}};
+
+typedef struct
 {
     const int ENEMIES_COUNT;
     const float ENEMY_SPEED;
@@ -437,12 +668,22 @@ struct
     int tallest_enemy_height;
 
     Enemy_t enemies[128];
+    Pool_Occupancy_t occupancy; // Slots whose type is not none, the enemies still alive
+    float time_elapsed; // Time the level has been running for, the enemy positions are evaluated from it
 
-    Enemy_Data_t enemy_database[ENEMY_TYPE_COUNT];
+    // Enemies that are in view or dead, in slot order so they update in the same order as the slots
+    unsigned char active_indices[128];
+    int active_count;
+
+    // Enemies still above the screen, the one to enter it first is last
+    unsigned char dormant_indices[128];
+    int dormant_count;
 
     float health_bar_visibility_duration;
     short healthbar_width;
-} g_enemies_data = {
+} Enemies_Data_t;
+
+const Enemies_Data_t g_enemies_data_defaults = {
     .health_bar_visibility_duration = 2.5f,
     .healthbar_width = 60,
 
@@ -450,140 +691,126 @@ struct
 
     .ENEMIES_COUNT = 128,
     .enemies = {0},
+    .time_elapsed = 0,
+    .active_count = 0,
+    .dormant_count = 0};
+
+// Shared by every game, never changes. The damage grows with the weapon levels, so each game keeps its own
+const Projectile_Data_Player_t g_player_projectile_database[PROJECTILE_TYPE_PLAYER_COUNT] = {
+    {// NONE
+     .radius = 0,
+     .is_explosive = false,
+     .explosion = {
+         .position = (Vector2){.x = -1, .y = -1},
+         .size = 30,
+         .time_lifetime = 0.15f,
+         .color = (Color){.a = 255, .b = 0, .g = 200, .r = 255}}},
+
+    {// BURST
+     .radius = 3,
+     .is_explosive = false,
+     .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 15, .time_lifetime = 0.10f, .color = (Color){.a = 255, .b = 175, .g = 255, .r = 255}}},
+
+    {// CANNON
+     .radius = 8,
+     .is_explosive = false,
+     .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 20, .time_lifetime = 0.10f, .color = (Color){.a = 255, .b = 175, .g = 255, .r = 255}}},
+
+    {// AUTOCANNON
+     .radius = 5,
+     .is_explosive = true,
+     .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 50, .time_lifetime = 0.15f, .color = (Color){.a = 255, .b = 0, .g = 160, .r = 255}}},
+
+    {// TORPEDO
+     .radius = 20,
+     .is_explosive = true,
+     .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 150, .time_lifetime = 0.3f, .color = (Color){.a = 255, .b = 0, .g = 160, .r = 255}}}};
+
+const Projectile_Data_Enemy_t g_enemy_projectile_database[PROJECTILE_TYPE_ENEMY_COUNT] = {
+    {// NONE
+     .is_destroyable = false,
+     .max_health = 0,
+     .damage = 0,
+     .radius = 0,
+     .speed = 0},
+
+    {// SHOOTER
+     .is_destroyable = false,
+     .max_health = 0,
+     .damage = 5,
+     .radius = 4,
+     .speed = 60},
+
+    {// HEAVY SHOOTER
+     .is_destroyable = true,
+     .max_health = 15,
+     .damage = 8,
+     .radius = 15,
+     .speed = 50,
+     .intercepted_by = {[PROJECTILE_TYPE_PLAYER_BURST] = true}}};
 
-    .enemy_database = {
-        {// NONE
-         .color = {0},
-         .damage = 0,
-         .max_health = 0,
-         .height = 0,
-         .width = 0,
-         .can_shoot = false,
-         .shoot_range = 0,
-         .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
-         .time_firing_interval = 0,
-         .speed = 0},
-
-        {// LIGHT
-         .color = LIGHTGRAY,
-         .damage = 4,
-         .max_health = 25,
-         .height = 40,
-         .width = 25,
-         .can_shoot = false,
-         .shoot_range = 0,
-         .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
-         .time_firing_interval = 0,
-         .speed = 25},
-
-        {// MEDIUM
-         .color = GRAY,
-         .damage = 10,
-         .max_health = 60,
-         .height = 60,
-         .width = 35,
-         .shoot_range = 0,
-         .can_shoot = false,
-         .projectile_type = PROJECTILE_TYPE_ENEMY_NONE,
-         .time_firing_interval = 0,
-         .speed = 25},
-
-        {// SHOOTER
-         .color = RED,
-         .damage = 4,
-         .max_health = 30,
-         .height = 40,
-         .width = 35,
-         .can_shoot = true,
-         .shoot_range = 250,
-         .projectile_type = PROJECTILE_TYPE_ENEMY_SHOOTER,
-         .time_firing_interval = 999,
-         .speed = 25},
-
-        {// HEAVY_SHOOTER
-         .color = DARKPURPLE,
-         .damage = 5,
-         .max_health = 45,
-         .height = 50,
-         .width = 40,
-         .can_shoot = true,
-         .shoot_range = 9999,
-         .projectile_type = PROJECTILE_TYPE_ENEMY_HEAVY_SHOOTER,
-         .time_firing_interval = 999,
-         .speed = 25}}};
-
-struct
+typedef struct
 {
     int player_projectile_count;
 
     Projectile_Player_t player_projectiles[512];
-    Projectile_Data_Player_t player_projectile_database[PROJECTILE_TYPE_PLAYER_COUNT];
+    Pool_Occupancy_t player_occupancy;
+    short player_projectile_damage[PROJECTILE_TYPE_PLAYER_COUNT]; // Set from the weapon levels by weapons_init()
 
     int enemy_projectile_count;
 
     Projectile_Enemy_t enemy_projectiles[128];
-    Projectile_Data_Enemy_t enemy_projectile_database[PROJECTILE_TYPE_PLAYER_COUNT];
-} g_projectiles_data = {
+    Pool_Occupancy_t enemy_occupancy;
+} Projectiles_Data_t;
+
+const Projectiles_Data_t g_projectiles_data_defaults = {
     .player_projectiles = {0},
     .player_projectile_count = 512,
-    .player_projectile_database =
-        {{// NONE
-          .damage = 0,
-          .radius = 0,
-          .is_explosive = false,
-          .explosion = {
-              .position = (Vector2){.x = -1, .y = -1},
-              .size = 30,
-              .time_lifetime = 0.15f,
-              .time_alive = 0,
-              .color = (Color){.a = 255, .b = 0, .g = 200, .r = 255}}},
-
-         {// BURST
-          .damage = 4,
-          .radius = 3,
-          .is_explosive = false,
-          .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 15, .time_lifetime = 0.10f, .time_alive = 0, .color = (Color){.a = 255, .b = 175, .g = 255, .r = 255}}},
-
-         {// CANNON
-          .damage = 500,
-          .radius = 8,
-          .is_explosive = false,
-          .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 20, .time_lifetime = 0.10f, .time_alive = 0, .color = (Color){.a = 255, .b = 175, .g = 255, .r = 255}}},
-
-         {// AUTOCANNON
-          .damage = 4,
-          .radius = 5,
-          .is_explosive = true,
-          .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 50, .time_lifetime = 0.15f, .time_alive = 0, .color = (Color){.a = 255, .b = 0, .g = 160, .r = 255}}},
-
-         {// TORPEDO
-          .damage = 200,
-          .radius = 20,
-          .is_explosive = true,
-          .explosion = {.position = (Vector2){.x = -1, .y = -1}, .size = 150, .time_lifetime = 0.3f, .time_alive = 0, .color = (Color){.a = 255, .b = 0, .g = 160, .r = 255}}}},
+    .player_projectile_damage = {0, 4, 500, 4, 200},
 
     .enemy_projectile_count = 128,
-    .enemy_projectiles = {0},
-    .enemy_projectile_database = {{// NONE
-                                   .is_destroyable = false,
-                                   .max_health = 0,
-                                   .damage = 0,
-                                   .radius = 0,
-                                   .speed = 0},
-
-                                  {// SHOOTER
-                                  .is_destroyable = false,
-                                   .max_health = 0,
-                                   .damage = 5,
-                                   .radius = 4,
-                                   .speed = 60},
-
-                                  {// HEAVY SHOOTER
-                                   .is_destroyable = true,
-                                   .max_health = 15,
-                                   .damage = 8,
-                                   .radius = 15,
-                                   .speed = 50}}};
+    .enemy_projectiles = {0}};
+
+// Uniform grid bucketing the player projectiles by their center, so interception only tests nearby pairs
+typedef struct
+{
+    const float CELL_SIZE;
+    const int COLUMNS_COUNT;
+    const int ROWS_COUNT;
+
+    int cell_starts[12 * 16 + 1]; // The projectiles of a cell are cell_projectiles[cell_starts[cell]] up to cell_starts[cell + 1]
+    short cell_projectiles[512];
+} Projectile_Grid_t;
+
+const Projectile_Grid_t g_projectile_grid_defaults = {
+    .CELL_SIZE = 50,
+    .COLUMNS_COUNT = 12,
+    .ROWS_COUNT = 16};
+
+typedef struct
+{
+    float time;
+    short projectile_i;
+    unsigned short generation;
+} Impact_Event_t;
+
+// The earliest contact of every launched player projectile with an enemy, in a min-heap ordered by time.
+// Derived from the projectiles and enemies, so it is rebuilt instead of saved
+typedef struct
+{
+    const int EVENTS_COUNT;
+
+    float impact_times[512]; // INFINITY if the projectile hits nothing on its course
+    short impact_enemies[512];
+    unsigned short generations[512]; // Bumped whenever the impact of a projectile changes, events of older generations are stale
+
+    Impact_Event_t events[2048];
+    int event_count;
+} Impact_Schedule_t;
+
+const Impact_Schedule_t g_impact_schedule_defaults = {
+    .EVENTS_COUNT = 2048,
+    .event_count = 0};
 
 typedef struct
 {
@@ -597,40 +824,29 @@ typedef struct
     float enemy_spawn_chance_factor[ENEMY_TYPE_COUNT];
 } Level_Data_t;
 
-struct
+typedef struct
 {
-    float spawn_y;
     float spawn_y_min;
 
-    float spawn_credits;
-    float total_spawn_credits;
-
-    float time_next_wave;
-
     float enemy_spawn_costs[ENEMY_TYPE_COUNT];
-    float enemy_spawn_chances[ENEMY_TYPE_COUNT];
 
     short current_level;
 
     short next_level;
     short max_level;
-} g_enemy_spawn_director = {
-    .spawn_y = 0,
-    .spawn_y_min = -100,
+} Enemy_Spawn_Director_t;
 
-    .spawn_credits = 0,
-    .total_spawn_credits = 0,
-
-    .time_next_wave = 0,
+const Enemy_Spawn_Director_t g_enemy_spawn_director_defaults = {
+    .spawn_y_min = -100,
 
-    .enemy_spawn_chances = {0},
     .enemy_spawn_costs = {999999, 10, 20, 20, 30},
 
     .next_level = 0, // TODO - Add win condition for when next_level passes max_level
     .max_level = 29,
     .current_level = 0};
 
-struct
+// Read by every game, a tool playing variants of a level hands its games a table of its own, see Game_t
+const struct
 {
     const int LEVEL_COUNT;
     Level_Data_t levels[30];
@@ -942,1874 +1158,7194 @@ struct
     }}};
 // clang-format on
 
-// Returns a random number between 0 and 1
-float rand_float()
+// An enemy of the precompiled spawn schedule of a level
+typedef struct
 {
-    return rand() / (float)RAND_MAX;
-}
+    float time;         // Level time the enemy spawns at, see Enemies_Data_t time_elapsed
+    unsigned char type; // Enemy_Type_e
+    Vector2 position;
+    float spawn_y;          // The band the position is redrawn in when it is taken at spawn time
+    float spawn_interval_y;
+} Spawn_Entry_t;
 
-float rand_range_float(float inclusive_min, float inclusive_max)
+// Spawn credits build up at a fixed rate, so every wave of a level is sampled when the level starts and
+// spawning only pops the entries that are due. Derived from the level and the seed, so it is rebuilt instead of saved
+typedef struct
 {
-    return rand_float() * (inclusive_max - inclusive_min) + inclusive_min;
-}
+    const int ENTRIES_COUNT;
 
-int rand_range_int(int inclusive_min, int exclusive_max)
-{
-    return (rand() % (exclusive_max - inclusive_min)) + inclusive_min;
-}
+    Spawn_Entry_t entries[256]; // Sorted by time
+    int entry_count;
+    int entry_next; // The first entry that has not spawned yet
 
-void shuffle_array_int(int array[], int element_count)
-{
-    for (int i = element_count - 1; i > 0; i--)
-    {
-        int j = rand() % (i + 1);
+    bool is_compiled;
+    short level;
+    unsigned long long seed;
+} Spawn_Schedule_t;
 
-        int temp = array[i];
-        array[i] = array[j];
-        array[j] = temp;
-    }
-}
+const Spawn_Schedule_t g_spawn_schedule_defaults = {
+    .ENTRIES_COUNT = 256,
+    .is_compiled = false};
 
-void explosion_spawn(const Vector2 POSITION, const float LIFETIME, const float SIZE, Color color)
+// The player input that a simulation tick reads instead of polling raylib, so that it can run on any thread
+typedef struct
 {
-    Explosion_t new_explosion = {0};
-    new_explosion.position = POSITION;
-    new_explosion.size = SIZE;
+    Vector2 mouse_position;                // The position that weapons aim towards
+    bool weapons_fired[WEAPON_TYPE_COUNT]; // If the firing key of each weapon was pressed
+    float time_scale;                      // Multiplier for the length of a tick
+
+    bool cheat_money;
+    bool cheat_kill_all;
+    bool cheat_end_level;
+    bool cheat_player_health;
+    bool cheat_planet_health;
+    bool cheat_next_level;
+    bool cheat_all_levels;
+    bool cheat_reset_levels;
+
+    bool debug_save_state;
+    bool debug_load_state;
+    bool debug_rewind_toggle;
+    int debug_rewind_steps; // Ticks to scrub forwards, negative to scrub backwards
+} Sim_Input_t;
 
-    new_explosion.color = color;
+typedef struct
+{
+    short player_current_health;
+    short player_max_health;
+    short planet_current_health;
+    short planet_max_health;
+    int money_displayed;
+    float player_rotation;
+    Color player_color;
 
-    new_explosion.time_lifetime = LIFETIME;
-    new_explosion.time_alive = 0;
+    bool is_rewinding;
+    int rewind_ticks_behind; // How far the displayed rewind state is behind the newest recorded tick
+    int rewind_ticks_recorded;
 
-    for (int i = 0; i < g_explosions_data.EXPLOSIONS_COUNT; i++)
-    {
-        if (g_explosions_data.explosions[i].time_alive < g_explosions_data.explosions[i].time_lifetime)
-        {
-            continue;
-        }
+    float turbo_speedup;
 
-        g_explosions_data.explosions[i] = new_explosion;
-        break;
-    }
-}
+    bool is_menu; // A menu is showing with no transition playing, the frame rate may drop while it is left alone
+} Sim_Hud_t;
 
-void explosions_update()
+// An immutable copy of everything that is drawn while a level is running
+typedef struct
 {
-    for (int i = 0; i < g_explosions_data.EXPLOSIONS_COUNT; i++)
-    {
-        if (g_explosions_data.explosions[i].time_alive >= g_explosions_data.explosions[i].time_lifetime)
-        {
-            continue;
-        }
+    unsigned long long tick;
+    bool is_final; // The level ended on this tick and the simulation thread has stopped
 
-        g_explosions_data.explosions[i].time_alive += g_frame_time;
-    }
-}
+    Enemy_t enemies[128];
+    Projectile_Player_t player_projectiles[512];
+    Projectile_Enemy_t enemy_projectiles[128];
+    Pool_Occupancy_t enemies_occupancy;
+    Pool_Occupancy_t player_projectiles_occupancy;
+    Pool_Occupancy_t enemy_projectiles_occupancy;
+    Particle_Pool_t particles;
+    Star_t stars[200];
+    Weapon_t weapons[WEAPON_TYPE_COUNT];
+    float symbol_alert_timers[WEAPON_TYPE_COUNT];
+    float enemies_time_elapsed;
+    float twinkle_x;
+    Sim_Hud_t hud;
+} Sim_Snapshot_t;
 
-void money_remove(int money)
+enum
 {
-    g_player_data.money -= money;
-    g_player_data.transaction_money_remaining += money;
+    SIM_SNAPSHOT_INDEX_MASK = 3,
+    SIM_SNAPSHOT_FRESH = 4 // Set in snapshot_shared when the reader has not seen that snapshot yet
+};
 
-    g_player_data.transaction_timer_buffer = 0;
+struct
+{
+    const float TICK_RATE;
+    const int MAX_TICKS_PER_UPDATE;
 
-    g_player_data.transaction_timer = g_player_data.transaction_duration;
-}
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
 
-void money_add(int money)
-{
-    g_player_data.money += money;
-    g_player_data.transaction_money_remaining -= money;
+    // Guarded by mutex
+    bool run_requested;
+    bool is_running;
+    bool should_quit;
+    Sim_Input_t pending_input;
 
-    g_player_data.transaction_timer_buffer = 0;
+    // Only touched by the main thread
+    bool is_started;
+    bool owns_simulation; // If the simulation thread currently owns the game state
 
-    g_player_data.transaction_timer = g_player_data.transaction_duration;
-}
+    unsigned long long tick;
 
-void money_update()
-{
-    if (g_player_data.transaction_timer < 0)
-    {
-        g_player_data.transaction_money_remaining = 0;
-        return;
-    }
+    // Triple buffer, the writer and reader each own one slot and swap it with the shared one
+    Sim_Snapshot_t snapshots[3];
+    atomic_int snapshot_shared;
+    int snapshot_back;
+    int snapshot_front;
+} g_sim_thread = {
+    .TICK_RATE = 120,
+    .MAX_TICKS_PER_UPDATE = 8,
 
-    int money_buffer = 0;
-    if (g_player_data.transaction_money_remaining > 0)
-    {
-        money_buffer = (int)floor((g_player_data.transaction_money_remaining * (g_frame_time + g_player_data.transaction_timer_buffer) / g_player_data.transaction_timer));
-    }
-    else
-    {
-        money_buffer = (int)ceil((g_player_data.transaction_money_remaining * (g_frame_time + g_player_data.transaction_timer_buffer) / g_player_data.transaction_timer));
-    }
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .condition = PTHREAD_COND_INITIALIZER,
 
-    if (money_buffer)
-    {
-        g_player_data.transaction_money_remaining -= money_buffer;
-        g_player_data.transaction_timer_buffer = 0;
-    }
-    else
-    {
-        g_player_data.transaction_timer_buffer += g_frame_time;
-    }
+    .run_requested = false,
+    .is_running = false,
+    .should_quit = false,
+    .pending_input = {.time_scale = 1},
 
-    g_player_data.transaction_timer -= g_frame_time;
-}
+    .is_started = false,
+    .owns_simulation = false,
 
-void weapons_init()
-{
-    for (size_t i = 0; i < WEAPON_TYPE_COUNT; i++)
-    {
-        Weapon_t *weapon = &g_weapons_data.weapons[i];
-        Weapon_Upgrade_Stats_t *base_stats = &g_weapons_data.base_stats[i];
-        Weapon_Upgrade_Stat_Multipliers_t *stat_multipliers = &g_weapons_data.stat_increase_mutlipliers;
+    .tick = 0,
 
-        weapon->ammo_count_max = base_stats->ammo_count_max * (1.0f + stat_multipliers->ammo_count_max * weapon->level_current);
+    .snapshot_back = 0,
+    .snapshot_shared = 1,
+    .snapshot_front = 2};
 
-        weapon->time_ammo_reload = base_stats->time_ammo_reload * (1.0f + stat_multipliers->time_ammo_reload * weapon->level_current);
+// Fast-forward that runs ticks back to back instead of at the tick rate, only the last tick of every slice is drawn
+struct
+{
+    const double SLICE_SECONDS; // Wall-clock time simulated for between two presented snapshots
 
-        weapon->time_projectile_interval = base_stats->time_projectile_interval * (1.0f + stat_multipliers->time_projectile_interval * weapon->level_current);
+    atomic_bool is_requested; // Written by the main thread while the key is held
+    float speedup;            // Simulated seconds per wall-clock second, 0 when not fast-forwarding. Only written by the thread owning the simulation
+} g_turbo = {
+    .SLICE_SECONDS = 1 / 60.0,
 
-        weapon->projectile_count = base_stats->projectile_count * (1.0f + stat_multipliers->projectile_count * weapon->level_current);
+    .is_requested = false,
+    .speedup = 0};
 
-        weapon->start_velocity = base_stats->start_velocity * (1.0f + stat_multipliers->start_velocity * weapon->level_current);
+// Where the draw functions read entity and HUD state from, either the live game or a snapshot
+struct
+{
+    const Enemy_t *enemies;
+    const Projectile_Player_t *player_projectiles;
+    const Projectile_Enemy_t *enemy_projectiles;
+    const Pool_Occupancy_t *enemies_occupancy;
+    const Pool_Occupancy_t *player_projectiles_occupancy;
+    const Pool_Occupancy_t *enemy_projectiles_occupancy;
+    const Particle_Pool_t *particles;
+    const Star_t *stars;
+    const Weapon_t *weapons;
+    const float *symbol_alert_timers;
+    float enemies_time_elapsed;
+    float twinkle_x;
+    Sim_Hud_t hud;
+} g_render_view = {0};
 
-        weapon->spread = base_stats->spread * (1.0f + stat_multipliers->spread * weapon->level_current);
+// Everything needed to continue a game exactly where it was saved, the databases are not included as they never change
+typedef struct
+{
+    short player_current_health;
+    short player_max_health;
+    short planet_current_health;
+    short planet_max_health;
+    Color player_color;
+    float player_rotation;
+    Vector2 player_center;
+    int money;
+    float transaction_timer;
+    float transaction_timer_buffer;
+    int transaction_money_remaining;
 
-        weapon->time_last_reload = 0;
+    int upgrade_cost[WEAPON_TYPE_COUNT];
+    Weapon_t weapons[WEAPON_TYPE_COUNT];
+    float upgrade_transitions[WEAPON_TYPE_COUNT];
+    float symbol_alert_timers[WEAPON_TYPE_COUNT];
+    short player_projectile_damage[PROJECTILE_TYPE_PLAYER_COUNT]; // Set from the weapon levels by weapons_init()
 
-        weapon->ammo_count = 0;
+    Enemy_t enemies[128];
+    float enemies_time_elapsed;
+    Projectile_Player_t player_projectiles[512];
+    Projectile_Enemy_t enemy_projectiles[128];
 
-        g_weapons_data.symbol_alert_timers[i] = 999;
+    unsigned long long spawn_schedule_seed; // The schedule is compiled again from the level and this seed
+    int spawn_entry_next;
+    short current_level;
+    short next_level;
 
-        g_projectiles_data.player_projectile_database[weapon->projectile_type].damage = base_stats->damage * (1.0f + stat_multipliers->damage * weapon->level_current);
-    }
-}
+    unsigned long long rng_state;
+} Save_State_t;
 
-void background_init()
+typedef struct
 {
-    g_stars_data.padding_x = g_window.width / 2;
+    char magic[4];
+    unsigned int version;
+    unsigned int state_size; // Catches layout changes that forgot to bump the version
+} Save_State_Header_t;
 
-    for (int i = 0; i < g_stars_data.star_count; i++)
-    {
-        g_stars_data.stars[i] = (Star_t){
-            .color_index = rand() % g_stars_data.color_count,
-            .position = (Vector2){.x = rand_range_int(-g_stars_data.padding_x - 5, g_window.width + g_stars_data.padding_x + 5), .y = rand_range_int(-5, g_window.height + 5)},
-            .radius = rand_range_int(1, 3),
-            .twinkle_offset = rand_float() * (PI * 2),
-            .speed_index = rand() % g_stars_data.speeds_count};
-    }
+struct
+{
+    const char MAGIC[4];
+    const unsigned int VERSION;
 
-    Vector2 base_speed = {.x = cos(135 * DEG2RAD), .y = sin(135 * DEG2RAD)};
-    base_speed = Vector2Scale(base_speed, 30);
+    const char *PROGRESS_PATH;
+    const char *QUICKSAVE_PATH;
+} g_save_files = {
+    .MAGIC = {'A', 'E', 'G', 'S'},
+    .VERSION = 6,
 
-    for (int i = 0; i < g_stars_data.speeds_count; i++)
-    {
-        g_stars_data.star_speeds[i] = Vector2Scale(base_speed, 1 + 0.2f * i);
-    }
-}
+    .PROGRESS_PATH = "progress.sav",
+    .QUICKSAVE_PATH = "quicksave.sav"};
 
-void player_init()
+typedef struct
 {
-    g_player_data.color = BLUE;
-    g_player_data.planet_current_health = g_player_data.planet_max_health;
-    g_player_data.player_current_health = g_player_data.player_max_health;
-    g_player_data.center = (Vector2){.x = g_window.width / 2, .y = g_window.height - g_player_data.OFFSET_Y};
-}
+    unsigned long long accumulators[4];
+    unsigned char buffer[32];
+    int buffer_size;
+    unsigned long long total_size;
+    unsigned long long seed;
+} Hash_State_t;
 
-void projectiles_init()
+typedef struct
 {
-    for (int i = 0; i < g_projectiles_data.player_projectile_count; i++)
-    {
-        g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-    }
-
-    for (int i = 0; i < g_projectiles_data.enemy_projectile_count; i++)
-    {
-        g_projectiles_data.enemy_projectiles[i].type = PROJECTILE_TYPE_ENEMY_NONE;
-    }
-}
+    float frame_time;
+    Sim_Input_t input;
+    unsigned long long checksum; // Checksum of the simulation state after the tick
+} Replay_Tick_t;
 
-void explosions_init()
+typedef struct
 {
-    for (int i = 0; i < g_explosions_data.EXPLOSIONS_COUNT; i++)
+    char magic[4];
+    unsigned int version;
+    unsigned int state_size;
+    unsigned int tick_size;
+    unsigned int tick_count;
+    unsigned int is_fixed_point; // Float and fixed point builds simulate differently
+    unsigned int is_impact_events; // And so do builds with and without scheduled impacts
+} Replay_Header_t;
+
+// A recorded level attempt, the state when its first tick started and the input of every tick
+struct
+{
+    const char MAGIC[4];
+    const unsigned int VERSION;
+
+    bool is_recording;
+
+    Save_State_t state_initial;
+    Replay_Tick_t *ticks;
+    int tick_count;
+    int tick_capacity;
+} g_replay = {
+    .MAGIC = {'A', 'E', 'G', 'R'},
+    .VERSION = 9,
+
+    .is_recording = false,
+
+    .ticks = NULL,
+    .tick_count = 0,
+    .tick_capacity = 0};
+
+// Rewind history of a running level, stored as run-length encoded XOR deltas between consecutive ticks
+// Every KEYFRAME_INTERVAL ticks the full state is stored instead, so that any tick can be rebuilt from at most that many deltas
+typedef struct
+{
+    int offset; // Start of the encoded state in g_rewind.bytes
+    int size;
+    bool is_keyframe;
+} Rewind_Entry_t;
+
+struct
+{
+    const int KEYFRAME_INTERVAL;
+    const int ENTRIES_COUNT; // 30 seconds at the simulation thread tick rate
+    const int BYTES_COUNT;   // Memory budget for the encoded states
+
+    Rewind_Entry_t entries[30 * 120];
+    int entry_first; // Index of the oldest entry, always a keyframe
+    int entry_count;
+
+    unsigned char bytes[16 * 1024 * 1024];
+    int byte_write_offset;
+
+    int ticks_since_keyframe;
+
+    bool is_scrubbing;
+    int scrub_index; // How many entries after the oldest entry the displayed state is
+
+    Save_State_t state_previous; // The last recorded state that the next delta is relative to
+    Save_State_t state_scratch;
+    unsigned char encode_buffer[3 * sizeof(Save_State_t) + 8]; // Worst case of alternating changed and unchanged bytes
+} g_rewind = {
+    .KEYFRAME_INTERVAL = 60,
+    .ENTRIES_COUNT = 30 * 120,
+    .BYTES_COUNT = 16 * 1024 * 1024,
+
+    .entry_first = 0,
+    .entry_count = 0,
+    .byte_write_offset = 0,
+    .ticks_since_keyframe = 0,
+
+    .is_scrubbing = false,
+    .scrub_index = 0};
+
+typedef struct
+{
+    unsigned long long ticks;
+    unsigned long long collision_tests;
+    int hits;                       // Player projectiles that struck an enemy or an enemy projectile
+    int overkill_damage;            // Damage dealt beyond the health enemies had left
+    int particles_evicted;          // Live particles replaced because the pool was full
+    int enemy_spawns_rejected;      // Enemies not spawned because every enemy slot was taken
+    int player_projectiles_dropped; // Shots lost because the pool was full
+    int enemy_projectiles_dropped;
+    int projectiles_culled; // Removed after leaving the screen
+
+    int peak_enemies;
+    int peak_player_projectiles;
+    int peak_enemy_projectiles;
+    int peak_particles;
+} Telemetry_Counters_t;
+
+// The recorders of the game played in the window: its rewind history in g_rewind, its replay in g_replay and its telemetry.
+// The rewind history and the replay are process wide, so only that game points at g_recorders. Headless games have none,
+// they never touch any recorder and run side by side on any thread
+typedef struct
+{
+    const char *replay_path;    // Every level attempt is recorded to this file when set
+    const char *telemetry_path; // The counters of every level attempt are appended as a CSV row
+} Game_Recorders_t;
+
+Game_Recorders_t g_recorders = {
+    .replay_path = NULL,
+    .telemetry_path = "telemetry.csv"};
+
+typedef struct
+{
+    unsigned long long state;
+    unsigned long long cosmetic_state; // Used by effects that must not change the gameplay random sequence
+} Rng_t;
+
+const Rng_t g_rng_defaults = {
+    .state = 0x9E3779B97F4A7C15ULL,
+    .cosmetic_state = 0xD1B54A32D192ED03ULL};
+
+typedef enum
+{
+    PLAYER_POLICY_NONE, // The mouse and keyboard play
+    PLAYER_POLICY_NEAREST_THREAT,
+    PLAYER_POLICY_LOWEST_HEALTH,
+    PLAYER_POLICY_GREEDY_AREA,
+    PLAYER_POLICY_COUNT
+} Player_Policy_e;
+
+// Everything one game owns, every function that reads or changes a game is handed it.
+// Games only share constant data: the databases and the level tables. Only the game played in the window has recorders,
+// so any number of the others can run side by side on different threads
+typedef struct
+{
+    float frame_time;
+    float transition_time;     // The amount of time spent in the current transition
+    float transition_duration; // The amount of time that will be spent in this transition
+    float transition_progress; // How many percent of the transition duration has passed
+
+    Gamestate_e gamestate_previous;
+    Gamestate_e gamestate_current;
+
+    Sim_Input_t sim_input;
+    Rng_t rng;
+
+    Stars_Data_t stars_data;
+    Particles_Data_t particles_data;
+    Weapons_Data_t weapons_data;
+    Player_Data_t player_data;
+    Enemies_Data_t enemies_data;
+    Projectiles_Data_t projectiles_data;
+    Projectile_Grid_t projectile_grid;
+    Impact_Schedule_t impact_schedule;
+    Enemy_Spawn_Director_t enemy_spawn_director;
+    Spawn_Schedule_t spawn_schedule;
+
+    Telemetry_Counters_t telemetry_counters; // Gameplay counters of the current level attempt
+
+    const Level_Data_t *levels;    // The level table played from, g_levels_data.levels unless a tool plays variants
+    Player_Policy_e player_policy; // Plays every tick of a running level in place of the input, see player_policy_apply()
+
+    Game_Recorders_t *recorders; // NULL for headless games, see Game_Recorders_t
+    bool is_unseen;              // Never drawn, it skips the cosmetic updates. Lookahead forks and environment instances
+} Game_t;
+
+// Copies the defaults in, the members with constants cannot be assigned
+void game_init(Game_t *game)
+{
+    memset(game, 0, sizeof(*game));
+
+    game->gamestate_previous = STATE_MAIN_MENU;
+    game->gamestate_current = STATE_MAIN_MENU;
+    game->sim_input.time_scale = 1;
+    game->rng = g_rng_defaults;
+    game->levels = g_levels_data.levels;
+
+    memcpy(&game->stars_data, &g_stars_data_defaults, sizeof(game->stars_data));
+    memcpy(&game->particles_data, &g_particles_data_defaults, sizeof(game->particles_data));
+    memcpy(&game->weapons_data, &g_weapons_data_defaults, sizeof(game->weapons_data));
+    memcpy(&game->player_data, &g_player_data_defaults, sizeof(game->player_data));
+    memcpy(&game->enemies_data, &g_enemies_data_defaults, sizeof(game->enemies_data));
+    memcpy(&game->projectiles_data, &g_projectiles_data_defaults, sizeof(game->projectiles_data));
+    memcpy(&game->projectile_grid, &g_projectile_grid_defaults, sizeof(game->projectile_grid));
+    memcpy(&game->impact_schedule, &g_impact_schedule_defaults, sizeof(game->impact_schedule));
+    memcpy(&game->enemy_spawn_director, &g_enemy_spawn_director_defaults, sizeof(game->enemy_spawn_director));
+    memcpy(&game->spawn_schedule, &g_spawn_schedule_defaults, sizeof(game->spawn_schedule));
+}
+
+enum
+{
+    RAND_NEXT_MAX = 0x7FFFFFFF
+};
+
+void rand_seed(Game_t *game, unsigned long long seed)
+{
+    // xorshift gets stuck on a zero state
+    game->rng.state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+// Scrambles a state into an unrelated one, for seeding a stream that has to be independent of the one it came from
+unsigned long long splitmix64(unsigned long long x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+    return x ^ (x >> 31);
+}
+
+// Returns a random number between 0 and RAND_NEXT_MAX
+// Uses xorshift64* instead of rand() so that the generator state can be saved with the rest of the game
+int rand_next_from(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return (int)((*state * 0x2545F4914F6CDD1DULL) >> 33);
+}
+
+int rand_next(Game_t *game)
+{
+    return rand_next_from(&game->rng.state);
+}
+
+// Returns a random number between 0 and 1
+float rand_float_from(unsigned long long *state)
+{
+    return rand_next_from(state) / (float)RAND_NEXT_MAX;
+}
+
+float rand_float(Game_t *game)
+{
+    return rand_float_from(&game->rng.state);
+}
+
+// Returns a random number between 0 and 1 from the cosmetic stream
+float rand_cosmetic_float(Game_t *game)
+{
+    return rand_next_from(&game->rng.cosmetic_state) / (float)RAND_NEXT_MAX;
+}
+
+float rand_range_float_from(unsigned long long *state, float inclusive_min, float inclusive_max)
+{
+    return rand_float_from(state) * (inclusive_max - inclusive_min) + inclusive_min;
+}
+
+float rand_range_float(Game_t *game, float inclusive_min, float inclusive_max)
+{
+    return rand_range_float_from(&game->rng.state, inclusive_min, inclusive_max);
+}
+
+// Q16.16 fixed point, only integer operations so every platform gets the same bits
+typedef int Fixed_t;
+
+enum
+{
+    FIXED_SHIFT = 16,
+    FIXED_ONE = 1 << FIXED_SHIFT,
+    FIXED_PI = 205887,
+    FIXED_HALF_PI = 102944,
+    FIXED_CORDIC_GAIN = 39797, // 1 / 1.6468, the growth of the CORDIC iterations
+    FIXED_CORDIC_STEPS = 16
+};
+
+// atan(2^-i) in Q16.16
+const Fixed_t FIXED_CORDIC_ANGLES[FIXED_CORDIC_STEPS] = {51472, 30386, 16055, 8150, 4091, 2047, 1024, 512, 256, 128, 64, 32, 16, 8, 4, 2};
+
+Fixed_t fixed_from_float(float value)
+{
+    return (Fixed_t)lrintf(value * FIXED_ONE);
+}
+
+float fixed_to_float(Fixed_t value)
+{
+    return value / (float)FIXED_ONE;
+}
+
+Fixed_t fixed_mul(Fixed_t a, Fixed_t b)
+{
+    return (Fixed_t)(((long long)a * b) >> FIXED_SHIFT);
+}
+
+Fixed_t fixed_div(Fixed_t a, Fixed_t b)
+{
+    return (Fixed_t)(((long long)a * FIXED_ONE) / b);
+}
+
+// IEEE 754 square roots are correctly rounded, so the double estimate is the same everywhere and the
+// integer correction makes the floor exact where doubles run out of precision
+unsigned long long fixed_isqrt(unsigned long long value)
+{
+    unsigned long long root = (unsigned long long)sqrt((double)value);
+
+    while (root * root > value)
+    {
+        root--;
+    }
+
+    while ((root + 1) * (root + 1) <= value)
+    {
+        root++;
+    }
+
+    return root;
+}
+
+// The square of a Q16.16 length is Q32.32, its integer square root is Q16.16 again
+Fixed_t fixed_length(Fixed_t x, Fixed_t y)
+{
+    return (Fixed_t)fixed_isqrt((unsigned long long)((long long)x * x + (long long)y * y));
+}
+
+void fixed_sin_cos(Fixed_t angle, Fixed_t *sin_out, Fixed_t *cos_out)
+{
+    // CORDIC converges within +-pi/2, the other half turn is the same rotation negated
+    angle %= 2 * FIXED_PI;
+    angle += angle > FIXED_PI ? -2 * FIXED_PI : angle < -FIXED_PI ? 2 * FIXED_PI : 0;
+
+    int sign = 1;
+    if (angle > FIXED_HALF_PI || angle < -FIXED_HALF_PI)
+    {
+        angle += angle > 0 ? -FIXED_PI : FIXED_PI;
+        sign = -1;
+    }
+
+    Fixed_t x = FIXED_CORDIC_GAIN;
+    Fixed_t y = 0;
+
+    for (int i = 0; i < FIXED_CORDIC_STEPS; i++)
+    {
+        // All bits set while the remaining angle is not negative, negating through it keeps the loop branch free
+        Fixed_t mask = ~(angle >> 31);
+
+        Fixed_t x_next = x + (((y >> i) ^ mask) - mask);
+        y = y - (((x >> i) ^ mask) - mask);
+        angle = angle + ((FIXED_CORDIC_ANGLES[i] ^ mask) - mask);
+        x = x_next;
+    }
+
+    *sin_out = sign * y;
+    *cos_out = sign * x;
+}
+
+// The simulation's square roots and rotations go through these, libm results differ between platforms
+float sim_length(Vector2 vector)
+{
+#if SIM_FIXED_POINT
+    return fixed_to_float(fixed_length(fixed_from_float(vector.x), fixed_from_float(vector.y)));
+#else
+    return Vector2Length(vector);
+#endif
+}
+
+Vector2 sim_normalize(Vector2 vector)
+{
+#if SIM_FIXED_POINT
+    Fixed_t x = fixed_from_float(vector.x);
+    Fixed_t y = fixed_from_float(vector.y);
+    Fixed_t length = fixed_length(x, y);
+
+    if (length == 0)
+    {
+        return (Vector2){0};
+    }
+
+    return (Vector2){.x = fixed_to_float(fixed_div(x, length)), .y = fixed_to_float(fixed_div(y, length))};
+#else
+    return Vector2Normalize(vector);
+#endif
+}
+
+Vector2 sim_rotate(Vector2 vector, float angle)
+{
+#if SIM_FIXED_POINT
+    Fixed_t x = fixed_from_float(vector.x);
+    Fixed_t y = fixed_from_float(vector.y);
+    Fixed_t sin_angle;
+    Fixed_t cos_angle;
+    fixed_sin_cos(fixed_from_float(angle), &sin_angle, &cos_angle);
+
+    return (Vector2){
+        .x = fixed_to_float(fixed_mul(x, cos_angle) - fixed_mul(y, sin_angle)),
+        .y = fixed_to_float(fixed_mul(x, sin_angle) + fixed_mul(y, cos_angle))};
+#else
+    return Vector2Rotate(vector, angle);
+#endif
+}
+
+int rand_range_int_from(unsigned long long *state, int inclusive_min, int exclusive_max)
+{
+    return (rand_next_from(state) % (exclusive_max - inclusive_min)) + inclusive_min;
+}
+
+int rand_range_int(Game_t *game, int inclusive_min, int exclusive_max)
+{
+    return rand_range_int_from(&game->rng.state, inclusive_min, exclusive_max);
+}
+
+void shuffle_array_int(Game_t *game, int array[], int element_count)
+{
+    for (int i = element_count - 1; i > 0; i--)
+    {
+        int j = rand_next(game) % (i + 1);
+
+        int temp = array[i];
+        array[i] = array[j];
+        array[j] = temp;
+    }
+}
+
+void particle_spawn(Game_t *game, const Vector2 POSITION, const Vector2 VELOCITY, const float LIFETIME, const float SIZE, const Color COLOR)
+{
+    Particle_Pool_t *pool = &game->particles_data.pool;
+    int i = pool->oldest;
+    pool->oldest = (pool->oldest + 1) % PARTICLES_COUNT;
+    if (pool->live_count < PARTICLES_COUNT)
+    {
+        pool->live_count++;
+    }
+
+    if (pool->time_alive[i] < pool->time_lifetime[i])
+    {
+        game->telemetry_counters.particles_evicted++;
+        pool->alive_count--;
+    }
+    if (LIFETIME > 0)
+    {
+        pool->alive_count++;
+    }
+
+    pool->position_x[i] = POSITION.x;
+    pool->position_y[i] = POSITION.y;
+    pool->velocity_x[i] = VELOCITY.x;
+    pool->velocity_y[i] = VELOCITY.y;
+    pool->time_alive[i] = 0;
+    pool->time_lifetime[i] = LIFETIME;
+    pool->size[i] = SIZE;
+    pool->color[i] = COLOR;
+}
+
+// Bursts an explosion into sparks flying out to roughly its radius and a few slower, larger pieces of debris
+void explosion_spawn_expl(Game_t *game, const Explosion_t EXPLOSION)
+{
+    int sparks_count = Clamp(EXPLOSION.size * game->particles_data.SPARKS_PER_SIZE, game->particles_data.SPARKS_MIN, game->particles_data.SPARKS_MAX);
+    int debris_count = sparks_count * game->particles_data.DEBRIS_FRACTION;
+
+    Color debris_color = {.r = EXPLOSION.color.r / 2, .g = EXPLOSION.color.g / 2, .b = EXPLOSION.color.b / 2, .a = 255};
+
+    for (int i = 0; i < sparks_count; i++)
+    {
+        bool is_debris = i < debris_count;
+
+        float angle = rand_cosmetic_float(game) * (PI * 2);
+        float lifetime = EXPLOSION.time_lifetime * (0.6f + 0.8f * rand_cosmetic_float(game));
+        float speed = EXPLOSION.size * (0.3f + 0.7f * rand_cosmetic_float(game)) / lifetime;
+
+        if (is_debris)
+        {
+            particle_spawn(game, EXPLOSION.position, (Vector2){.x = cos(angle) * speed * 0.4f, .y = sin(angle) * speed * 0.4f}, lifetime * 1.5f, 4 + 4 * rand_cosmetic_float(game), debris_color);
+        }
+        else
+        {
+            particle_spawn(game, EXPLOSION.position, (Vector2){.x = cos(angle) * speed, .y = sin(angle) * speed}, lifetime, 2 + 2 * rand_cosmetic_float(game), EXPLOSION.color);
+        }
+    }
+}
+
+void explosion_spawn(Game_t *game, const Vector2 POSITION, const float LIFETIME, const float SIZE, Color color)
+{
+    explosion_spawn_expl(game, (Explosion_t){.position = POSITION, .time_lifetime = LIFETIME, .size = SIZE, .color = color});
+}
+
+void particles_update(Game_t *game)
+{
+    Particle_Pool_t *pool = &game->particles_data.pool;
+    float damping = fmaxf(1 - game->particles_data.DRAG * game->frame_time, 0);
+
+    // Dead particles are moved as well, branching on them would keep this loop from vectorizing
+    int dying_count = 0;
+    for (int i = 0; i < PARTICLES_COUNT; i++)
+    {
+        dying_count += pool->time_alive[i] < pool->time_lifetime[i] && pool->time_alive[i] + game->frame_time >= pool->time_lifetime[i];
+
+        pool->position_x[i] += pool->velocity_x[i] * game->frame_time;
+        pool->position_y[i] += pool->velocity_y[i] * game->frame_time;
+        pool->velocity_x[i] *= damping;
+        pool->velocity_y[i] *= damping;
+
+        // Resting particles are snapped to zero, decaying into denormals would make every later update crawl
+        pool->velocity_x[i] = fabsf(pool->velocity_x[i]) < 0.01f ? 0 : pool->velocity_x[i];
+        pool->velocity_y[i] = fabsf(pool->velocity_y[i]) < 0.01f ? 0 : pool->velocity_y[i];
+        pool->time_alive[i] += game->frame_time;
+    }
+    pool->alive_count -= dying_count;
+
+    // Trims the dead particles at the old end of the live range
+    while (pool->live_count > 0)
+    {
+        int i = (pool->oldest - pool->live_count + PARTICLES_COUNT) % PARTICLES_COUNT;
+        if (pool->time_alive[i] < pool->time_lifetime[i])
+        {
+            break;
+        }
+        pool->live_count--;
+    }
+}
+
+// Copies the slots from start onwards, without wrapping around the ring
+void particles_copy_slots(Particle_Pool_t *destination, const Particle_Pool_t *SOURCE, int start, int count)
+{
+    memcpy(&destination->position_x[start], &SOURCE->position_x[start], count * sizeof(SOURCE->position_x[0]));
+    memcpy(&destination->position_y[start], &SOURCE->position_y[start], count * sizeof(SOURCE->position_y[0]));
+    memcpy(&destination->velocity_x[start], &SOURCE->velocity_x[start], count * sizeof(SOURCE->velocity_x[0]));
+    memcpy(&destination->velocity_y[start], &SOURCE->velocity_y[start], count * sizeof(SOURCE->velocity_y[0]));
+    memcpy(&destination->time_alive[start], &SOURCE->time_alive[start], count * sizeof(SOURCE->time_alive[0]));
+    memcpy(&destination->time_lifetime[start], &SOURCE->time_lifetime[start], count * sizeof(SOURCE->time_lifetime[0]));
+    memcpy(&destination->size[start], &SOURCE->size[start], count * sizeof(SOURCE->size[0]));
+    memcpy(&destination->color[start], &SOURCE->color[start], count * sizeof(SOURCE->color[0]));
+}
+
+// Copies only the live range, the slots outside of it are left stale and must not be read
+void particles_copy_live(Particle_Pool_t *destination, const Particle_Pool_t *SOURCE)
+{
+    int start = (SOURCE->oldest - SOURCE->live_count + PARTICLES_COUNT) % PARTICLES_COUNT;
+    int count_before_wrap = SOURCE->live_count < PARTICLES_COUNT - start ? SOURCE->live_count : PARTICLES_COUNT - start;
+
+    particles_copy_slots(destination, SOURCE, start, count_before_wrap);
+    particles_copy_slots(destination, SOURCE, 0, SOURCE->live_count - count_before_wrap);
+
+    destination->oldest = SOURCE->oldest;
+    destination->live_count = SOURCE->live_count;
+    destination->alive_count = SOURCE->alive_count;
+}
+
+void money_remove(Game_t *game, int money)
+{
+    game->player_data.money -= money;
+    game->player_data.transaction_money_remaining += money;
+
+    game->player_data.transaction_timer_buffer = 0;
+
+    game->player_data.transaction_timer = game->player_data.transaction_duration;
+}
+
+void money_add(Game_t *game, int money)
+{
+    game->player_data.money += money;
+    game->player_data.transaction_money_remaining -= money;
+
+    game->player_data.transaction_timer_buffer = 0;
+
+    game->player_data.transaction_timer = game->player_data.transaction_duration;
+}
+
+void money_update(Game_t *game)
+{
+    if (game->player_data.transaction_timer < 0)
+    {
+        game->player_data.transaction_money_remaining = 0;
+        return;
+    }
+
+    int money_buffer = 0;
+    if (game->player_data.transaction_money_remaining > 0)
+    {
+        money_buffer = (int)floor((game->player_data.transaction_money_remaining * (game->frame_time + game->player_data.transaction_timer_buffer) / game->player_data.transaction_timer));
+    }
+    else
+    {
+        money_buffer = (int)ceil((game->player_data.transaction_money_remaining * (game->frame_time + game->player_data.transaction_timer_buffer) / game->player_data.transaction_timer));
+    }
+
+    if (money_buffer)
+    {
+        game->player_data.transaction_money_remaining -= money_buffer;
+        game->player_data.transaction_timer_buffer = 0;
+    }
+    else
+    {
+        game->player_data.transaction_timer_buffer += game->frame_time;
+    }
+
+    game->player_data.transaction_timer -= game->frame_time;
+}
+
+void weapons_init(Game_t *game)
+{
+    for (size_t i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        Weapon_t *weapon = &game->weapons_data.weapons[i];
+        Weapon_Upgrade_Stats_t *base_stats = &game->weapons_data.base_stats[i];
+        Weapon_Upgrade_Stat_Multipliers_t *stat_multipliers = &game->weapons_data.stat_increase_mutlipliers;
+
+        weapon->ammo_count_max = base_stats->ammo_count_max * (1.0f + stat_multipliers->ammo_count_max * weapon->level_current);
+
+        weapon->time_ammo_reload = base_stats->time_ammo_reload * (1.0f + stat_multipliers->time_ammo_reload * weapon->level_current);
+
+        weapon->time_projectile_interval = base_stats->time_projectile_interval * (1.0f + stat_multipliers->time_projectile_interval * weapon->level_current);
+
+        weapon->projectile_count = base_stats->projectile_count * (1.0f + stat_multipliers->projectile_count * weapon->level_current);
+
+        weapon->start_velocity = base_stats->start_velocity * (1.0f + stat_multipliers->start_velocity * weapon->level_current);
+
+        weapon->spread = base_stats->spread * (1.0f + stat_multipliers->spread * weapon->level_current);
+
+        weapon->time_last_reload = 0;
+
+        weapon->ammo_count = 0;
+
+        game->weapons_data.symbol_alert_timers[i] = 999;
+
+        game->projectiles_data.player_projectile_damage[weapon->projectile_type] = base_stats->damage * (1.0f + stat_multipliers->damage * weapon->level_current);
+    }
+}
+
+void background_init(Game_t *game)
+{
+    game->stars_data.padding_x = g_window.width / 2;
+
+    for (int i = 0; i < game->stars_data.star_count; i++)
+    {
+        game->stars_data.stars[i] = (Star_t){
+            .color_index = rand_next(game) % game->stars_data.color_count,
+            .position = (Vector2){.x = rand_range_int(game, -game->stars_data.padding_x - 5, g_window.width + game->stars_data.padding_x + 5), .y = rand_range_int(game, -5, g_window.height + 5)},
+            .radius = rand_range_int(game, 1, 3),
+            .twinkle_offset = rand_float(game) * (PI * 2),
+            .speed_index = rand_next(game) % game->stars_data.speeds_count};
+    }
+
+    Vector2 base_speed = {.x = cos(135 * DEG2RAD), .y = sin(135 * DEG2RAD)};
+    base_speed = Vector2Scale(base_speed, 30);
+
+    for (int i = 0; i < game->stars_data.speeds_count; i++)
+    {
+        game->stars_data.star_speeds[i] = Vector2Scale(base_speed, 1 + 0.2f * i);
+    }
+}
+
+void player_init(Game_t *game)
+{
+    game->player_data.color = BLUE;
+    game->player_data.planet_current_health = game->player_data.planet_max_health;
+    game->player_data.player_current_health = game->player_data.player_max_health;
+    game->player_data.center = (Vector2){.x = g_window.width / 2, .y = g_window.height - game->player_data.OFFSET_Y};
+}
+
+// The occupancy is derived from the projectile types, so it is not part of a save state
+void projectiles_rebuild_occupancy(Game_t *game)
+{
+    pool_clear(&game->projectiles_data.player_occupancy);
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+    {
+        if (game->projectiles_data.player_projectiles[i].type != PROJECTILE_TYPE_PLAYER_NONE)
+        {
+            pool_occupy(&game->projectiles_data.player_occupancy, i);
+        }
+    }
+
+    pool_clear(&game->projectiles_data.enemy_occupancy);
+    for (int i = 0; i < game->projectiles_data.enemy_projectile_count; i++)
+    {
+        if (game->projectiles_data.enemy_projectiles[i].type != PROJECTILE_TYPE_ENEMY_NONE)
+        {
+            pool_occupy(&game->projectiles_data.enemy_occupancy, i);
+        }
+    }
+}
+
+void projectiles_init(Game_t *game)
+{
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+    {
+        game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+    }
+
+    for (int i = 0; i < game->projectiles_data.enemy_projectile_count; i++)
+    {
+        game->projectiles_data.enemy_projectiles[i].type = PROJECTILE_TYPE_ENEMY_NONE;
+    }
+
+    pool_clear(&game->projectiles_data.player_occupancy);
+    pool_clear(&game->projectiles_data.enemy_occupancy);
+    game->impact_schedule.event_count = 0;
+}
+
+void rewind_reset()
+{
+    g_rewind.entry_first = 0;
+    g_rewind.entry_count = 0;
+    g_rewind.byte_write_offset = 0;
+    g_rewind.ticks_since_keyframe = 0;
+    g_rewind.is_scrubbing = false;
+    g_rewind.scrub_index = 0;
+}
+
+void telemetry_reset(Game_t *game)
+{
+    game->telemetry_counters = (Telemetry_Counters_t){0};
+}
+
+void replay_reset(Game_t *game)
+{
+    g_replay.tick_count = 0;
+    g_replay.is_recording = game->recorders->replay_path != NULL;
+}
+
+void particles_init(Game_t *game)
+{
+    // A zero lifetime marks every particle as dead
+    memset(&game->particles_data.pool, 0, sizeof(game->particles_data.pool));
+}
+
+Vector2 enemy_get_position(Enemy_t enemy, float time)
+{
+    return (Vector2){
+        .x = enemy.spawn_position.x,
+        .y = enemy.spawn_position.y + g_enemy_database[enemy.type].speed * (time - enemy.time_spawned)};
+}
+
+// Dormant enemies need no work until their bottom edge crosses the top of the screen, unless they are killed before that
+bool enemy_is_dormant(Game_t *game, Enemy_t enemy)
+{
+    return enemy.current_health > 0 && enemy_get_position(enemy, game->enemies_data.time_elapsed).y <= -g_enemy_database[enemy.type].height;
+}
+
+// When an enemy that is above the screen will enter it
+float enemy_get_time_visible(Enemy_t enemy)
+{
+    float distance = -g_enemy_database[enemy.type].height - enemy.spawn_position.y;
+    return enemy.time_spawned + distance / fmaxf(g_enemy_database[enemy.type].speed, 1);
+}
+
+void enemies_activate(Game_t *game, int enemy_i)
+{
+    int k = game->enemies_data.active_count;
+    while (k > 0 && game->enemies_data.active_indices[k - 1] > enemy_i)
+    {
+        game->enemies_data.active_indices[k] = game->enemies_data.active_indices[k - 1];
+        k--;
+    }
+
+    game->enemies_data.active_indices[k] = enemy_i;
+    game->enemies_data.active_count++;
+}
+
+// Adds a newly live enemy to the active or the dormant list
+void enemies_track(Game_t *game, int enemy_i)
+{
+    Enemy_t enemy = game->enemies_data.enemies[enemy_i];
+    if (!enemy_is_dormant(game, enemy))
+    {
+        enemies_activate(game, enemy_i);
+        return;
+    }
+
+    float time_visible = enemy_get_time_visible(enemy);
+
+    int k = game->enemies_data.dormant_count;
+    while (k > 0 && enemy_get_time_visible(game->enemies_data.enemies[game->enemies_data.dormant_indices[k - 1]]) < time_visible)
+    {
+        game->enemies_data.dormant_indices[k] = game->enemies_data.dormant_indices[k - 1];
+        k--;
+    }
+
+    game->enemies_data.dormant_indices[k] = enemy_i;
+    game->enemies_data.dormant_count++;
+}
+
+// Moves every dormant enemy that has entered the screen to the active list
+void enemies_wake_due(Game_t *game)
+{
+    while (game->enemies_data.dormant_count > 0)
+    {
+        int enemy_i = game->enemies_data.dormant_indices[game->enemies_data.dormant_count - 1];
+        if (enemy_is_dormant(game, game->enemies_data.enemies[enemy_i]))
+        {
+            break;
+        }
+
+        game->enemies_data.dormant_count--;
+        enemies_activate(game, enemy_i);
+    }
+}
+
+// Enemies killed above the screen are woken so enemies_update() removes them
+void enemies_wake(Game_t *game, int enemy_i)
+{
+    for (int k = 0; k < game->enemies_data.dormant_count; k++)
+    {
+        if (game->enemies_data.dormant_indices[k] != enemy_i)
+        {
+            continue;
+        }
+
+        memmove(&game->enemies_data.dormant_indices[k], &game->enemies_data.dormant_indices[k + 1], game->enemies_data.dormant_count - k - 1);
+        game->enemies_data.dormant_count--;
+        enemies_activate(game, enemy_i);
+        return;
+    }
+}
+
+// The lists are derived from the enemies, so they are rebuilt instead of saved
+void enemies_rebuild_lists(Game_t *game)
+{
+    pool_clear(&game->enemies_data.occupancy);
+    game->enemies_data.active_count = 0;
+    game->enemies_data.dormant_count = 0;
+
+    for (int i = 0; i < game->enemies_data.ENEMIES_COUNT; i++)
+    {
+        if (game->enemies_data.enemies[i].type == ENEMY_TYPE_NONE)
+        {
+            continue;
+        }
+
+        pool_occupy(&game->enemies_data.occupancy, i);
+        enemies_track(game, i);
+    }
+}
+
+void enemy_take_damage(Game_t *game, int enemy_i, int damage)
+{
+    Enemy_t *enemy = &game->enemies_data.enemies[enemy_i];
+
+    bool was_dormant = enemy_is_dormant(game, *enemy);
+
+    enemy->current_health -= damage;
+    enemy->time_last_damaged = game->enemies_data.time_elapsed;
+
+    if (was_dormant && enemy->current_health <= 0)
+    {
+        enemies_wake(game, enemy_i);
+    }
+}
+
+float enemies_find_tallest_height()
+{
+    float height = 0;
+    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+    {
+        if (height > g_enemy_database[i].height)
+        {
+            continue;
+        }
+
+        height = g_enemy_database[i].height;
+    }
+    return height;
+}
+
+void enemies_init(Game_t *game)
+{
+    for (int i = 0; i < game->enemies_data.ENEMIES_COUNT; i++)
+    {
+        game->enemies_data.enemies[i].type = ENEMY_TYPE_NONE;
+        game->enemies_data.enemies[i].current_health = 0;
+        game->enemies_data.enemies[i].time_last_damaged = -game->enemies_data.health_bar_visibility_duration;
+    }
+
+    game->enemies_data.time_elapsed = 0;
+    pool_clear(&game->enemies_data.occupancy);
+    game->enemies_data.active_count = 0;
+    game->enemies_data.dormant_count = 0;
+
+    game->enemies_data.tallest_enemy_height = enemies_find_tallest_height();
+}
+
+// Allocates a game in the state the program starts in, freed with free()
+// Readies a game in memory the caller owns, game_create() allocates its own
+void game_prepare(Game_t *game)
+{
+    game_init(game);
+
+    player_init(game);
+    particles_init(game);
+    projectiles_init(game);
+    enemies_init(game);
+    background_init(game);
+
+    game->weapons_data.symbol_draw_area_y = g_window.height - 125;
+}
+
+Game_t *game_create()
+{
+    Game_t *game = malloc(sizeof(Game_t));
+    if (game == NULL)
+    {
+        printf("Could not allocate a game\n");
+        return NULL;
+    }
+
+    game_prepare(game);
+
+    return game;
+}
+
+// The spawn director as it steps through a level while the level is compiled into its schedule
+typedef struct
+{
+    unsigned long long rng_state;
+    float time;
+
+    float spawn_y;
+    float spawn_credits;
+    float total_spawn_credits;
+    float time_next_wave;
+    float enemy_spawn_chances[ENEMY_TYPE_COUNT];
+} Spawn_Director_t;
+
+void spawn_schedule_add_wave(Game_t *game, Spawn_Director_t *director, const Level_Data_t *LEVEL)
+{
+    // TODO
+    // Don't store enemy_type_none in affordable_enemies
+
+    const float SPAWN_INTERVAL_Y = game->enemies_data.ENEMY_SPEED * director->time_next_wave;
+
+    struct
+    {
+        float spawn_chance;
+        Enemy_Type_e enemy_type;
+    } affordable_enemies[ENEMY_TYPE_COUNT] = {0}; // A list of all enemies that can be afforded
+
+    int afford_count = 0;
+    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+    {
+        if (game->enemy_spawn_director.enemy_spawn_costs[i] > director->spawn_credits)
+        {
+            continue;
+        }
+
+        affordable_enemies[afford_count].enemy_type = i;
+        affordable_enemies[afford_count].spawn_chance = LEVEL->enemy_spawn_chances[i];
+
+        afford_count++;
+    }
+
+    while (afford_count)
+    {
+        {
+            // Balance affordable enemies
+            float total_chance = 0;
+            for (int i = 0; i < afford_count; i++)
+            {
+                total_chance += affordable_enemies[i].spawn_chance;
+            }
+
+            float difference = 1.0f / total_chance;
+
+            for (int i = 0; i < afford_count; i++)
+            {
+                affordable_enemies[i].spawn_chance *= difference;
+            }
+        }
+
+        // TODO
+        // "spawn_weight" is not descriptive enough
+        float spawn_weight = rand_float_from(&director->rng_state);
+
+        Enemy_Type_e new_enemy_type = ENEMY_TYPE_NONE;
+
+        float running_total = 0;
+
+        for (int i = 0; i < afford_count; i++)
+        {
+            if (spawn_weight < running_total || spawn_weight > running_total + affordable_enemies[i].spawn_chance)
+            {
+                running_total += affordable_enemies[i].spawn_chance;
+                continue;
+            }
+
+            new_enemy_type = affordable_enemies[i].enemy_type;
+
+            break;
+        }
+
+        {
+            director->enemy_spawn_chances[new_enemy_type] *= LEVEL->enemy_spawn_chance_factor[new_enemy_type];
+
+            // Balance absolute spawn chances
+            float total_chance = 0;
+            for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+            {
+                total_chance += director->enemy_spawn_chances[i];
+            }
+
+            float difference = 1.0f / total_chance;
+
+            for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+            {
+                director->enemy_spawn_chances[i] *= difference;
+            }
+        }
+
+        if (game->spawn_schedule.entry_count == game->spawn_schedule.ENTRIES_COUNT)
+        {
+            printf("The spawn schedule of level %d is full, its last waves are cut short\n", game->spawn_schedule.level + 1);
+            return;
+        }
+
+        const float WIDTH = g_enemy_database[new_enemy_type].width;
+
+        float new_x = rand_range_int_from(&director->rng_state, 0, (g_window.width - WIDTH));
+        float new_y = -rand_range_int_from(&director->rng_state, (-1) * director->spawn_y, (-1) * director->spawn_y + SPAWN_INTERVAL_Y);
+
+        // Overlaps are resolved against the live enemies once the entry spawns, see enemy_spawn()
+
+        // The pick can fall through to none when the chances round badly, its cost then ends the wave
+        if (new_enemy_type != ENEMY_TYPE_NONE)
+        {
+            game->spawn_schedule.entries[game->spawn_schedule.entry_count++] = (Spawn_Entry_t){
+                .time = director->time,
+                .type = new_enemy_type,
+                .position = {.x = new_x, .y = new_y},
+                .spawn_y = director->spawn_y,
+                .spawn_interval_y = SPAWN_INTERVAL_Y};
+        }
+        director->spawn_credits -= game->enemy_spawn_director.enemy_spawn_costs[new_enemy_type];
+
+        for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+        {
+            affordable_enemies[i].enemy_type = ENEMY_TYPE_NONE;
+            affordable_enemies[i].spawn_chance = 0;
+        }
+
+        afford_count = 0;
+        for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+        {
+            if (game->enemy_spawn_director.enemy_spawn_costs[i] > director->spawn_credits)
+            {
+                continue;
+            }
+
+            affordable_enemies[afford_count].enemy_type = i;
+            affordable_enemies[afford_count].spawn_chance = director->enemy_spawn_chances[i];
+
+            afford_count++;
+        }
+    }
+
+    director->spawn_y -= SPAWN_INTERVAL_Y;
+}
+
+// Steps the spawn director through the whole level at the tick rate, sampling every wave
+void spawn_schedule_compile(Game_t *game, short level, unsigned long long seed)
+{
+    const Level_Data_t *LEVEL = &game->levels[level];
+    const float TIME_STEP = 1.0f / g_sim_thread.TICK_RATE;
+
+    game->spawn_schedule.is_compiled = true;
+    game->spawn_schedule.level = level;
+    game->spawn_schedule.seed = seed;
+    game->spawn_schedule.entry_count = 0;
+    game->spawn_schedule.entry_next = 0;
+
+    Spawn_Director_t director = {
+        // xorshift gets stuck on a zero state
+        .rng_state = seed ? seed : 0x9E3779B97F4A7C15ULL,
+        .time = 0,
+        .spawn_y = game->enemy_spawn_director.spawn_y_min,
+        .spawn_credits = LEVEL->time_next_wave_min * LEVEL->spawn_credits_build_rate,
+        .total_spawn_credits = 0,
+        .time_next_wave = 0};
+    memcpy(director.enemy_spawn_chances, LEVEL->enemy_spawn_chances, sizeof(director.enemy_spawn_chances));
+
+    while (director.total_spawn_credits <= LEVEL->spawn_credits_target)
+    {
+        director.time += TIME_STEP;
+
+        director.spawn_y += game->enemies_data.ENEMY_SPEED * TIME_STEP;
+        if (director.spawn_y > game->enemy_spawn_director.spawn_y_min)
+        {
+            director.spawn_y = game->enemy_spawn_director.spawn_y_min;
+        }
+
+        director.time_next_wave -= TIME_STEP;
+
+        director.spawn_credits += LEVEL->spawn_credits_build_rate * TIME_STEP;
+        director.total_spawn_credits += LEVEL->spawn_credits_build_rate * TIME_STEP;
+
+        if (director.time_next_wave > 0)
+        {
+            continue;
+        }
+
+        director.time_next_wave += rand_range_float_from(&director.rng_state, LEVEL->time_next_wave_min, LEVEL->time_next_wave_max);
+        spawn_schedule_add_wave(game, &director, LEVEL);
+    }
+
+    // Once the target is passed the remaining credits go into a last wave on the next tick
+    director.time += TIME_STEP;
+    director.time_next_wave += rand_range_float_from(&director.rng_state, LEVEL->time_next_wave_min, LEVEL->time_next_wave_max);
+    spawn_schedule_add_wave(game, &director, LEVEL);
+}
+
+// Compiles the schedule unless it already holds this level and seed, restoring a state of the same attempt only moves the cursor
+void spawn_schedule_use(Game_t *game, short level, unsigned long long seed)
+{
+    if (!game->spawn_schedule.is_compiled || game->spawn_schedule.level != level || game->spawn_schedule.seed != seed)
+    {
+        spawn_schedule_compile(game, level, seed);
+    }
+}
+
+void enemy_spawn_director_init_level(Game_t *game, int level)
+{
+    if (level > game->enemy_spawn_director.max_level)
+    {
+        level = game->enemy_spawn_director.max_level;
+    }
+    game->enemy_spawn_director.current_level = level;
+
+    game->gamestate_current = STATE_LEVEL;
+
+    // Every attempt gets its own waves, seeded from the gameplay stream so that they follow its seed. The state is mixed,
+    // seeding xorshift with it as is would make the schedule replay the gameplay stream one draw behind
+    unsigned long long schedule_seed = splitmix64(game->rng.state);
+    rand_next(game);
+    spawn_schedule_compile(game, level, schedule_seed);
+
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+    {
+        game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+    }
+    pool_clear(&game->projectiles_data.player_occupancy);
+
+    player_init(game);
+    projectiles_init(game);
+    enemies_init(game);
+    weapons_init(game);
+    telemetry_reset(game);
+
+    // Headless games on other threads leave the recorders alone
+    if (game->recorders != NULL)
+    {
+        rewind_reset();
+        replay_reset(game);
+    }
+}
+
+Vector2 enemy_get_center(Enemy_t enemy, float time)
+{
+    float width = g_enemy_database[enemy.type].width;
+    float height = g_enemy_database[enemy.type].height;
+    Vector2 position = enemy_get_position(enemy, time);
+
+    Vector2 center = Vector2Subtract(Vector2Add((Vector2){.x = width, .y = height}, position), position); // Points towards the center of the enemy
+    center = sim_normalize(center);
+
+    float distance = sim_length((Vector2){.x = width, .y = height}) / 2; // The distance between the position of the enemy and its center
+
+    center = Vector2Scale(center, distance);     // Scale the vector so that the vector end point is in the center of the enemy
+    center = Vector2Add(center, position); // Add the vector to get absolute position of enemy center
+
+    return center;
+}
+
+// Narrows [*t_in, *t_out] to when Q + W * t lies within [LO, HI] on one axis
+void impact_clip_axis(double q, double w, double lo, double hi, double *t_in, double *t_out)
+{
+    if (w == 0)
+    {
+        if (q < lo || q > hi)
+        {
+            *t_in = INFINITY;
+            *t_out = -INFINITY;
+        }
+        return;
+    }
+
+    double t_1 = (lo - q) / w;
+    double t_2 = (hi - q) / w;
+    *t_in = fmax(*t_in, fmin(t_1, t_2));
+    *t_out = fmin(*t_out, fmax(t_1, t_2));
+}
+
+// When a point at (QX, QY) moving with (WX, WY) is within RADIUS of the box from (0, 0) to (WIDTH, HEIGHT).
+// The box rounded by the radius is convex, so that is a single interval made up of two slabs and four corner circles
+bool impact_get_interval(double qx, double qy, double wx, double wy, double width, double height, double radius, double *t_in, double *t_out)
+{
+    *t_in = INFINITY;
+    *t_out = -INFINITY;
+
+    for (int slab = 0; slab < 2; slab++)
+    {
+        double slab_in = -INFINITY;
+        double slab_out = INFINITY;
+        impact_clip_axis(qx, wx, slab == 0 ? -radius : 0, slab == 0 ? width + radius : width, &slab_in, &slab_out);
+        impact_clip_axis(qy, wy, slab == 0 ? 0 : -radius, slab == 0 ? height : height + radius, &slab_in, &slab_out);
+
+        if (slab_in <= slab_out)
+        {
+            *t_in = fmin(*t_in, slab_in);
+            *t_out = fmax(*t_out, slab_out);
+        }
+    }
+
+    for (int corner = 0; corner < 4; corner++)
+    {
+        double dx = qx - (corner % 2) * width;
+        double dy = qy - (corner / 2) * height;
+
+        double a = wx * wx + wy * wy;
+        double b = 2 * (dx * wx + dy * wy);
+        double c = dx * dx + dy * dy - radius * radius;
+
+        if (a == 0)
+        {
+            if (c <= 0)
+            {
+                *t_in = -INFINITY;
+                *t_out = INFINITY;
+            }
+            continue;
+        }
+
+        double discriminant = b * b - 4 * a * c;
+        if (discriminant < 0)
+        {
+            continue;
+        }
+
+        *t_in = fmin(*t_in, (-b - sqrt(discriminant)) / (2 * a));
+        *t_out = fmax(*t_out, (-b + sqrt(discriminant)) / (2 * a));
+    }
+
+    return *t_in <= *t_out;
+}
+
+// The first time a launched projectile touches an enemy, INFINITY if it never does.
+// Only depends on where both were launched or spawned, so recomputing it later gives the same result
+float projectile_get_impact_time(Game_t *game, const Projectile_Player_t *PROJECTILE, Enemy_t enemy)
+{
+    game->telemetry_counters.collision_tests++;
+
+    const Enemy_Data_t *ENEMY_DATA = &g_enemy_database[enemy.type];
+    Vector2 enemy_position = enemy_get_position(enemy, PROJECTILE->time_launched);
+
+    // The projectile relative to the enemy, starting at the launch time
+    double t_in;
+    double t_out;
+    if (!impact_get_interval(
+            PROJECTILE->launch_position.x - enemy_position.x,
+            PROJECTILE->launch_position.y - enemy_position.y,
+            PROJECTILE->velocity.x,
+            PROJECTILE->velocity.y - ENEMY_DATA->speed,
+            ENEMY_DATA->width,
+            ENEMY_DATA->height,
+            g_player_projectile_database[PROJECTILE->type].radius,
+            &t_in, &t_out))
+    {
+        return INFINITY;
+    }
+
+    // Enemies can only be hit after they spawned and entered the screen
+    double time_hittable = fmax(enemy.time_spawned, enemy_get_time_visible(enemy)) - PROJECTILE->time_launched;
+    t_in = fmax(t_in, fmax(time_hittable, 0));
+
+    if (t_in > t_out)
+    {
+        return INFINITY;
+    }
+
+    return PROJECTILE->time_launched + t_in;
+}
+
+bool impact_event_is_before(Impact_Event_t a, Impact_Event_t b)
+{
+    return a.time < b.time || (a.time == b.time && a.projectile_i < b.projectile_i);
+}
+
+bool impact_is_scheduled(Game_t *game, int projectile_i)
+{
+    const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[projectile_i];
+    return PROJECTILE->type != PROJECTILE_TYPE_PLAYER_NONE && flags_has(PROJECTILE->flags, PROJECTILE_FLAG_IS_LAUNCHED) && !flags_has(PROJECTILE->flags, PROJECTILE_FLAG_SHOULD_REMOVE) && game->impact_schedule.impact_times[projectile_i] != INFINITY;
+}
+
+void impact_events_push(Game_t *game, Impact_Event_t event)
+{
+    int i = game->impact_schedule.event_count++;
+    while (i > 0 && impact_event_is_before(event, game->impact_schedule.events[(i - 1) / 2]))
+    {
+        game->impact_schedule.events[i] = game->impact_schedule.events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    game->impact_schedule.events[i] = event;
+}
+
+Impact_Event_t impact_events_pop(Game_t *game)
+{
+    Impact_Event_t top = game->impact_schedule.events[0];
+    Impact_Event_t last = game->impact_schedule.events[--game->impact_schedule.event_count];
+
+    int i = 0;
+    while (true)
+    {
+        int child = 2 * i + 1;
+        if (child >= game->impact_schedule.event_count)
+        {
+            break;
+        }
+
+        if (child + 1 < game->impact_schedule.event_count && impact_event_is_before(game->impact_schedule.events[child + 1], game->impact_schedule.events[child]))
+        {
+            child++;
+        }
+
+        if (!impact_event_is_before(game->impact_schedule.events[child], last))
+        {
+            break;
+        }
+
+        game->impact_schedule.events[i] = game->impact_schedule.events[child];
+        i = child;
+    }
+
+    game->impact_schedule.events[i] = last;
+    return top;
+}
+
+// Queues the current impact of a projectile, dropping the stale events first if the heap is full
+void impact_push(Game_t *game, int projectile_i)
+{
+    if (!impact_is_scheduled(game, projectile_i))
+    {
+        return;
+    }
+
+    if (game->impact_schedule.event_count == game->impact_schedule.EVENTS_COUNT)
+    {
+        game->impact_schedule.event_count = 0;
+        for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+        {
+            if (i != projectile_i && impact_is_scheduled(game, i))
+            {
+                impact_events_push(game, (Impact_Event_t){.time = game->impact_schedule.impact_times[i], .projectile_i = i, .generation = game->impact_schedule.generations[i]});
+            }
+        }
+    }
+
+    impact_events_push(game, (Impact_Event_t){.time = game->impact_schedule.impact_times[projectile_i], .projectile_i = projectile_i, .generation = game->impact_schedule.generations[projectile_i]});
+}
+
+void impact_set(Game_t *game, int projectile_i, float time, int enemy_i)
+{
+    game->impact_schedule.impact_times[projectile_i] = time;
+    game->impact_schedule.impact_enemies[projectile_i] = enemy_i;
+    game->impact_schedule.generations[projectile_i]++;
+}
+
+// Finds the earliest impact of a projectile against all enemies, ties go to the lowest enemy slot
+void impact_schedule(Game_t *game, int projectile_i)
+{
+    // Builds without scheduled impacts test every tick instead, see projectile_check_collision()
+    if (!SIM_IMPACT_EVENTS)
+    {
+        return;
+    }
+
+    const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[projectile_i];
+
+    float impact_time = INFINITY;
+    int impact_enemy = -1;
+
+    bool is_flying = PROJECTILE->type != PROJECTILE_TYPE_PLAYER_NONE && flags_has(PROJECTILE->flags, PROJECTILE_FLAG_IS_LAUNCHED) && !flags_has(PROJECTILE->flags, PROJECTILE_FLAG_SHOULD_REMOVE);
+
+    for (int i = is_flying ? pool_next(&game->enemies_data.occupancy, 0) : -1; i >= 0; i = pool_next(&game->enemies_data.occupancy, i + 1))
+    {
+        float time = projectile_get_impact_time(game, PROJECTILE, game->enemies_data.enemies[i]);
+        if (time < impact_time)
+        {
+            impact_time = time;
+            impact_enemy = i;
+        }
+    }
+
+    impact_set(game, projectile_i, impact_time, impact_enemy);
+    impact_push(game, projectile_i);
+}
+
+// A new enemy only has to be tested against every projectile once
+void impacts_on_enemy_spawned(Game_t *game, int enemy_i)
+{
+    if (!SIM_IMPACT_EVENTS)
+    {
+        return;
+    }
+
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[i];
+        if (!flags_has(PROJECTILE->flags, PROJECTILE_FLAG_IS_LAUNCHED) || flags_has(PROJECTILE->flags, PROJECTILE_FLAG_SHOULD_REMOVE))
+        {
+            continue;
+        }
+
+        float time = projectile_get_impact_time(game, PROJECTILE, game->enemies_data.enemies[enemy_i]);
+        if (time < game->impact_schedule.impact_times[i] || (time == game->impact_schedule.impact_times[i] && time != INFINITY && enemy_i < game->impact_schedule.impact_enemies[i]))
+        {
+            impact_set(game, i, time, enemy_i);
+            impact_push(game, i);
+        }
+    }
+}
+
+// Only the projectiles that were going to hit a removed enemy need a new impact
+void impacts_on_enemy_removed(Game_t *game, int enemy_i)
+{
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        if (game->impact_schedule.impact_enemies[i] == enemy_i && impact_is_scheduled(game, i))
+        {
+            impact_schedule(game, i);
+        }
+    }
+}
+
+void impacts_rebuild(Game_t *game)
+{
+    game->impact_schedule.event_count = 0;
+
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+    {
+        impact_schedule(game, i);
+    }
+}
+
+void enemies_update(Game_t *game)
+{
+    game->enemies_data.time_elapsed += game->frame_time;
+    enemies_wake_due(game);
+
+    // Dormant enemies are skipped, their positions are evaluated on demand
+    for (int k = 0; k < game->enemies_data.active_count; k++)
+    {
+        unsigned char i = game->enemies_data.active_indices[k];
+        Enemy_t *current_enemy = &game->enemies_data.enemies[i];
+
+        // DrawCircleV(enemy_get_center(game->enemies_data.enemies[i]), 8, PURPLE);
+
+        if (current_enemy->type == ENEMY_TYPE_NONE)
+        {
+            continue;
+        }
+
+        if (current_enemy->current_health <= 0)
+        {
+            game->telemetry_counters.overkill_damage -= current_enemy->current_health;
+
+            explosion_spawn(game, enemy_get_center(*current_enemy, game->enemies_data.time_elapsed), 0.30f, 60, ORANGE);
+
+            money_add(game, (int)floor(game->enemy_spawn_director.enemy_spawn_costs[current_enemy->type]));
+            current_enemy->type = ENEMY_TYPE_NONE;
+            pool_vacate(&game->enemies_data.occupancy, i);
+            current_enemy->current_health = 1;
+            impacts_on_enemy_removed(game, i);
+            continue;
+        }
+
+        Vector2 position = enemy_get_position(*current_enemy, game->enemies_data.time_elapsed);
+
+        if (position.y > 0 && g_enemy_database[current_enemy->type].can_shoot)
+        {
+            current_enemy->time_last_fired += game->frame_time;
+
+            Vector2 enemy_to_player = Vector2Subtract(game->player_data.center, enemy_get_center(*current_enemy, game->enemies_data.time_elapsed));
+            if (sim_length(enemy_to_player) < g_enemy_database[current_enemy->type].shoot_range && current_enemy->time_last_fired > g_enemy_database[current_enemy->type].time_firing_interval && (position.y < game->player_data.center.y || flags_has(current_enemy->flags, ENEMY_FLAG_HAS_ATTEMPTED_FIRST_SHOT)))
+            {
+                if (!flags_has(current_enemy->flags, ENEMY_FLAG_HAS_ATTEMPTED_FIRST_SHOT))
+                {
+                    flags_set(&current_enemy->flags, ENEMY_FLAG_HAS_ATTEMPTED_FIRST_SHOT, true);
+                    current_enemy->time_last_fired = g_enemy_database[current_enemy->type].time_firing_interval - 3 * rand_float(game);
+                    continue;
+                }
+
+                int j = pool_first_free(&game->projectiles_data.enemy_occupancy, game->projectiles_data.enemy_projectile_count);
+                if (j >= 0)
+                {
+                    Projectile_Type_Enemy_e new_type = g_enemy_database[current_enemy->type].projectile_type;
+                    Vector2 new_position = enemy_get_center(*current_enemy, game->enemies_data.time_elapsed);
+                    Projectile_Enemy_t new_projectile = {
+                        .position = new_position,
+                        .health = g_enemy_projectile_database[new_type].max_health,
+                        .type = new_type,
+                        .velocity = Vector2Scale(sim_normalize(Vector2Subtract(game->player_data.center, new_position)), g_enemy_projectile_database[g_enemy_database[game->enemies_data.enemies[i].type].projectile_type].speed)};
+
+                    game->projectiles_data.enemy_projectiles[j] = new_projectile;
+                    pool_occupy(&game->projectiles_data.enemy_occupancy, j);
+                    current_enemy->time_last_fired -= g_enemy_database[current_enemy->type].time_firing_interval;
+                }
+                else
+                {
+                    game->telemetry_counters.enemy_projectiles_dropped++;
+                }
+            }
+        }
+
+        if (position.y > game->weapons_data.symbol_draw_area_y)
+        {
+            game->player_data.planet_current_health -= g_enemy_database[current_enemy->type].damage;
+            current_enemy->type = ENEMY_TYPE_NONE;
+            pool_vacate(&game->enemies_data.occupancy, i);
+            impacts_on_enemy_removed(game, i);
+        }
+    }
+
+    // Drop the enemies that died or reached the planet
+    int active_kept = 0;
+    for (int k = 0; k < game->enemies_data.active_count; k++)
+    {
+        if (game->enemies_data.enemies[game->enemies_data.active_indices[k]].type != ENEMY_TYPE_NONE)
+        {
+            game->enemies_data.active_indices[active_kept++] = game->enemies_data.active_indices[k];
+        }
+    }
+    game->enemies_data.active_count = active_kept;
+}
+
+void enemies_kill_all(Game_t *game)
+{
+    for (int i = 0; i < game->enemies_data.ENEMIES_COUNT; i++)
+    {
+        game->enemies_data.enemies[i].type = ENEMY_TYPE_NONE;
+    }
+
+    pool_clear(&game->enemies_data.occupancy);
+    game->enemies_data.active_count = 0;
+    game->enemies_data.dormant_count = 0;
+    impacts_rebuild(game);
+}
+
+void enemies_end_level(Game_t *game)
+{
+    enemies_kill_all(game);
+    game->spawn_schedule.entry_next = game->spawn_schedule.entry_count;
+}
+
+bool enemies_all_dead(Game_t *game)
+{
+    return game->enemies_data.occupancy.live_count == 0;
+}
+
+void enemy_spawn(Game_t *game, const Spawn_Entry_t *ENTRY)
+{
+    int enemy_i = pool_first_free(&game->enemies_data.occupancy, game->enemies_data.ENEMIES_COUNT);
+    if (enemy_i < 0)
+    {
+        game->telemetry_counters.enemy_spawns_rejected++;
+        return;
+    }
+
+    const float WIDTH = g_enemy_database[ENTRY->type].width;
+    const float HEIGHT = g_enemy_database[ENTRY->type].height;
+
+    Vector2 new_position = ENTRY->position;
+
+    // Move new enemy if it collides with any live one, redrawing from the gameplay stream within the band of its wave
+    for (int i = 0; i < 10; i++)
+    {
+        bool is_colliding = false;
+
+        for (int j = pool_next(&game->enemies_data.occupancy, 0); j >= 0; j = pool_next(&game->enemies_data.occupancy, j + 1))
+        {
+            Vector2 current_enemy_position = enemy_get_position(game->enemies_data.enemies[j], game->enemies_data.time_elapsed);
+
+            Rectangle current_enemy_hitbox = {
+                .x = current_enemy_position.x,
+                .y = current_enemy_position.y,
+                .width = g_enemy_database[game->enemies_data.enemies[j].type].width,
+                .height = g_enemy_database[game->enemies_data.enemies[j].type].height};
+
+            if (CheckCollisionRecs(current_enemy_hitbox, (Rectangle){.x = new_position.x, .y = new_position.y, .width = WIDTH, .height = HEIGHT}))
+            {
+                is_colliding = true;
+                break;
+            }
+        }
+
+        if (!is_colliding)
+        {
+            break;
+        }
+
+        new_position.x = rand_range_int(game, 0, (g_window.width - WIDTH));
+        new_position.y = -rand_range_int(game, (-1) * ENTRY->spawn_y, (-1) * ENTRY->spawn_y + ENTRY->spawn_interval_y);
+    }
+
+    Enemy_t new_enemy = {
+        .type = ENTRY->type,
+        .current_health = g_enemy_database[ENTRY->type].max_health,
+        .time_last_fired = g_enemy_database[ENTRY->type].time_firing_interval,
+        .time_spawned = ENTRY->time,
+        .time_last_damaged = ENTRY->time - game->enemies_data.health_bar_visibility_duration,
+        .spawn_position = new_position};
+
+    game->enemies_data.enemies[enemy_i] = new_enemy;
+    pool_occupy(&game->enemies_data.occupancy, enemy_i);
+    enemies_track(game, enemy_i);
+    impacts_on_enemy_spawned(game, enemy_i);
+}
+
+void enemies_update_spawn_conditions(Game_t *game)
+{
+    if (game->sim_input.cheat_kill_all)
+    {
+        enemies_kill_all(game);
+    }
+
+    if (game->sim_input.cheat_end_level)
+    {
+        enemies_end_level(game);
+    }
+
+    while (game->spawn_schedule.entry_next < game->spawn_schedule.entry_count && game->spawn_schedule.entries[game->spawn_schedule.entry_next].time <= game->enemies_data.time_elapsed)
+    {
+        enemy_spawn(game, &game->spawn_schedule.entries[game->spawn_schedule.entry_next]);
+        game->spawn_schedule.entry_next++;
+    }
+
+    if (game->spawn_schedule.entry_next == game->spawn_schedule.entry_count && enemies_all_dead(game))
+    {
+        game->gamestate_previous = STATE_LEVEL;
+        game->gamestate_current = STATE_UPGRADE;
+        game->transition_time = 0;
+        game->transition_duration = 4;
+        game->enemy_spawn_director.next_level++;
+        if (game->enemy_spawn_director.next_level > game->enemy_spawn_director.max_level)
+        {
+            game->enemy_spawn_director.next_level = game->enemy_spawn_director.max_level;
+        }
+        projectiles_init(game);
+    }
+}
+
+// Symbols, projectile shapes and enemy bodies are rasterized once at startup. Shapes draw through its white
+// block, so the world and the weapon panel share one texture and batch together
+struct
+{
+    const int WIDTH; // Sprites are packed in rows across this width
+    const int PADDING;
+
+    Texture2D texture;
+    Rectangle white;
+    Rectangle weapon_symbols[WEAPON_TYPE_COUNT];
+    Rectangle player_projectiles[PROJECTILE_TYPE_PLAYER_COUNT];
+    Rectangle enemy_projectiles[PROJECTILE_TYPE_ENEMY_COUNT];
+    Rectangle enemies[ENEMY_TYPE_COUNT];
+} g_atlas = {
+    .WIDTH = 256,
+    .PADDING = 2,
+};
+
+void enemies_draw(Game_t *game)
+{
+    for (int i = pool_next(g_render_view.enemies_occupancy, 0); i >= 0; i = pool_next(g_render_view.enemies_occupancy, i + 1))
+    {
+        const Enemy_t *current_enemy = &g_render_view.enemies[i];
+
+        Vector2 position = enemy_get_position(*current_enemy, g_render_view.enemies_time_elapsed);
+
+        // Enemy
+        DrawTextureRec(g_atlas.texture, g_atlas.enemies[current_enemy->type], position, WHITE);
+
+        if (g_render_view.enemies_time_elapsed - current_enemy->time_last_damaged < game->enemies_data.health_bar_visibility_duration)
+        {
+            // Healthbar base
+            DrawRectangle(
+                enemy_get_center(*current_enemy, g_render_view.enemies_time_elapsed).x - game->enemies_data.healthbar_width / 2,
+                position.y - 10,
+                game->enemies_data.healthbar_width,
+                8,
+                RED);
+
+            // Healthbar fill
+            DrawRectangle(
+                enemy_get_center(*current_enemy, g_render_view.enemies_time_elapsed).x - game->enemies_data.healthbar_width / 2,
+                position.y - 10,
+                Clamp((float)game->enemies_data.healthbar_width * (current_enemy->current_health / (float)g_enemy_database[current_enemy->type].max_health), 0, game->enemies_data.healthbar_width),
+                8,
+                GREEN);
+        }
+    }
+}
+
+// The window shows the 600x800 play area letterboxed at any size; the world can be drawn at a lower resolution and upscaled
+struct
+{
+    const float SCALES[3]; // F7 cycles through them
+    int scale_index;
+    bool is_bilinear;
+
+    RenderTexture2D world;
+    Camera2D window_camera; // Maps play area coordinates to window pixels
+} g_render_target = {
+    .SCALES = {1, 0.75f, 0.5f},
+};
+
+// Called before input is polled so the mouse reports play area coordinates
+void render_target_update()
+{
+    if (IsKeyPressed(KEY_F7))
+    {
+        g_render_target.scale_index = (g_render_target.scale_index + 1) % (sizeof(g_render_target.SCALES) / sizeof(g_render_target.SCALES[0]));
+    }
+
+    // The filter is only set when it changes or the texture is recreated, it is texture state that persists
+    bool is_filter_stale = false;
+
+    if (IsKeyPressed(KEY_F8))
+    {
+        g_render_target.is_bilinear = !g_render_target.is_bilinear;
+        is_filter_stale = true;
+    }
+
+    float zoom = fmin(GetScreenWidth() / (float)g_window.width, GetScreenHeight() / (float)g_window.height);
+
+    g_render_target.window_camera = (Camera2D){
+        .offset = {.x = (GetScreenWidth() - g_window.width * zoom) / 2, .y = (GetScreenHeight() - g_window.height * zoom) / 2},
+        .zoom = zoom,
+    };
+
+    SetMouseOffset(-g_render_target.window_camera.offset.x, -g_render_target.window_camera.offset.y);
+    SetMouseScale(1 / zoom, 1 / zoom);
+
+    int world_width = ceil(g_window.width * g_render_target.SCALES[g_render_target.scale_index]);
+    int world_height = ceil(g_window.height * g_render_target.SCALES[g_render_target.scale_index]);
+
+    if (g_render_target.world.id == 0 || g_render_target.world.texture.width != world_width || g_render_target.world.texture.height != world_height)
+    {
+        if (g_render_target.world.id != 0)
+        {
+            UnloadRenderTexture(g_render_target.world);
+        }
+
+        g_render_target.world = LoadRenderTexture(world_width, world_height);
+        is_filter_stale = true;
+    }
+
+    if (is_filter_stale)
+    {
+        SetTextureFilter(g_render_target.world.texture, g_render_target.is_bilinear ? TEXTURE_FILTER_BILINEAR : TEXTURE_FILTER_POINT);
+    }
+}
+
+void render_target_begin_frame()
+{
+    BeginDrawing();
+    ClearBackground(BLACK);
+    BeginMode2D(g_render_target.window_camera);
+}
+
+void render_target_end_frame()
+{
+    EndMode2D();
+    EndDrawing();
+}
+
+// Leaving texture mode resets the transform, so the window camera is put back afterwards
+void render_target_offscreen_begin(RenderTexture2D target)
+{
+    EndMode2D();
+    BeginTextureMode(target);
+}
+
+void render_target_offscreen_end()
+{
+    EndTextureMode();
+    BeginMode2D(g_render_target.window_camera);
+}
+
+void render_target_world_begin()
+{
+    render_target_offscreen_begin(g_render_target.world);
+    ClearBackground(BLACK);
+    BeginMode2D((Camera2D){.zoom = g_render_target.world.texture.width / (float)g_window.width});
+}
+
+// Upscales the world to the play area, anything drawn afterwards stays at window resolution
+void render_target_world_end()
+{
+    EndMode2D();
+    render_target_offscreen_end();
+
+    DrawTexturePro(
+        g_render_target.world.texture,
+        (Rectangle){.x = 0, .y = 0, .width = g_render_target.world.texture.width, .height = -g_render_target.world.texture.height},
+        (Rectangle){.x = 0, .y = 0, .width = g_window.width, .height = g_window.height},
+        (Vector2){0},
+        0,
+        WHITE);
+}
+
+// Menu buttons are kept between frames; a panel only re-renders its cached texture when a hover or state change dirties it
+enum
+{
+    UI_PANEL_WIDGETS_COUNT = 64, // One bit each in the grid cell masks
+    UI_GRID_COLUMNS = 8,
+    UI_GRID_ROWS = 8,
+};
+
+typedef enum
+{
+    UI_PANEL_STATE_SELECTION,
+    UI_PANEL_LEVEL_SELECTOR,
+    UI_PANEL_UPGRADE,
+    UI_PANEL_GAME_OVER,
+    UI_PANEL_COUNT,
+} Ui_Panel_e;
+
+typedef struct
+{
+    Rectangle bounds;
+    Color color;
+    Color color_hover;
+    Color color_disabled;
+    bool is_disabled;
+
+    int border_thickness; // 0 draws no border
+    Color border_color;
+
+    char text[16];
+    int font_size;
+    int spacing;
+    Color text_color;
+    Vector2 text_size; // Measured once when the widget is added
+} Ui_Widget_t;
+
+typedef struct
+{
+    Ui_Widget_t widgets[UI_PANEL_WIDGETS_COUNT];
+    int widget_count;
+
+    bool is_built;
+    int build_key; // A screen passing a different key rebuilds its panel
+    bool is_dirty;
+    int hovered;
+
+    Rectangle bounds; // Covers every widget, the cached texture has its size
+    RenderTexture2D texture;
+
+    unsigned long long cell_masks[UI_GRID_COLUMNS * UI_GRID_ROWS]; // Widgets overlapping each cell of the bounds
+} Ui_Panel_t;
+
+struct
+{
+    Ui_Panel_t panels[UI_PANEL_COUNT];
+} g_ui;
+
+Rectangle ui_rectangle_centered(int center_x, int center_y, int width, int height)
+{
+    return (Rectangle){.x = center_x - width / 2, .y = center_y - height / 2, .width = width, .height = height};
+}
+
+bool ui_panel_begin(Ui_Panel_e panel_type, int build_key)
+{
+    Ui_Panel_t *panel = &g_ui.panels[panel_type];
+
+    if (panel->is_built && panel->build_key == build_key)
+    {
+        return false;
+    }
+
+    panel->widget_count = 0;
+    panel->build_key = build_key;
+    panel->is_built = true;
+
+    return true;
+}
+
+int ui_panel_add(Ui_Panel_e panel_type, Ui_Widget_t widget)
+{
+    Ui_Panel_t *panel = &g_ui.panels[panel_type];
+
+    if (widget.text[0] != '\0')
+    {
+        widget.text_size = MeasureTextEx(GetFontDefault(), widget.text, widget.font_size, widget.spacing);
+    }
+
+    // The grid cell masks have no bit for any further widget
+    if (panel->widget_count == UI_PANEL_WIDGETS_COUNT)
+    {
+        printf("UI panel %d is full, a widget was left out\n", panel_type);
+        return -1;
+    }
+
+    panel->widgets[panel->widget_count] = widget;
+
+    return panel->widget_count++;
+}
+
+int ui_grid_column(const Ui_Panel_t *PANEL, float x)
+{
+    return Clamp((x - PANEL->bounds.x) * UI_GRID_COLUMNS / PANEL->bounds.width, 0, UI_GRID_COLUMNS - 1);
+}
+
+int ui_grid_row(const Ui_Panel_t *PANEL, float y)
+{
+    return Clamp((y - PANEL->bounds.y) * UI_GRID_ROWS / PANEL->bounds.height, 0, UI_GRID_ROWS - 1);
+}
+
+void ui_panel_end(Ui_Panel_e panel_type)
+{
+    Ui_Panel_t *panel = &g_ui.panels[panel_type];
+
+    // An empty panel has no bounds to cover and nothing to cache
+    if (panel->widget_count == 0)
+    {
+        panel->bounds = (Rectangle){0};
+        panel->hovered = -1;
+        panel->is_dirty = false;
+        return;
+    }
+
+    float left = panel->widgets[0].bounds.x;
+    float top = panel->widgets[0].bounds.y;
+    float right = left;
+    float bottom = top;
+
+    for (int i = 0; i < panel->widget_count; i++)
+    {
+        Rectangle bounds = panel->widgets[i].bounds;
+
+        left = fmin(left, bounds.x);
+        top = fmin(top, bounds.y);
+        right = fmax(right, bounds.x + bounds.width);
+        bottom = fmax(bottom, bounds.y + bounds.height);
+    }
+
+    panel->bounds = (Rectangle){.x = floor(left), .y = floor(top), .width = ceil(right) - floor(left), .height = ceil(bottom) - floor(top)};
+
+    memset(panel->cell_masks, 0, sizeof(panel->cell_masks));
+
+    for (int i = 0; i < panel->widget_count; i++)
+    {
+        Rectangle bounds = panel->widgets[i].bounds;
+
+        for (int row = ui_grid_row(panel, bounds.y); row <= ui_grid_row(panel, bounds.y + bounds.height); row++)
+        {
+            for (int column = ui_grid_column(panel, bounds.x); column <= ui_grid_column(panel, bounds.x + bounds.width); column++)
+            {
+                panel->cell_masks[row * UI_GRID_COLUMNS + column] |= 1ull << i;
+            }
+        }
+    }
+
+    if (panel->texture.id == 0 || panel->texture.texture.width != panel->bounds.width || panel->texture.texture.height != panel->bounds.height)
+    {
+        if (panel->texture.id != 0)
+        {
+            UnloadRenderTexture(panel->texture);
+        }
+
+        panel->texture = LoadRenderTexture(panel->bounds.width, panel->bounds.height);
+    }
+
+    panel->hovered = -1;
+    panel->is_dirty = true;
+}
+
+void ui_widget_set_disabled(Ui_Panel_e panel_type, int widget_index, bool is_disabled)
+{
+    Ui_Panel_t *panel = &g_ui.panels[panel_type];
+
+    if (panel->widgets[widget_index].is_disabled == is_disabled)
+    {
+        return;
+    }
+
+    panel->widgets[widget_index].is_disabled = is_disabled;
+    panel->is_dirty = true;
+}
+
+int ui_panel_hit_test(const Ui_Panel_t *PANEL, Vector2 point)
+{
+    if (!CheckCollisionPointRec(point, PANEL->bounds))
+    {
+        return -1;
+    }
+
+    unsigned long long candidates = PANEL->cell_masks[ui_grid_row(PANEL, point.y) * UI_GRID_COLUMNS + ui_grid_column(PANEL, point.x)];
+
+    while (candidates != 0)
+    {
+        int i = __builtin_ctzll(candidates);
+        candidates &= candidates - 1;
+
+        if (!PANEL->widgets[i].is_disabled && CheckCollisionPointRec(point, PANEL->widgets[i].bounds))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void ui_widget_draw(const Ui_Widget_t *WIDGET, bool is_hovered, Vector2 origin)
+{
+    Rectangle bounds = {.x = WIDGET->bounds.x - origin.x, .y = WIDGET->bounds.y - origin.y, .width = WIDGET->bounds.width, .height = WIDGET->bounds.height};
+    Color color = WIDGET->color;
+
+    if (WIDGET->is_disabled)
+    {
+        color = WIDGET->color_disabled;
+    }
+    else if (is_hovered)
+    {
+        color = WIDGET->color_hover;
+    }
+
+    DrawRectangleRec(bounds, color);
+
+    if (WIDGET->border_thickness > 0)
+    {
+        DrawRectangleLinesEx(bounds, WIDGET->border_thickness, WIDGET->border_color);
+    }
+
+    if (WIDGET->text[0] != '\0')
+    {
+        Vector2 text_position = {.x = bounds.x + (bounds.width - WIDGET->text_size.x) / 2, .y = bounds.y + (bounds.height - WIDGET->text_size.y) / 2};
+        DrawTextEx(GetFontDefault(), WIDGET->text, text_position, WIDGET->font_size, WIDGET->spacing, WIDGET->text_color);
+    }
+}
+
+void ui_panel_render(Ui_Panel_t *panel)
+{
+    render_target_offscreen_begin(panel->texture);
+    ClearBackground(BLANK);
+
+    for (int i = 0; i < panel->widget_count; i++)
+    {
+        ui_widget_draw(&panel->widgets[i], i == panel->hovered, (Vector2){.x = panel->bounds.x, .y = panel->bounds.y});
+    }
+
+    render_target_offscreen_end();
+
+    panel->is_dirty = false;
+}
+
+// Draws the panel shifted by offset and returns the index of the widget clicked this frame, or -1
+int ui_panel_update(Ui_Panel_e panel_type, bool disable_buttons, int offset)
+{
+    Ui_Panel_t *panel = &g_ui.panels[panel_type];
+
+    if (panel->widget_count == 0)
+    {
+        return -1;
+    }
+
+    int hovered = -1;
+
+    if (!disable_buttons)
+    {
+        hovered = ui_panel_hit_test(panel, (Vector2){.x = g_mouse_position.x - offset, .y = g_mouse_position.y});
+    }
+
+    if (hovered != panel->hovered)
+    {
+        panel->hovered = hovered;
+        panel->is_dirty = true;
+    }
+
+    if (panel->is_dirty)
+    {
+        ui_panel_render(panel);
+    }
+
+    // Render textures are stored upside down
+    DrawTextureRec(
+        panel->texture.texture,
+        (Rectangle){.x = 0, .y = 0, .width = panel->bounds.width, .height = -panel->bounds.height},
+        (Vector2){.x = panel->bounds.x + offset, .y = panel->bounds.y},
+        WHITE);
+
+    if (hovered < 0 || !IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    {
+        return -1;
+    }
+
+    return hovered;
+}
+
+void projectile_hit_enemy(Game_t *game, Projectile_Player_t *projectile, int enemy_index)
+{
+    game->telemetry_counters.hits++;
+
+    Explosion_t new_explosion = g_player_projectile_database[projectile->type].explosion;
+    new_explosion.position = projectile->position;
+
+    explosion_spawn_expl(game, new_explosion);
+
+    // If the projectile is explosive
+    if (g_player_projectile_database[projectile->type].is_explosive)
+    {
+        // Damage all enemies inside the explosion
+        // Explosions also reach the dormant enemies right above the screen
+        for (int explosion_check_enemy_index = pool_next(&game->enemies_data.occupancy, 0); explosion_check_enemy_index >= 0; explosion_check_enemy_index = pool_next(&game->enemies_data.occupancy, explosion_check_enemy_index + 1))
+        {
+            Vector2 explosion_check_position = enemy_get_position(game->enemies_data.enemies[explosion_check_enemy_index], game->enemies_data.time_elapsed);
+
+            game->telemetry_counters.collision_tests++;
+
+            if (CheckCollisionCircleRec(
+                    projectile->position,
+                    g_player_projectile_database[projectile->type].explosion.size,
+                    (Rectangle){
+                        .height = g_enemy_database[game->enemies_data.enemies[explosion_check_enemy_index].type].height,
+                        .width = g_enemy_database[game->enemies_data.enemies[explosion_check_enemy_index].type].width,
+                        .x = explosion_check_position.x,
+                        .y = explosion_check_position.y}))
+            {
+                Vector2 enemy_center = enemy_get_center(game->enemies_data.enemies[explosion_check_enemy_index], game->enemies_data.time_elapsed);
+
+                float distance = sim_length(Vector2Subtract(enemy_center, projectile->position)); // The distance between the enemy center and the projectile center
+
+                float factor = 1 - (distance / g_player_projectile_database[projectile->type].explosion.size); // How close to the origin of the explosion radius the enemy is
+                factor = Clamp(factor, 0, 1);
+
+                enemy_take_damage(game, explosion_check_enemy_index, game->projectiles_data.player_projectile_damage[projectile->type] * (factor));
+            }
+        }
+    }
+    // If the projectile is not explosive
+    else
+    {
+        enemy_take_damage(game, enemy_index, game->projectiles_data.player_projectile_damage[projectile->type]);
+    }
+
+    flags_set(&projectile->flags, PROJECTILE_FLAG_SHOULD_REMOVE, true);
+}
+
+// Tests a projectile against the active enemies where both are on this tick, the first one overlapping it by slot is hit.
+// Only used by builds without scheduled impacts
+void projectile_check_collision(Game_t *game, Projectile_Player_t *projectile)
+{
+    for (int k = 0; k < game->enemies_data.active_count; k++)
+    {
+        int enemy_index = game->enemies_data.active_indices[k];
+        const Enemy_t *ENEMY = &game->enemies_data.enemies[enemy_index];
+
+        if (ENEMY->type == ENEMY_TYPE_NONE || ENEMY->current_health <= 0)
+        {
+            continue;
+        }
+
+        const Enemy_Data_t *DATA = &g_enemy_database[ENEMY->type];
+        Vector2 position = enemy_get_position(*ENEMY, game->enemies_data.time_elapsed);
+
+        // Enemies outside the screen can only be damaged by explosions
+        if (position.y <= -DATA->height)
+        {
+            continue;
+        }
+
+        game->telemetry_counters.collision_tests++;
+
+        if (CheckCollisionCircleRec(projectile->position, g_player_projectile_database[projectile->type].radius, (Rectangle){.x = position.x, .y = position.y, .width = DATA->width, .height = DATA->height}))
+        {
+            projectile_hit_enemy(game, projectile, enemy_index);
+            return;
+        }
+    }
+}
+
+// Resolves every impact that happened by now in the order they happened
+void impacts_process_due(Game_t *game)
+{
+    while (game->impact_schedule.event_count > 0 && game->impact_schedule.events[0].time <= game->enemies_data.time_elapsed)
+    {
+        Impact_Event_t event = impact_events_pop(game);
+
+        if (event.generation != game->impact_schedule.generations[event.projectile_i] || !impact_is_scheduled(game, event.projectile_i))
+        {
+            continue;
+        }
+
+        // Enemies that are already dying are not hit, the projectile is rescheduled once the enemy is removed
+        int enemy_index = game->impact_schedule.impact_enemies[event.projectile_i];
+        if (game->enemies_data.enemies[enemy_index].current_health <= 0)
+        {
+            continue;
+        }
+
+        // The projectile may have moved past the enemy since, it explodes where it made contact
+        Projectile_Player_t *projectile = &game->projectiles_data.player_projectiles[event.projectile_i];
+        projectile->position = Vector2Add(projectile->launch_position, Vector2Scale(projectile->velocity, event.time - projectile->time_launched));
+
+        projectile_hit_enemy(game, projectile, enemy_index);
+        impact_set(game, event.projectile_i, INFINITY, -1);
+    }
+}
+
+void projectile_player_spawn(Game_t *game, const int WEAPON_INDEX, const float TIME_WAIT)
+{
+    Projectile_Player_t new_projectile = {0};
+
+    new_projectile.time_wait = TIME_WAIT;
+    new_projectile.type = game->weapons_data.weapons[WEAPON_INDEX].projectile_type;
+
+    new_projectile.position = game->player_data.center;
+
+    new_projectile.velocity = Vector2Subtract(game->sim_input.mouse_position, new_projectile.position);
+    new_projectile.velocity = sim_normalize(new_projectile.velocity);
+    new_projectile.velocity = Vector2Scale(new_projectile.velocity, game->weapons_data.weapons[WEAPON_INDEX].start_velocity);
+
+    if (game->weapons_data.weapons[WEAPON_INDEX].spread > 0)
+    {
+        float angle = rand_next(game) % game->weapons_data.weapons[WEAPON_INDEX].spread;
+        angle -= game->weapons_data.weapons[WEAPON_INDEX].spread / 2;
+        angle *= (rand_next(game) / (float)RAND_NEXT_MAX);
+
+        // Convert to radians
+        angle *= (3.14f / 180);
+
+        new_projectile.velocity = sim_rotate(new_projectile.velocity, angle);
+    }
+    else
+    {
+        new_projectile.velocity = sim_rotate(new_projectile.velocity, 0);
+    }
+
+    int projectile_i = pool_first_free(&game->projectiles_data.player_occupancy, game->projectiles_data.player_projectile_count);
+    if (projectile_i < 0)
+    {
+        game->telemetry_counters.player_projectiles_dropped++;
+        return;
+    }
+
+    game->projectiles_data.player_projectiles[projectile_i] = new_projectile;
+    pool_occupy(&game->projectiles_data.player_occupancy, projectile_i);
+}
+
+int projectile_grid_column(Game_t *game, float x)
+{
+    return Clamp(x / game->projectile_grid.CELL_SIZE, 0, game->projectile_grid.COLUMNS_COUNT - 1);
+}
+
+int projectile_grid_row(Game_t *game, float y)
+{
+    return Clamp(y / game->projectile_grid.CELL_SIZE, 0, game->projectile_grid.ROWS_COUNT - 1);
+}
+
+// Counting sort of the live player projectiles into the grid cells
+void projectile_grid_build(Game_t *game)
+{
+    const int CELLS_COUNT = game->projectile_grid.COLUMNS_COUNT * game->projectile_grid.ROWS_COUNT;
+    int cell_cursors[12 * 16];
+
+    memset(game->projectile_grid.cell_starts, 0, sizeof(game->projectile_grid.cell_starts));
+
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[i];
+        int cell = projectile_grid_row(game, PROJECTILE->position.y) * game->projectile_grid.COLUMNS_COUNT + projectile_grid_column(game, PROJECTILE->position.x);
+        game->projectile_grid.cell_starts[cell + 1]++;
+    }
+
+    for (int cell = 0; cell < CELLS_COUNT; cell++)
+    {
+        game->projectile_grid.cell_starts[cell + 1] += game->projectile_grid.cell_starts[cell];
+        cell_cursors[cell] = game->projectile_grid.cell_starts[cell];
+    }
+
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[i];
+        int cell = projectile_grid_row(game, PROJECTILE->position.y) * game->projectile_grid.COLUMNS_COUNT + projectile_grid_column(game, PROJECTILE->position.x);
+        game->projectile_grid.cell_projectiles[cell_cursors[cell]++] = i;
+    }
+}
+
+// Damages a destroyable enemy projectile with every player projectile that intercepts it, the grid must be built
+void projectile_enemy_intercept(Game_t *game, Projectile_Enemy_t *projectile)
+{
+    const Projectile_Data_Enemy_t *DATA = &g_enemy_projectile_database[projectile->type];
+
+    // Only the cells holding centers of projectiles that can touch this one are searched
+    float reach = DATA->radius;
+    for (int type = 0; type < PROJECTILE_TYPE_PLAYER_COUNT; type++)
+    {
+        if (DATA->intercepted_by[type])
+        {
+            reach = fmaxf(reach, DATA->radius + g_player_projectile_database[type].radius);
+        }
+    }
+
+    int column_min = projectile_grid_column(game, projectile->position.x - reach);
+    int column_max = projectile_grid_column(game, projectile->position.x + reach);
+    int row_min = projectile_grid_row(game, projectile->position.y - reach);
+    int row_max = projectile_grid_row(game, projectile->position.y + reach);
+
+    // The hits are gathered first and applied by slot, so the same interceptors win as with a scan of the whole pool
+    short hits[512];
+    int hits_count = 0;
+
+    for (int row = row_min; row <= row_max; row++)
+    {
+        for (int column = column_min; column <= column_max; column++)
+        {
+            int cell = row * game->projectile_grid.COLUMNS_COUNT + column;
+
+            for (int k = game->projectile_grid.cell_starts[cell]; k < game->projectile_grid.cell_starts[cell + 1]; k++)
+            {
+                int interceptor_i = game->projectile_grid.cell_projectiles[k];
+                Projectile_Player_t *interceptor = &game->projectiles_data.player_projectiles[interceptor_i];
+
+                // Interceptors already used up this update have their type set to none
+                if (!DATA->intercepted_by[interceptor->type])
+                {
+                    continue;
+                }
+
+                game->telemetry_counters.collision_tests++;
+
+                if (!CheckCollisionCircles(projectile->position, DATA->radius, interceptor->position, g_player_projectile_database[interceptor->type].radius))
+                {
+                    continue;
+                }
+
+                // Insertion sort, an enemy projectile is rarely touched by more than a few interceptors at once
+                int j = hits_count++;
+                for (; j > 0 && hits[j - 1] > interceptor_i; j--)
+                {
+                    hits[j] = hits[j - 1];
+                }
+                hits[j] = interceptor_i;
+            }
+        }
+    }
+
+    for (int k = 0; k < hits_count; k++)
+    {
+        Projectile_Player_t *interceptor = &game->projectiles_data.player_projectiles[hits[k]];
+
+        game->telemetry_counters.hits++;
+
+        projectile->health -= game->projectiles_data.player_projectile_damage[interceptor->type];
+
+        Explosion_t new_explosion = g_player_projectile_database[interceptor->type].explosion;
+        new_explosion.position = interceptor->position;
+        explosion_spawn_expl(game, new_explosion);
+
+        interceptor->type = PROJECTILE_TYPE_PLAYER_NONE;
+        pool_vacate(&game->projectiles_data.player_occupancy, hits[k]);
+
+        if (projectile->health <= 0)
+        {
+            projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+            pool_vacate(&game->projectiles_data.enemy_occupancy, projectile - game->projectiles_data.enemy_projectiles);
+            return;
+        }
+    }
+}
+
+void projectiles_update(Game_t *game)
+{
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        if (flags_has(game->projectiles_data.player_projectiles[i].flags, PROJECTILE_FLAG_SHOULD_REMOVE))
+        {
+            game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+            pool_vacate(&game->projectiles_data.player_occupancy, i);
+            continue;
+        }
+
+        if (0 < game->projectiles_data.player_projectiles[i].time_wait)
+        {
+            game->projectiles_data.player_projectiles[i].time_wait -= game->frame_time;
+            // printf("Projectile index %d - Decreased time_wait to %f\n", i, (*projectiles)[i].time_wait);
+            continue;
+        }
+
+        Vector2 scaled_velocity = Vector2Scale(game->projectiles_data.player_projectiles[i].velocity, game->frame_time);
+        game->projectiles_data.player_projectiles[i].position = Vector2Add(game->projectiles_data.player_projectiles[i].position, scaled_velocity);
+
+        float radius = g_player_projectile_database[game->projectiles_data.player_projectiles[i].type].radius;
+
+        // Check if out of bounds
+        // Left
+        if (game->projectiles_data.player_projectiles[i].position.x + radius < 0)
+        {
+            game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+        }
+
+        // Right
+        if (game->projectiles_data.player_projectiles[i].position.x - radius >= g_window.width)
+        {
+            game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+        }
+
+        // Top
+        if (game->projectiles_data.player_projectiles[i].position.y + radius < 0)
+        {
+            game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+        }
+
+        // Bottom
+        if (game->projectiles_data.player_projectiles[i].position.y - radius >= g_window.height)
+        {
+            game->projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+        }
+
+        if (PROJECTILE_TYPE_PLAYER_NONE == game->projectiles_data.player_projectiles[i].type)
+        {
+            pool_vacate(&game->projectiles_data.player_occupancy, i);
+            game->telemetry_counters.projectiles_culled++;
+            continue;
+        }
+
+        // The course is fixed from the first move on, so its impact is predicted once instead of tested every frame
+        if (!flags_has(game->projectiles_data.player_projectiles[i].flags, PROJECTILE_FLAG_IS_LAUNCHED))
+        {
+            flags_set(&game->projectiles_data.player_projectiles[i].flags, PROJECTILE_FLAG_IS_LAUNCHED, true);
+            game->projectiles_data.player_projectiles[i].time_launched = game->enemies_data.time_elapsed;
+            game->projectiles_data.player_projectiles[i].launch_position = game->projectiles_data.player_projectiles[i].position;
+            impact_schedule(game, i);
+        }
+
+#if !SIM_IMPACT_EVENTS
+        projectile_check_collision(game, &game->projectiles_data.player_projectiles[i]);
+#endif
+    }
+
+#if SIM_IMPACT_EVENTS
+    impacts_process_due(game);
+#endif
+
+    // Built on the first destroyable enemy projectile, most updates have none
+    bool is_grid_built = false;
+
+    for (int i = pool_next(&game->projectiles_data.enemy_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.enemy_occupancy, i + 1))
+    {
+        Projectile_Enemy_t *current_projectile = &game->projectiles_data.enemy_projectiles[i];
+
+        if (g_enemy_projectile_database[current_projectile->type].is_destroyable)
+        {
+            if (!is_grid_built)
+            {
+                projectile_grid_build(game);
+                is_grid_built = true;
+            }
+
+            projectile_enemy_intercept(game, current_projectile);
+
+            if (PROJECTILE_TYPE_ENEMY_NONE == current_projectile->type)
+            {
+                continue;
+            }
+        }
+
+        // printf("Enemy projectile index %d has velocity (%f, %f) and position (%f, %f)\n", i, current_projectile->velocity.x, current_projectile->velocity.y, current_projectile->position.x, current_projectile->position.y);
+
+        current_projectile->position = Vector2Add(current_projectile->position, Vector2Scale(current_projectile->velocity, game->frame_time));
+
+        float radius = g_enemy_projectile_database[current_projectile->type].radius;
+
+        // Check if out of bounds
+        // Left
+        if (current_projectile->position.x + radius < 0)
+        {
+            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+        }
+
+        // Right
+        if (current_projectile->position.x - radius >= g_window.width)
+        {
+            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+        }
+
+        // Top
+        if (current_projectile->position.y + radius < 0)
+        {
+            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+        }
+
+        // Bottom
+        if (current_projectile->position.y - radius >= g_window.height)
+        {
+            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+        }
+
+        if (PROJECTILE_TYPE_ENEMY_NONE == current_projectile->type)
+        {
+            pool_vacate(&game->projectiles_data.enemy_occupancy, i);
+            game->telemetry_counters.projectiles_culled++;
+            continue;
+        }
+
+        game->telemetry_counters.collision_tests++;
+
+        if (CheckCollisionCircles(current_projectile->position, g_enemy_projectile_database[current_projectile->type].radius, game->player_data.center, game->player_data.hitbox_radius))
+        {
+            game->player_data.player_current_health -= g_enemy_projectile_database[current_projectile->type].damage;
+            game->projectiles_data.enemy_projectiles[i].type = PROJECTILE_TYPE_ENEMY_NONE;
+            pool_vacate(&game->projectiles_data.enemy_occupancy, i);
+        }
+    }
+}
+
+// Only used to bake the atlas, the shapes point along velocity
+void projectile_player_draw_shape(Projectile_Type_Player_e type, Vector2 position, Vector2 velocity)
+{
+    switch (type)
+    {
+    case PROJECTILE_TYPE_PLAYER_BURST:
+    {
+        Vector2 start_point_direction = Vector2Scale(Vector2Normalize(velocity), g_player_projectile_database[type].radius);
+
+        Vector2 start_point = Vector2Add(position, start_point_direction);
+        Vector2 end_point = Vector2Add(position, Vector2Scale(start_point_direction, -1));
+
+        DrawLineEx(start_point, end_point, 4, WHITE);
+    }
+    break;
+
+    case PROJECTILE_TYPE_PLAYER_CANNON:
+    {
+        Vector2 first_point_direction = Vector2Scale(Vector2Normalize(velocity), g_player_projectile_database[type].radius);
+
+        Vector2 point_1 = Vector2Add(position, first_point_direction);
+        Vector2 point_2 = Vector2Add(position, Vector2Rotate(first_point_direction, 240 * DEG2RAD));
+        Vector2 point_3 = Vector2Add(position, Vector2Rotate(first_point_direction, 120 * DEG2RAD));
+
+        DrawTriangle(point_1, point_2, point_3, WHITE);
+    }
+    break;
+
+    case PROJECTILE_TYPE_PLAYER_AUTOCANNON:
+    {
+        Vector2 first_point_direction = Vector2Scale(Vector2Normalize(velocity), g_player_projectile_database[type].radius);
+
+        Vector2 point_1 = Vector2Add(position, first_point_direction);
+        Vector2 point_2 = Vector2Add(position, Vector2Rotate(first_point_direction, 240 * DEG2RAD));
+        Vector2 point_3 = Vector2Add(position, Vector2Rotate(first_point_direction, 120 * DEG2RAD));
+
+        DrawTriangle(point_1, point_2, point_3, WHITE);
+    }
+    break;
+
+    case PROJECTILE_TYPE_PLAYER_TORPEDO:
+    {
+        Vector2 rectangle_position_direction = Vector2Scale(Vector2Normalize(velocity), g_player_projectile_database[type].radius);
+        Vector2 rectangle_position = Vector2Rotate(rectangle_position_direction, -30 * DEG2RAD);
+        rectangle_position = Vector2Add(rectangle_position, position);
+
+        DrawRectanglePro(
+            (Rectangle){.width = cos(240 * DEG2RAD) * 2 * g_player_projectile_database[type].radius,
+                        .height = sin(240 * DEG2RAD) * 2 * g_player_projectile_database[type].radius,
+                        .x = rectangle_position.x,
+                        .y = rectangle_position.y},
+            (Vector2){.x = 0, .y = 0},
+            Vector2Angle((Vector2){.x = 0, .y = 1}, Vector2Normalize(velocity)) * RAD2DEG,
+            WHITE);
+    }
+    break;
+
+    default:
+        DrawCircle(position.x, position.y, 50, PURPLE);
+        break;
+    }
+}
+
+void projectile_enemy_draw_shape(Projectile_Type_Enemy_e type, Vector2 position, Vector2 velocity)
+{
+    switch (type)
+    {
+    case PROJECTILE_TYPE_ENEMY_SHOOTER:
+    {
+        DrawCircle(position.x, position.y, g_enemy_projectile_database[type].radius, RED);
+    }
+    break;
+
+    case PROJECTILE_TYPE_ENEMY_HEAVY_SHOOTER:
+    {
+        Vector2 rectangle_position_direction = Vector2Scale(Vector2Normalize(velocity), g_enemy_projectile_database[type].radius);
+        Vector2 rectangle_position = Vector2Rotate(rectangle_position_direction, -30 * DEG2RAD);
+        rectangle_position = Vector2Add(rectangle_position, position);
+
+        DrawRectanglePro(
+            (Rectangle){.width = cos(240 * DEG2RAD) * 2 * g_enemy_projectile_database[type].radius,
+                        .height = sin(240 * DEG2RAD) * 2 * g_enemy_projectile_database[type].radius,
+                        .x = rectangle_position.x,
+                        .y = rectangle_position.y},
+            (Vector2){.x = 0, .y = 0},
+            Vector2Angle((Vector2){.x = 0, .y = 1}, Vector2Normalize(velocity)) * RAD2DEG,
+            PURPLE);
+    }
+    break;
+
+    default:
+        DrawCircle(position.x, position.y, 50, PURPLE);
+        break;
+    }
+}
+
+// Rotation in degrees that turns a sprite baked pointing down to face direction
+float atlas_get_rotation(Vector2 direction)
+{
+    return atan2f(-direction.x, direction.y) * RAD2DEG;
+}
+
+void atlas_draw_centered(Rectangle source, Vector2 position, float rotation)
+{
+    DrawTexturePro(
+        g_atlas.texture,
+        source,
+        (Rectangle){.x = position.x, .y = position.y, .width = source.width, .height = source.height},
+        (Vector2){.x = source.width / 2, .y = source.height / 2},
+        rotation,
+        WHITE);
+}
+
+void projectiles_draw()
+{
+    for (int i = pool_next(g_render_view.player_projectiles_occupancy, 0); i >= 0; i = pool_next(g_render_view.player_projectiles_occupancy, i + 1))
+    {
+        const Projectile_Player_t *current_projectile = &g_render_view.player_projectiles[i];
+
+        if (0 < current_projectile->time_wait)
+        {
+            continue;
+        }
+
+        atlas_draw_centered(g_atlas.player_projectiles[current_projectile->type], current_projectile->position, atlas_get_rotation(Vector2Normalize(current_projectile->velocity)));
+    }
+
+    for (int i = pool_next(g_render_view.enemy_projectiles_occupancy, 0); i >= 0; i = pool_next(g_render_view.enemy_projectiles_occupancy, i + 1))
+    {
+        const Projectile_Enemy_t *current_projectile = &g_render_view.enemy_projectiles[i];
+        atlas_draw_centered(g_atlas.enemy_projectiles[current_projectile->type], current_projectile->position, atlas_get_rotation(Vector2Normalize(current_projectile->velocity)));
+    }
+}
+
+void money_draw_ingame()
+{
+    DrawText(TextFormat("$%d", g_render_view.hud.money_displayed), 10, 20, 40, SKYBLUE);
+}
+
+void weapons_update(Game_t *game)
+{
+    for (unsigned char i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        Weapon_t *current_weapon = &game->weapons_data.weapons[i];
+
+        if (!current_weapon->is_unlocked)
+        {
+            continue;
+        }
+
+        game->weapons_data.symbol_alert_timers[i] += game->frame_time;
+
+        if (!(current_weapon->ammo_count >= current_weapon->ammo_count_max))
+        {
+            current_weapon->time_last_reload += game->frame_time;
+        }
+
+        if (current_weapon->time_last_reload >= current_weapon->time_ammo_reload)
+        {
+            current_weapon->time_last_reload -= current_weapon->time_ammo_reload;
+            current_weapon->ammo_count++;
+            game->weapons_data.symbol_alert_timers[current_weapon->type] = 0;
+        }
+
+        if (!game->sim_input.weapons_fired[i])
+        {
+            continue;
+        }
+
+        if (current_weapon->ammo_count <= 0)
+        {
+            continue;
+        }
+
+        current_weapon->ammo_count--;
+
+        for (int j = 0; j < current_weapon->projectile_count; j++)
+        {
+            projectile_player_spawn(game, i, current_weapon->time_projectile_interval * j);
+        }
+    }
+}
+
+void game_over_screen(Game_t *game, bool disable_buttons)
+{
+    enum
+    {
+        BUTTON_NO,
+        BUTTON_YES,
+    };
+
+    DrawText("GAME OVER", g_window.width / 2 - MeasureText("GAME OVER", 40) / 2, 200, 40, RED);
+    DrawText("Try again?", g_window.width / 2 - MeasureText("Try again?", 30) / 2, 275, 30, RED);
+
+    if (ui_panel_begin(UI_PANEL_GAME_OVER, 0))
+    {
+        Ui_Widget_t button = {
+            .color = SKYBLUE,
+            .color_hover = SKYBLUE_LIGHT,
+            .border_thickness = 8,
+            .border_color = BLUE,
+            .font_size = 35,
+            .spacing = 1,
+            .text_color = BLACK,
+        };
+
+        button.bounds = ui_rectangle_centered(g_window.width * (1 / 3.0f), g_window.height * 0.65f, 110, 70);
+        strcpy(button.text, "No");
+        ui_panel_add(UI_PANEL_GAME_OVER, button);
+
+        button.bounds = ui_rectangle_centered(g_window.width * (2 / 3.0f), g_window.height * 0.65f, 110, 70);
+        strcpy(button.text, "Yes");
+        ui_panel_add(UI_PANEL_GAME_OVER, button);
+
+        ui_panel_end(UI_PANEL_GAME_OVER);
+    }
+
+    int clicked = ui_panel_update(UI_PANEL_GAME_OVER, disable_buttons, 0);
+
+    if (clicked == BUTTON_NO)
+    {
+        game->gamestate_previous = game->gamestate_current;
+        game->gamestate_current = STATE_UPGRADE;
+
+        game->transition_time = 0;
+        game->transition_duration = 2;
+    }
+
+    if (clicked == BUTTON_YES)
+    {
+        game->gamestate_previous = game->gamestate_current;
+        game->gamestate_current = STATE_LEVEL;
+        enemy_spawn_director_init_level(game, game->enemy_spawn_director.current_level);
+
+        game->transition_time = 0;
+        game->transition_duration = 4;
+    }
+}
+
+void draw_state_selection_buttons(Game_t *game, bool disable_buttons)
+{
+    short width = 50;
+    short height = 50;
+
+    Gamestate_e destinations[3] = {STATE_LEVEL_SELECTION, STATE_MAIN_MENU, STATE_UPGRADE};
+
+    // The current screen's button is larger and cannot be pressed
+    if (ui_panel_begin(UI_PANEL_STATE_SELECTION, game->gamestate_current))
+    {
+        for (unsigned char i = 0; i < 3; i++)
+        {
+            int x = g_window.width / 2 + 120 * (i - 1);
+            int y = g_window.height * 0.9f;
+            bool is_current = game->gamestate_current == destinations[i];
+
+            ui_panel_add(
+                UI_PANEL_STATE_SELECTION,
+                (Ui_Widget_t){
+                    .bounds = ui_rectangle_centered(x, y, width + 10 * is_current, height + 10 * is_current),
+                    .color = SKYBLUE,
+                    .color_hover = SKYBLUE_LIGHT,
+                    .color_disabled = (Color){.r = 200, .g = SKYBLUE.g, .b = 200, .a = 255},
+                    .is_disabled = is_current,
+                    .border_thickness = 5,
+                    .border_color = BLUE,
+                });
+        }
+
+        ui_panel_end(UI_PANEL_STATE_SELECTION);
+    }
+
+    int clicked = ui_panel_update(UI_PANEL_STATE_SELECTION, disable_buttons, 0);
+
+    if (clicked >= 0)
+    {
+        game->transition_duration = 0.5f;
+        game->transition_time = 0;
+
+        game->gamestate_previous = game->gamestate_current;
+        game->gamestate_current = destinations[clicked];
+    }
+}
+
+void level_selector_update(Game_t *game, bool disable_buttons, int offset)
+{
+    DrawText("Choose a Level:", g_window.width / 2 - MeasureText("Choose a Level:", 40) / 2 + offset, g_window.height * 0.12f, 40, SKYBLUE);
+
+    float width_percent = 0.6f;
+    float height_percent = 0.5f;
+
+    Rectangle background = {.x = g_window.width * 0.2f, .y = g_window.height * 0.3f, .width = g_window.width * width_percent, .height = g_window.height * height_percent};
+
+    int rows = 5;
+    int columns = 6;
+
+    DrawRectangleRec((Rectangle){.x = background.x + offset, .y = background.y, .width = background.width, .height = background.height}, ORANGE);
+    DrawRectangleLinesEx((Rectangle){.x = background.x + offset, .y = background.y, .width = background.width, .height = background.height}, 10, BROWN);
+
+    // Locked levels only change when a level is won
+    if (ui_panel_begin(UI_PANEL_LEVEL_SELECTOR, game->enemy_spawn_director.next_level))
+    {
+        float button_width = g_window.width * width_percent / (columns + 1) * 0.8f;
+        float button_height = g_window.height * height_percent / (rows + 1) * 0.8f;
+
+        for (int i = 0; i < g_levels_data.LEVEL_COUNT; i++)
+        {
+            int row_num = (floor(i / (float)columns)) + 1;
+
+            Ui_Widget_t button = {
+                .bounds = ui_rectangle_centered(
+                    background.x + g_window.width * (width_percent / (columns + 1)) * ((i + 1) - (row_num - 1) * columns),
+                    background.y + g_window.height * (height_percent / (rows + 1)) * row_num,
+                    button_width,
+                    button_height),
+                .color = SKYBLUE,
+                .color_hover = SKYBLUE_LIGHT,
+                .color_disabled = GRAY,
+                .is_disabled = i > game->enemy_spawn_director.next_level,
+                .border_thickness = 3,
+                .border_color = DARKBLUE,
+                .font_size = 15,
+                .spacing = 3,
+                .text_color = BLACK,
+            };
+
+            snprintf(button.text, sizeof(button.text), "%d", i + 1);
+            ui_panel_add(UI_PANEL_LEVEL_SELECTOR, button);
+        }
+
+        ui_panel_end(UI_PANEL_LEVEL_SELECTOR);
+    }
+
+    int clicked = ui_panel_update(UI_PANEL_LEVEL_SELECTOR, disable_buttons, offset);
+
+    if (clicked >= 0)
+    {
+        game->transition_time = 0;
+        game->transition_duration = 4;
+
+        game->gamestate_previous = STATE_LEVEL_SELECTION;
+        enemy_spawn_director_init_level(game, clicked);
+    }
+}
+
+void upgrade_menu_update(Game_t *game, bool disable_buttons, int offset)
+{
+    enum
+    {
+        BUTTON_NEXT_LEVEL,
+        BUTTON_FIRST_UPGRADE, // One per weapon type
+    };
+
+    DrawText("Upgrades:", g_window.width / 2 - MeasureText("Upgrades:", 40) / 2 + offset, g_window.height * 0.08f, 40, SKYBLUE);
+    DrawText(TextFormat("$%d", game->player_data.money + game->player_data.transaction_money_remaining), g_window.width / 2 - MeasureText(TextFormat("$%d", game->player_data.money + game->player_data.transaction_money_remaining), 35) / 2 + offset, g_window.height * 0.08f + 50, 35, SKYBLUE);
+
+    if (ui_panel_begin(UI_PANEL_UPGRADE, 0))
+    {
+        ui_panel_add(
+            UI_PANEL_UPGRADE,
+            (Ui_Widget_t){
+                .bounds = ui_rectangle_centered(g_window.width / 2, g_window.height * 0.75f, 260, 65),
+                .color = SKYBLUE,
+                .color_hover = SKYBLUE_LIGHT,
+                .border_thickness = 5,
+                .border_color = BLUE,
+                .text = "Next Level >>",
+                .font_size = 30,
+                .spacing = 1,
+                .text_color = BLACK,
+            });
+
+        for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+        {
+            ui_panel_add(
+                UI_PANEL_UPGRADE,
+                (Ui_Widget_t){
+                    .bounds = ui_rectangle_centered(g_window.width * 0.5f, g_window.height * 0.25f + 60 * i, 30, 40),
+                    .color = SKYBLUE,
+                    .color_hover = SKYBLUE_LIGHT,
+                    .color_disabled = (Color){.r = 30, .g = 50, .b = 75, .a = 255},
+                    .text = "+",
+                    .font_size = 40,
+                    .text_color = BLACK,
+                });
+        }
+
+        ui_panel_end(UI_PANEL_UPGRADE);
+    }
+
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        bool is_unavailable = game->player_data.money < game->weapons_data.upgrade_cost[i] || game->weapons_data.weapons[i].level_current >= game->weapons_data.level_max;
+        ui_widget_set_disabled(UI_PANEL_UPGRADE, BUTTON_FIRST_UPGRADE + i, is_unavailable);
+    }
+
+    int clicked = ui_panel_update(UI_PANEL_UPGRADE, disable_buttons, offset);
+
+    if (clicked == BUTTON_NEXT_LEVEL)
+    {
+        game->gamestate_previous = game->gamestate_current;
+        enemy_spawn_director_init_level(game, game->enemy_spawn_director.next_level);
+
+        game->transition_time = 0;
+        game->transition_duration = 4;
+    }
+
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        game->weapons_data.upgrade_transitions[i] -= game->frame_time;
+
+        int text_x = g_window.width * 0.5f + offset;
+        int text_y = g_window.height * 0.25f + 60 * i;
+        Color weapon_name_color = SKYBLUE;
+
+        if (!game->weapons_data.weapons[i].is_unlocked)
+        {
+            weapon_name_color = (Color){.r = 30, .g = 50, .b = 75, .a = 255};
+        }
+
+        DrawText(TextFormat("%s", game->weapons_data.names[i]), 50 + offset, text_y - 15, 25, weapon_name_color);
+        DrawText(TextFormat("$%d", game->weapons_data.upgrade_cost[i]), text_x - MeasureText(TextFormat("$%d", game->weapons_data.upgrade_cost[i]), 25) - 30, g_window.height * 0.25f + 60 * i - 15, 25, SKYBLUE);
+
+        if (clicked == BUTTON_FIRST_UPGRADE + i)
+        {
+            money_remove(game, game->weapons_data.upgrade_cost[i]);
+
+            if (game->weapons_data.weapons[i].is_unlocked)
+            {
+                game->weapons_data.upgrade_cost[i] *= game->weapons_data.cost_scaling;
+                game->weapons_data.weapons[i].level_current++;
+
+                if (game->weapons_data.upgrade_transitions[i] < 0)
+                {
+                    game->weapons_data.upgrade_transitions[i] = game->weapons_data.upgrade_transition_duration;
+                }
+                else
+                {
+                    game->weapons_data.upgrade_transitions[i] += game->weapons_data.upgrade_transition_duration;
+                }
+            }
+            else
+            {
+                game->weapons_data.weapons[i].is_unlocked = true;
+            }
+        }
+
+        for (int j = 0; j < game->weapons_data.level_max; j++)
+        {
+            Color indicator_color_bought = SKYBLUE;
+            Color indicator_color_not_bought = (Color){.r = 30, .g = 50, .b = 75, .a = 255};
+
+            int j_draw = (int)floor(game->weapons_data.upgrade_transitions[i] / game->weapons_data.upgrade_transition_duration);
+
+            if (game->weapons_data.upgrade_transitions[i] > 0 && j >= game->weapons_data.weapons[i].level_current - (j_draw + 1) && j < game->weapons_data.weapons[i].level_current)
+            {
+                DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_not_bought);
+
+                if (j != game->weapons_data.weapons[i].level_current - 1)
+                {
+                    continue;
+                }
+
+                DrawRectangle(text_x + 40 + 25 * (j - j_draw), text_y - 20, 15 * (1 - Clamp(game->weapons_data.upgrade_transitions[i] / game->weapons_data.upgrade_transition_duration - j_draw, 0, 1)), 40, SKYBLUE);
+                continue;
+            }
+
+            if (j < game->weapons_data.weapons[i].level_current)
+            {
+                DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_bought);
+                continue;
+            }
+
+            DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_not_bought);
+        }
+    }
+}
+
+void main_menu_update(Game_t *game, int offset)
+{
+    g_main_menu_data.bounce_timer += (game->frame_time * g_main_menu_data.bounce_speed);
+    if (g_main_menu_data.bounce_timer > PI)
+    {
+        g_main_menu_data.bounce_timer -= PI;
+    }
+
+    float bounce = g_main_menu_data.bounce_distance * sin(g_main_menu_data.bounce_timer);
+
+    DrawText("- Welcome -", g_window.width / 2 - MeasureText("- Welcome -", 40) / 2 + offset, g_window.height * 0.4f, 40, SKYBLUE);
+
+    DrawText("<-- Levels", 50 + offset + bounce, g_window.height * 0.20f, 40, SKYBLUE);
+    DrawText("Upgrades -->", g_window.width - MeasureText("Upgrades ->", 40) - 50 + offset - bounce, g_window.height * 0.6f, 40, SKYBLUE);
+}
+
+void background_update(Game_t *game)
+{
+    game->stars_data.twinkle_x += game->frame_time;
+    for (int i = 0; i < game->stars_data.star_count; i++)
+    {
+        Vector2 speed = game->stars_data.star_speeds[game->stars_data.stars[i].speed_index];
+        speed = Vector2Scale(speed, game->frame_time);
+
+        game->stars_data.stars[i].position = Vector2Add(game->stars_data.stars[i].position, speed);
+
+        if (game->stars_data.stars[i].position.x < -game->stars_data.padding_x - 10 || game->stars_data.stars[i].position.x > g_window.width + game->stars_data.padding_x + 10 || game->stars_data.stars[i].position.y > g_window.height + 10 || game->stars_data.stars[i].position.y < -10)
+        {
+            int chosen_position = rand_next_from(&game->rng.cosmetic_state) % (g_window.width + 2 * game->stars_data.padding_x + g_window.height) - game->stars_data.padding_x;
+
+            if (chosen_position > g_window.width + game->stars_data.padding_x)
+            {
+                game->stars_data.stars[i].position = (Vector2){.x = g_window.width + game->stars_data.padding_x + 5, .y = chosen_position - g_window.width - game->stars_data.padding_x};
+                continue;
+            }
+
+            game->stars_data.stars[i].position = (Vector2){.x = chosen_position, .y = -5};
+            continue;
+        }
+    }
+}
+
+void background_draw(Game_t *game)
+{
+    for (int i = 0; i < game->stars_data.star_count; i++)
+    {
+        const Star_t *current_star = &g_render_view.stars[i];
+
+        Color color = game->stars_data.star_colors[current_star->color_index];
+        DrawCircle(
+            current_star->position.x - (g_window.width * game->stars_data.screen_scroll),
+            current_star->position.y,
+            current_star->radius,
+            (Color){.a = 255 * ((sin((g_render_view.twinkle_x + current_star->twinkle_offset) * game->stars_data.twinkle_speed) + 1) / 2), .r = color.r, .g = color.g, .b = color.b});
+    }
+}
+
+void particles_draw()
+{
+    const Particle_Pool_t *pool = g_render_view.particles;
+
+    // Every particle is an untextured quad, so raylib batches all of them into a few draw calls
+    for (int k = pool->live_count; k > 0; k--)
+    {
+        int i = (pool->oldest - k + PARTICLES_COUNT) % PARTICLES_COUNT;
+
+        if (pool->time_alive[i] >= pool->time_lifetime[i])
+        {
+            continue;
+        }
+
+        float life = pool->time_alive[i] / pool->time_lifetime[i];
+        float size = pool->size[i] * (1 - life * 0.5f);
+
+        Color color = pool->color[i];
+        color.a = (1 - life) * color.a;
+
+        DrawRectangleV((Vector2){.x = pool->position_x[i] - size / 2, .y = pool->position_y[i] - size / 2}, (Vector2){.x = size, .y = size}, color);
+    }
+}
+
+void draw_player_health()
+{
+    DrawText(TextFormat("Station: %d/%d", g_render_view.hud.player_current_health, g_render_view.hud.player_max_health), g_window.width * (1 / 3.0f) - MeasureText(TextFormat("Station: %d/%d", g_render_view.hud.player_current_health, g_render_view.hud.player_max_health), 20) / 2, 30, 20, SKYBLUE);
+    DrawText(TextFormat("Planet: %d/%d", g_render_view.hud.planet_current_health, g_render_view.hud.planet_max_health), g_window.width * (2 / 3.0f) - MeasureText(TextFormat("Planet: %d/%d", g_render_view.hud.planet_current_health, g_render_view.hud.planet_max_health), 20) / 2, 30, 20, SKYBLUE);
+}
+
+void player_update(Game_t *game)
+{
+    if (game->sim_input.cheat_player_health)
+    {
+        game->player_data.player_current_health += 100;
+    }
+
+    if (game->sim_input.cheat_planet_health)
+    {
+        game->player_data.planet_current_health += 100;
+    }
+
+    game->player_data.rotation += game->player_data.rotation_speed * game->frame_time;
+
+    if (game->player_data.rotation > 360)
+    {
+        game->player_data.rotation -= 360;
+    }
+
+    if (game->player_data.player_current_health <= 0)
+    {
+        game->player_data.color = (Color){.r = 255, .g = 0, .b = 0, .a = 0};
+
+        game->player_data.player_current_health += 9999;
+        game->player_data.planet_current_health += 9999;
+
+        explosion_spawn(game, game->player_data.center, 2.5f, 250, ORANGE);
+
+        game->gamestate_previous = game->gamestate_current;
+        game->gamestate_current = STATE_GAMEOVER;
+
+        game->transition_time = 0;
+        game->transition_duration = 4;
+    }
+
+    if (game->player_data.planet_current_health <= 0)
+    {
+        game->player_data.player_current_health += 9999;
+        game->player_data.planet_current_health += 9999;
+
+        explosion_spawn(game, (Vector2){.x = g_window.width / 2, .y = g_window.height}, 3.0f, 800, ORANGE);
+
+        game->gamestate_previous = game->gamestate_current;
+        game->gamestate_current = STATE_GAMEOVER;
+
+        game->transition_time = 0;
+        game->transition_duration = 4;
+    }
+}
+
+void player_draw(Game_t *game)
+{
+    Rectangle player_graphic = {.x = game->player_data.center.x, .y = game->player_data.center.y, .width = game->player_data.hitbox_radius * 2, .height = game->player_data.hitbox_radius * 2};
+
+    DrawCircleV(game->player_data.center, game->player_data.hitbox_radius, g_render_view.hud.player_color);
+    DrawRectanglePro(player_graphic, (Vector2){.x = game->player_data.hitbox_radius, .y = game->player_data.hitbox_radius}, g_render_view.hud.player_rotation, g_render_view.hud.player_color);
+}
+
+void draw_cheat_keys()
+{
+    DrawRectangle(0, 0, g_window.width, g_window.height, BLACK);
+    DrawText("L: Give 1500 money", 20, 40, 25, SKYBLUE);
+    DrawText("O: Kill all enemies", 20, 80, 25, SKYBLUE);
+    DrawText("P: End level", 20, 120, 25, SKYBLUE);
+    DrawText("K: Hold to speed up time by 5x", 20, 160, 25, SKYBLUE);
+    DrawText("J: Hold to speed up time by 10x", 20, 200, 25, SKYBLUE);
+    DrawText("U: Hold to fast-forward levels", 20, 240, 25, SKYBLUE);
+    DrawText("N: Give 100 Player Health", 20, 280, 25, SKYBLUE);
+    DrawText("M: Give 100 Planet Health", 20, 320, 25, SKYBLUE);
+    DrawText("G: Unlock next level", 20, 360, 25, SKYBLUE);
+    DrawText("T: Unlock all levels", 20, 400, 25, SKYBLUE);
+    DrawText("R: Reset all levels", 20, 440, 25, SKYBLUE);
+    DrawText("F5: Save state", 20, 480, 25, SKYBLUE);
+    DrawText("F9: Load saved state (in a level)", 20, 520, 25, SKYBLUE);
+    DrawText("F6: Rewind, left/right to step a tick", 20, 560, 25, SKYBLUE);
+    DrawText("F7: Cycle world render scale", 20, 600, 25, SKYBLUE);
+    DrawText("F8: Toggle bilinear upscaling", 20, 640, 25, SKYBLUE);
+}
+
+Color get_symbol_background_color(Game_t *game, Weapon_Type_e type)
+{
+    Color color = game->weapons_data.symbol_color_default;
+
+    if (g_render_view.weapons[type].ammo_count >= g_render_view.weapons[type].ammo_count_max)
+    {
+        color = game->weapons_data.symbol_color_full;
+    }
+    else if (g_render_view.weapons[type].ammo_count > 0)
+    {
+        color = game->weapons_data.symbol_color_not_empty;
+    }
+
+    if (!g_player_settings.weapon_ready_alert)
+    {
+        return color;
+    }
+
+    if ((g_render_view.symbol_alert_timers[type] < game->weapons_data.symbol_alert_duration * (1 / 3.0f) || g_render_view.symbol_alert_timers[type] > game->weapons_data.symbol_alert_duration * (2 / 3.0f)) && g_render_view.symbol_alert_timers[type] < game->weapons_data.symbol_alert_duration)
+    {
+        color = game->weapons_data.symbol_color_alert;
+    }
+
+    return color;
+}
+
+// Only used to bake the atlas
+void weapon_symbol_draw_shape(Game_t *game, Weapon_Type_e type, const int SYMBOL_X, const int SYMBOL_Y)
+{
+    switch (type)
+    {
+    case WEAPON_TYPE_BURST:
+    {
+        const int LINE_LENGTH = 20;
+        DrawLineEx(
+            (Vector2){.x = SYMBOL_X + (float)1 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + game->weapons_data.symbol_height - (game->weapons_data.symbol_height - LINE_LENGTH) / 2 + LINE_LENGTH / 2},
+            (Vector2){.x = SYMBOL_X + (float)1 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + (game->weapons_data.symbol_height - LINE_LENGTH) / 2 + LINE_LENGTH / 2},
+            4,
+            BLACK);
+
+        DrawLineEx(
+            (Vector2){.x = SYMBOL_X + (float)2 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + game->weapons_data.symbol_height - (game->weapons_data.symbol_height - LINE_LENGTH) / 2},
+            (Vector2){.x = SYMBOL_X + (float)2 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + (game->weapons_data.symbol_height - LINE_LENGTH) / 2},
+            4,
+            BLACK);
+
+        DrawLineEx(
+            (Vector2){.x = SYMBOL_X + (float)3 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + game->weapons_data.symbol_height - (game->weapons_data.symbol_height - LINE_LENGTH) / 2 - LINE_LENGTH / 2},
+            (Vector2){.x = SYMBOL_X + (float)3 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + (game->weapons_data.symbol_height - LINE_LENGTH) / 2 - LINE_LENGTH / 2},
+            4,
+            BLACK);
+
+        DrawLineEx(
+            (Vector2){.x = SYMBOL_X + (float)4 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + game->weapons_data.symbol_height - (game->weapons_data.symbol_height - LINE_LENGTH) / 2},
+            (Vector2){.x = SYMBOL_X + (float)4 / 5 * game->weapons_data.symbol_width, .y = SYMBOL_Y + (game->weapons_data.symbol_height - LINE_LENGTH) / 2},
+            4,
+            BLACK);
+    }
+    break;
+
+    case WEAPON_TYPE_CANNON:
+    {
+        const Vector2 FIRST_POINT_DIRECTION = {.x = 0, .y = -20};
+        const Vector2 TRIANGLE_CENTER = {.x = SYMBOL_X + game->weapons_data.symbol_width / 2, .y = SYMBOL_Y + game->weapons_data.symbol_height / 2};
+
+        Vector2 point_1 = Vector2Add(TRIANGLE_CENTER, FIRST_POINT_DIRECTION);
+        Vector2 point_2 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 240 * (3.14f / 180)));
+        Vector2 point_3 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 120 * (3.14f / 180)));
+
+        DrawTriangle(point_1, point_2, point_3, BLACK);
+    }
+    break;
+
+    case WEAPON_TYPE_AUTOCANNON:
+    {
+        // A row of small cannon shells
+        const Vector2 FIRST_POINT_DIRECTION = {.x = 0, .y = -9};
+
+        for (int j = 1; j <= 3; j++)
+        {
+            const Vector2 TRIANGLE_CENTER = {.x = SYMBOL_X + (float)j / 4 * game->weapons_data.symbol_width, .y = SYMBOL_Y + game->weapons_data.symbol_height / 2};
+
+            Vector2 point_1 = Vector2Add(TRIANGLE_CENTER, FIRST_POINT_DIRECTION);
+            Vector2 point_2 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 240 * DEG2RAD));
+            Vector2 point_3 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 120 * DEG2RAD));
+
+            DrawTriangle(point_1, point_2, point_3, BLACK);
+        }
+    }
+    break;
+
+    case WEAPON_TYPE_TORPEDO:
+    {
+        // Nose, body and tail fins
+        const int CENTER_X = SYMBOL_X + game->weapons_data.symbol_width / 2;
+
+        DrawTriangle(
+            (Vector2){.x = CENTER_X, .y = SYMBOL_Y + 8},
+            (Vector2){.x = CENTER_X - 6, .y = SYMBOL_Y + 18},
+            (Vector2){.x = CENTER_X + 6, .y = SYMBOL_Y + 18},
+            BLACK);
+        DrawRectangle(CENTER_X - 6, SYMBOL_Y + 18, 12, 28, BLACK);
+        DrawRectangle(CENTER_X - 11, SYMBOL_Y + 44, 22, 6, BLACK);
+    }
+    break;
+
+    default:
+        break;
+    }
+}
+
+void weapons_draw_symbols(Game_t *game)
+{
+    const short AMMO_COUNTER_Y = game->weapons_data.symbol_draw_area_y + 15;
+    const short AMMO_COUNTER_FONT_SIZE = 25;
+
+    const unsigned char RELOAD_INDICATOR_WIDTH = 20;
+
+    DrawRectangle(0, game->weapons_data.symbol_draw_area_y, g_window.width, g_window.height, GRAY);
+
+    const unsigned char SYMBOL_OFFSET_Y = 20;
+
+    // Text uses the font texture, so it is drawn in a second pass to keep the atlas draws in one batch
+    for (Weapon_Type_e i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        if (!g_render_view.weapons[i].is_unlocked)
+        {
+            continue;
+        }
+
+        const int SYMBOL_X = ((float)(i + 1) / (WEAPON_TYPE_COUNT + 1)) * g_window.width - game->weapons_data.symbol_width / 2;
+        const int SYMBOL_Y = g_window.height - game->weapons_data.symbol_height - SYMBOL_OFFSET_Y;
+
+        // Symbol background
+        DrawRectangle(
+            SYMBOL_X,
+            (g_window.height - game->weapons_data.symbol_height) - 20,
+            game->weapons_data.symbol_width,
+            game->weapons_data.symbol_height,
+            get_symbol_background_color(game, i));
+
+        DrawRectangle(SYMBOL_X, SYMBOL_Y + game->weapons_data.symbol_height, -RELOAD_INDICATOR_WIDTH, Clamp(g_render_view.weapons[i].time_last_reload / g_render_view.weapons[i].time_ammo_reload, 0, 1) * game->weapons_data.symbol_height * -1, GREEN);
+
+        DrawTextureRec(g_atlas.texture, g_atlas.weapon_symbols[i], (Vector2){.x = SYMBOL_X, .y = SYMBOL_Y}, WHITE);
+    }
+
+    for (Weapon_Type_e i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        if (!g_render_view.weapons[i].is_unlocked)
+        {
+            continue;
+        }
+
+        const int SYMBOL_X = ((float)(i + 1) / (WEAPON_TYPE_COUNT + 1)) * g_window.width - game->weapons_data.symbol_width / 2;
+
+        // Ammo counter
+        DrawText(TextFormat("%d", g_render_view.weapons[i].ammo_count), SYMBOL_X, AMMO_COUNTER_Y, 25, SKYBLUE);
+        DrawText("|", SYMBOL_X + game->weapons_data.symbol_width / 2 - MeasureText("|", AMMO_COUNTER_FONT_SIZE), AMMO_COUNTER_Y, AMMO_COUNTER_FONT_SIZE, SKYBLUE);
+        {
+            const char *text = TextFormat("%d", g_render_view.weapons[i].ammo_count_max);
+            DrawText(text, SYMBOL_X + game->weapons_data.symbol_width - MeasureText(text, AMMO_COUNTER_FONT_SIZE), AMMO_COUNTER_Y, 25, SKYBLUE);
+        }
+    }
+}
+
+// Packs a sprite into the next free spot of the atlas, rows wrap at its width
+Rectangle atlas_allocate(Vector2 *cursor, float *row_height, int width, int height)
+{
+    if (cursor->x + width + g_atlas.PADDING > g_atlas.WIDTH)
+    {
+        cursor->x = 0;
+        cursor->y += *row_height;
+        *row_height = 0;
+    }
+
+    Rectangle sprite = {.x = cursor->x + g_atlas.PADDING, .y = cursor->y + g_atlas.PADDING, .width = width, .height = height};
+
+    cursor->x += width + g_atlas.PADDING;
+    *row_height = fmax(*row_height, height + g_atlas.PADDING);
+
+    return sprite;
+}
+
+// Projectile sprites are square around the projectile position, big enough for its shape and line thickness
+int atlas_get_projectile_size(float radius)
+{
+    return 2 * ceil(radius + 2);
+}
+
+void atlas_bake(Game_t *game)
+{
+    Vector2 cursor = {0};
+    float row_height = 0;
+
+    g_atlas.white = atlas_allocate(&cursor, &row_height, 4, 4);
+
+    for (Weapon_Type_e i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        g_atlas.weapon_symbols[i] = atlas_allocate(&cursor, &row_height, game->weapons_data.symbol_width, game->weapons_data.symbol_height);
+    }
+
+    for (int i = 0; i < PROJECTILE_TYPE_PLAYER_COUNT; i++)
+    {
+        int size = atlas_get_projectile_size(g_player_projectile_database[i].radius);
+        g_atlas.player_projectiles[i] = atlas_allocate(&cursor, &row_height, size, size);
+    }
+
+    for (int i = 0; i < PROJECTILE_TYPE_ENEMY_COUNT; i++)
+    {
+        int size = atlas_get_projectile_size(g_enemy_projectile_database[i].radius);
+        g_atlas.enemy_projectiles[i] = atlas_allocate(&cursor, &row_height, size, size);
+    }
+
+    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+    {
+        g_atlas.enemies[i] = atlas_allocate(&cursor, &row_height, g_enemy_database[i].width, g_enemy_database[i].height);
+    }
+
+    RenderTexture2D target = LoadRenderTexture(g_atlas.WIDTH, cursor.y + row_height + g_atlas.PADDING);
+
+    BeginTextureMode(target);
+    ClearBackground(BLANK);
+
+    DrawRectangleRec(g_atlas.white, WHITE);
+
+    for (Weapon_Type_e i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        weapon_symbol_draw_shape(game, i, g_atlas.weapon_symbols[i].x, g_atlas.weapon_symbols[i].y);
+    }
+
+    // Baked pointing down, see atlas_get_rotation()
+    for (int i = PROJECTILE_TYPE_PLAYER_NONE + 1; i < PROJECTILE_TYPE_PLAYER_COUNT; i++)
+    {
+        Rectangle sprite = g_atlas.player_projectiles[i];
+        projectile_player_draw_shape(i, (Vector2){.x = sprite.x + sprite.width / 2, .y = sprite.y + sprite.height / 2}, (Vector2){.x = 0, .y = 1});
+    }
+
+    for (int i = PROJECTILE_TYPE_ENEMY_NONE + 1; i < PROJECTILE_TYPE_ENEMY_COUNT; i++)
+    {
+        Rectangle sprite = g_atlas.enemy_projectiles[i];
+        projectile_enemy_draw_shape(i, (Vector2){.x = sprite.x + sprite.width / 2, .y = sprite.y + sprite.height / 2}, (Vector2){.x = 0, .y = 1});
+    }
+
+    for (int i = ENEMY_TYPE_NONE + 1; i < ENEMY_TYPE_COUNT; i++)
+    {
+        DrawRectangleRec(g_atlas.enemies[i], g_enemy_database[i].color);
+    }
+
+    EndTextureMode();
+
+    // Render textures come out upside down, flipping once here keeps every sprite rectangle the right way up
+    Image image = LoadImageFromTexture(target.texture);
+    ImageFlipVertical(&image);
+    g_atlas.texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    UnloadRenderTexture(target);
+
+    // Sample the middle of the white block so filtering never reaches its edges
+    SetShapesTexture(g_atlas.texture, (Rectangle){.x = g_atlas.white.x + 1, .y = g_atlas.white.y + 1, .width = 2, .height = 2});
+}
+
+void save_state_capture(Game_t *game, Save_State_t *state)
+{
+    state->player_current_health = game->player_data.player_current_health;
+    state->player_max_health = game->player_data.player_max_health;
+    state->planet_current_health = game->player_data.planet_current_health;
+    state->planet_max_health = game->player_data.planet_max_health;
+    state->player_color = game->player_data.color;
+    state->player_rotation = game->player_data.rotation;
+    state->player_center = game->player_data.center;
+    state->money = game->player_data.money;
+    state->transaction_timer = game->player_data.transaction_timer;
+    state->transaction_timer_buffer = game->player_data.transaction_timer_buffer;
+    state->transaction_money_remaining = game->player_data.transaction_money_remaining;
+
+    memcpy(state->upgrade_cost, game->weapons_data.upgrade_cost, sizeof(state->upgrade_cost));
+    memcpy(state->weapons, game->weapons_data.weapons, sizeof(state->weapons));
+    memcpy(state->upgrade_transitions, game->weapons_data.upgrade_transitions, sizeof(state->upgrade_transitions));
+    memcpy(state->symbol_alert_timers, game->weapons_data.symbol_alert_timers, sizeof(state->symbol_alert_timers));
+    for (int i = 0; i < PROJECTILE_TYPE_PLAYER_COUNT; i++)
+    {
+        state->player_projectile_damage[i] = game->projectiles_data.player_projectile_damage[i];
+    }
+
+    memcpy(state->enemies, game->enemies_data.enemies, sizeof(state->enemies));
+    state->enemies_time_elapsed = game->enemies_data.time_elapsed;
+    memcpy(state->player_projectiles, game->projectiles_data.player_projectiles, sizeof(state->player_projectiles));
+    memcpy(state->enemy_projectiles, game->projectiles_data.enemy_projectiles, sizeof(state->enemy_projectiles));
+
+    state->spawn_schedule_seed = game->spawn_schedule.seed;
+    state->spawn_entry_next = game->spawn_schedule.entry_next;
+    state->current_level = game->enemy_spawn_director.current_level;
+    state->next_level = game->enemy_spawn_director.next_level;
+
+    state->rng_state = game->rng.state;
+}
+
+void save_state_restore(Game_t *game, const Save_State_t *STATE)
+{
+    game->player_data.player_current_health = STATE->player_current_health;
+    game->player_data.player_max_health = STATE->player_max_health;
+    game->player_data.planet_current_health = STATE->planet_current_health;
+    game->player_data.planet_max_health = STATE->planet_max_health;
+    game->player_data.color = STATE->player_color;
+    game->player_data.rotation = STATE->player_rotation;
+    game->player_data.center = STATE->player_center;
+    game->player_data.money = STATE->money;
+    game->player_data.transaction_timer = STATE->transaction_timer;
+    game->player_data.transaction_timer_buffer = STATE->transaction_timer_buffer;
+    game->player_data.transaction_money_remaining = STATE->transaction_money_remaining;
+
+    memcpy(game->weapons_data.upgrade_cost, STATE->upgrade_cost, sizeof(STATE->upgrade_cost));
+    memcpy(game->weapons_data.weapons, STATE->weapons, sizeof(STATE->weapons));
+    memcpy(game->weapons_data.upgrade_transitions, STATE->upgrade_transitions, sizeof(STATE->upgrade_transitions));
+    memcpy(game->weapons_data.symbol_alert_timers, STATE->symbol_alert_timers, sizeof(STATE->symbol_alert_timers));
+    for (int i = 0; i < PROJECTILE_TYPE_PLAYER_COUNT; i++)
+    {
+        game->projectiles_data.player_projectile_damage[i] = STATE->player_projectile_damage[i];
+    }
+
+    memcpy(game->enemies_data.enemies, STATE->enemies, sizeof(STATE->enemies));
+    game->enemies_data.time_elapsed = STATE->enemies_time_elapsed;
+    enemies_rebuild_lists(game);
+    memcpy(game->projectiles_data.player_projectiles, STATE->player_projectiles, sizeof(STATE->player_projectiles));
+    memcpy(game->projectiles_data.enemy_projectiles, STATE->enemy_projectiles, sizeof(STATE->enemy_projectiles));
+    projectiles_rebuild_occupancy(game);
+    impacts_rebuild(game);
+
+    game->enemy_spawn_director.current_level = STATE->current_level;
+    game->enemy_spawn_director.next_level = STATE->next_level;
+    spawn_schedule_use(game, STATE->current_level, STATE->spawn_schedule_seed);
+    game->spawn_schedule.entry_next = STATE->spawn_entry_next;
+
+    game->rng.state = STATE->rng_state;
+}
+
+bool save_state_write_file(Game_t *game, const char *path)
+{
+    Save_State_Header_t header = {.version = g_save_files.VERSION, .state_size = sizeof(Save_State_t)};
+    memcpy(header.magic, g_save_files.MAGIC, sizeof(header.magic));
+
+    // On the heap to keep a 30 KB struct off the stack of the simulation thread, games saving side by side get one each
+    Save_State_t *state = malloc(sizeof(Save_State_t));
+    if (state == NULL)
+    {
+        printf("Could not allocate a save state for %s\n", path);
+        return false;
+    }
+    save_state_capture(game, state);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Could not open %s for saving\n", path);
+        free(state);
+        return false;
+    }
+
+    bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(state, sizeof(Save_State_t), 1, file) == 1;
+    fclose(file);
+    free(state);
+
+    if (!is_written)
+    {
+        printf("Could not write save state to %s\n", path);
+    }
+
+    return is_written;
+}
+
+// Leaves the game untouched if the file is missing or was written by a different version
+bool save_state_read_file(Game_t *game, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    Save_State_Header_t header = {0};
+    Save_State_t *state = malloc(sizeof(Save_State_t));
+
+    bool is_read = state != NULL && fread(&header, sizeof(header), 1, file) == 1;
+    if (is_read && (memcmp(header.magic, g_save_files.MAGIC, sizeof(header.magic)) != 0 || header.version != g_save_files.VERSION || header.state_size != sizeof(Save_State_t)))
+    {
+        printf("Ignoring %s, it is not a version %u save state\n", path, g_save_files.VERSION);
+        is_read = false;
+    }
+
+    is_read = is_read && fread(state, sizeof(Save_State_t), 1, file) == 1;
+    fclose(file);
+
+    if (is_read)
+    {
+        save_state_restore(game, state);
+    }
+
+    free(state);
+    return is_read;
+}
+
+void progress_load(Game_t *game)
+{
+    if (!save_state_read_file(game, g_save_files.PROGRESS_PATH))
+    {
+        return;
+    }
+
+    // Only the progress is kept, a level that was in progress on exit starts over
+    player_init(game);
+    particles_init(game);
+    projectiles_init(game);
+    enemies_init(game);
+    weapons_init(game);
+}
+
+void progress_save(Game_t *game)
+{
+    save_state_write_file(game, g_save_files.PROGRESS_PATH);
+}
+
+// Writes the bytes of CURRENT XORed with PREVIOUS as alternating [unchanged count][changed count][changed bytes] runs
+// Returns the encoded size
+int rewind_encode(unsigned char *out, const unsigned char *CURRENT, const unsigned char *PREVIOUS, int size)
+{
+    int in = 0;
+    int written = 0;
+
+    while (in < size)
+    {
+        int unchanged_count = 0;
+        while (in + unchanged_count < size && unchanged_count < 0xFFFF && CURRENT[in + unchanged_count] == PREVIOUS[in + unchanged_count])
+        {
+            unchanged_count++;
+        }
+        in += unchanged_count;
+
+        int changed_count = 0;
+        while (in + changed_count < size && changed_count < 0xFFFF && CURRENT[in + changed_count] != PREVIOUS[in + changed_count])
+        {
+            changed_count++;
+        }
+
+        out[written++] = unchanged_count & 0xFF;
+        out[written++] = unchanged_count >> 8;
+        out[written++] = changed_count & 0xFF;
+        out[written++] = changed_count >> 8;
+
+        for (int i = 0; i < changed_count; i++)
+        {
+            out[written++] = CURRENT[in + i] ^ PREVIOUS[in + i];
+        }
+        in += changed_count;
+    }
+
+    return written;
+}
+
+// XORs an encoded delta onto state, which must hold the state it was encoded against
+void rewind_decode(unsigned char *state, const unsigned char *IN, int size)
+{
+    int read = 0;
+    int position = 0;
+
+    while (read < size)
+    {
+        int unchanged_count = IN[read] | (IN[read + 1] << 8);
+        int changed_count = IN[read + 2] | (IN[read + 3] << 8);
+        read += 4;
+
+        position += unchanged_count;
+        for (int i = 0; i < changed_count; i++)
+        {
+            state[position++] ^= IN[read++];
+        }
+    }
+}
+
+Rewind_Entry_t *rewind_entry(int index)
+{
+    return &g_rewind.entries[(g_rewind.entry_first + index) % g_rewind.ENTRIES_COUNT];
+}
+
+void rewind_evict_oldest()
+{
+    g_rewind.entry_first = (g_rewind.entry_first + 1) % g_rewind.ENTRIES_COUNT;
+    g_rewind.entry_count--;
+
+    // Deltas are useless without the keyframe before them
+    while (g_rewind.entry_count > 0 && !rewind_entry(0)->is_keyframe)
+    {
+        g_rewind.entry_first = (g_rewind.entry_first + 1) % g_rewind.ENTRIES_COUNT;
+        g_rewind.entry_count--;
+    }
+}
+
+// Frees the byte range for a new entry of size bytes and returns its offset
+int rewind_make_room(int size)
+{
+    if (g_rewind.byte_write_offset + size > g_rewind.BYTES_COUNT)
+    {
+        // Entries past the write offset are older than everything before it, the gap at the end is abandoned with them
+        while (g_rewind.entry_count > 0 && rewind_entry(0)->offset >= g_rewind.byte_write_offset)
+        {
+            rewind_evict_oldest();
+        }
+
+        g_rewind.byte_write_offset = 0;
+    }
+
+    int start = g_rewind.byte_write_offset;
+    int end = start + size;
+
+    while (g_rewind.entry_count > 0)
+    {
+        Rewind_Entry_t *oldest = rewind_entry(0);
+        bool is_overlapping = oldest->offset < end && start < oldest->offset + oldest->size;
+
+        if (!is_overlapping && g_rewind.entry_count < g_rewind.ENTRIES_COUNT)
+        {
+            break;
+        }
+
+        rewind_evict_oldest();
+    }
+
+    return start;
+}
+
+// Appends the current game state to the history, called once per level tick
+void rewind_record(Game_t *game)
+{
+    static const Save_State_t EMPTY_STATE = {0};
+
+    if (game->recorders == NULL)
+    {
+        return;
+    }
+
+    save_state_capture(game, &g_rewind.state_scratch);
+
+    bool is_keyframe = g_rewind.entry_count == 0 || g_rewind.ticks_since_keyframe >= g_rewind.KEYFRAME_INTERVAL;
+
+    int size = rewind_encode(g_rewind.encode_buffer, (const unsigned char *)&g_rewind.state_scratch, (const unsigned char *)(is_keyframe ? &EMPTY_STATE : &g_rewind.state_previous), sizeof(Save_State_t));
+    int offset = rewind_make_room(size);
+
+    if (!is_keyframe && g_rewind.entry_count == 0)
+    {
+        // Making room evicted the keyframe this delta depends on
+        is_keyframe = true;
+        size = rewind_encode(g_rewind.encode_buffer, (const unsigned char *)&g_rewind.state_scratch, (const unsigned char *)&EMPTY_STATE, sizeof(Save_State_t));
+        offset = rewind_make_room(size);
+    }
+
+    memcpy(&g_rewind.bytes[offset], g_rewind.encode_buffer, size);
+
+    *rewind_entry(g_rewind.entry_count) = (Rewind_Entry_t){.offset = offset, .size = size, .is_keyframe = is_keyframe};
+    g_rewind.entry_count++;
+    g_rewind.byte_write_offset = offset + size;
+
+    g_rewind.ticks_since_keyframe = is_keyframe ? 1 : g_rewind.ticks_since_keyframe + 1;
+    g_rewind.state_previous = g_rewind.state_scratch;
+}
+
+// Rebuilds the state of an entry from the closest keyframe before it
+void rewind_rebuild(Save_State_t *state, int index)
+{
+    int keyframe_index = index;
+    while (!rewind_entry(keyframe_index)->is_keyframe)
+    {
+        keyframe_index--;
+    }
+
+    memset(state, 0, sizeof(*state));
+
+    for (int i = keyframe_index; i <= index; i++)
+    {
+        Rewind_Entry_t *entry = rewind_entry(i);
+        rewind_decode((unsigned char *)state, &g_rewind.bytes[entry->offset], entry->size);
+    }
+}
+
+// Handles the rewind keys, returns true while the level is held on a rewound tick
+bool rewind_update(Game_t *game)
+{
+    if (game->recorders == NULL)
+    {
+        return false;
+    }
+
+    if (game->sim_input.debug_rewind_toggle && g_rewind.entry_count > 0)
+    {
+        if (!g_rewind.is_scrubbing)
+        {
+            g_rewind.is_scrubbing = true;
+            g_rewind.scrub_index = g_rewind.entry_count - 1;
+        }
+        else
+        {
+            // Continue from the displayed tick, the ticks after it are forgotten
+            Rewind_Entry_t *entry = rewind_entry(g_rewind.scrub_index);
+
+            g_rewind.is_scrubbing = false;
+            g_rewind.entry_count = g_rewind.scrub_index + 1;
+            g_rewind.byte_write_offset = entry->offset + entry->size;
+
+            g_rewind.ticks_since_keyframe = 1;
+            for (int i = g_rewind.scrub_index; !rewind_entry(i)->is_keyframe; i--)
+            {
+                g_rewind.ticks_since_keyframe++;
+            }
+
+            rewind_rebuild(&g_rewind.state_previous, g_rewind.scrub_index);
+        }
+    }
+
+    if (!g_rewind.is_scrubbing)
+    {
+        return false;
+    }
+
+    int scrub_index = Clamp(g_rewind.scrub_index + game->sim_input.debug_rewind_steps, 0, g_rewind.entry_count - 1);
+    if (scrub_index != g_rewind.scrub_index || game->sim_input.debug_rewind_toggle)
+    {
+        g_rewind.scrub_index = scrub_index;
+
+        rewind_rebuild(&g_rewind.state_scratch, g_rewind.scrub_index);
+        save_state_restore(game, &g_rewind.state_scratch);
+    }
+
+    return true;
+}
+
+void rewind_draw()
+{
+    if (!g_render_view.hud.is_rewinding)
+    {
+        return;
+    }
+
+    const char *text = TextFormat("REWIND  -%d / %d ticks", g_render_view.hud.rewind_ticks_behind, g_render_view.hud.rewind_ticks_recorded);
+    DrawText(text, g_window.width / 2 - MeasureText(text, 25) / 2, 70, 25, ORANGE);
+}
+
+void turbo_draw()
+{
+    if (g_render_view.hud.turbo_speedup <= 0)
+    {
+        return;
+    }
+
+    const char *text = TextFormat("FAST-FORWARD  x%.0f", g_render_view.hud.turbo_speedup);
+    DrawText(text, g_window.width / 2 - MeasureText(text, 25) / 2, 100, 25, ORANGE);
+}
+
+unsigned long long hash_rotate_left(unsigned long long value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+unsigned long long hash_read_64(const unsigned char *bytes)
+{
+    unsigned long long value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+unsigned long long hash_round(unsigned long long accumulator, unsigned long long input)
+{
+    accumulator += input * 0xC2B2AE3D27D4EB4FULL;
+    accumulator = hash_rotate_left(accumulator, 31);
+    return accumulator * 0x9E3779B185EBCA87ULL;
+}
+
+// Incremental XXH64, bytes can be added in any number of pieces
+void hash_begin(Hash_State_t *hash, unsigned long long seed)
+{
+    hash->seed = seed;
+    hash->accumulators[0] = seed + 0x9E3779B185EBCA87ULL + 0xC2B2AE3D27D4EB4FULL;
+    hash->accumulators[1] = seed + 0xC2B2AE3D27D4EB4FULL;
+    hash->accumulators[2] = seed;
+    hash->accumulators[3] = seed - 0x9E3779B185EBCA87ULL;
+    hash->buffer_size = 0;
+    hash->total_size = 0;
+}
+
+void hash_bytes(Hash_State_t *hash, const void *data, int size)
+{
+    const unsigned char *bytes = data;
+    hash->total_size += size;
+
+    if (hash->buffer_size + size < 32)
+    {
+        memcpy(&hash->buffer[hash->buffer_size], bytes, size);
+        hash->buffer_size += size;
+        return;
+    }
+
+    if (hash->buffer_size > 0)
+    {
+        int fill = 32 - hash->buffer_size;
+        memcpy(&hash->buffer[hash->buffer_size], bytes, fill);
+        bytes += fill;
+        size -= fill;
+
+        for (int i = 0; i < 4; i++)
+        {
+            hash->accumulators[i] = hash_round(hash->accumulators[i], hash_read_64(&hash->buffer[i * 8]));
+        }
+        hash->buffer_size = 0;
+    }
+
+    for (; size >= 32; bytes += 32, size -= 32)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            hash->accumulators[i] = hash_round(hash->accumulators[i], hash_read_64(&bytes[i * 8]));
+        }
+    }
+
+    memcpy(hash->buffer, bytes, size);
+    hash->buffer_size = size;
+}
+
+unsigned long long hash_end(const Hash_State_t *HASH)
+{
+    unsigned long long result;
+
+    if (HASH->total_size >= 32)
+    {
+        result = hash_rotate_left(HASH->accumulators[0], 1) + hash_rotate_left(HASH->accumulators[1], 7) + hash_rotate_left(HASH->accumulators[2], 12) + hash_rotate_left(HASH->accumulators[3], 18);
+
+        for (int i = 0; i < 4; i++)
+        {
+            result ^= hash_round(0, HASH->accumulators[i]);
+            result = result * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+        }
+    }
+    else
+    {
+        result = HASH->seed + 0x27D4EB2F165667C5ULL;
+    }
+
+    result += HASH->total_size;
+
+    int i = 0;
+    for (; i + 8 <= HASH->buffer_size; i += 8)
+    {
+        result ^= hash_round(0, hash_read_64(&HASH->buffer[i]));
+        result = hash_rotate_left(result, 27) * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+    }
+
+    for (; i < HASH->buffer_size; i++)
+    {
+        result ^= HASH->buffer[i] * 0x27D4EB2F165667C5ULL;
+        result = hash_rotate_left(result, 11) * 0x9E3779B185EBCA87ULL;
+    }
+
+    result ^= result >> 33;
+    result *= 0xC2B2AE3D27D4EB4FULL;
+    result ^= result >> 29;
+    result *= 0x165667B19E3779F9ULL;
+    result ^= result >> 32;
+
+    return result;
+}
+
+// Hashes the gameplay fields of the live entities field by field, so that padding, dead slots and
+// cosmetic state (stars, particles, health bar timers) do not affect it
+unsigned long long sim_state_checksum(Game_t *game)
+{
+    Hash_State_t hash;
+    hash_begin(&hash, 0);
+
+    hash_bytes(&hash, &game->gamestate_current, sizeof(game->gamestate_current));
+    hash_bytes(&hash, &game->rng.state, sizeof(game->rng.state));
+
+    hash_bytes(&hash, &game->player_data.player_current_health, sizeof(game->player_data.player_current_health));
+    hash_bytes(&hash, &game->player_data.planet_current_health, sizeof(game->player_data.planet_current_health));
+    hash_bytes(&hash, &game->player_data.money, sizeof(game->player_data.money));
+
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        const Weapon_t *WEAPON = &game->weapons_data.weapons[i];
+        hash_bytes(&hash, &WEAPON->ammo_count, sizeof(WEAPON->ammo_count));
+        hash_bytes(&hash, &WEAPON->time_last_reload, sizeof(WEAPON->time_last_reload));
+    }
+
+    for (int i = pool_next(&game->enemies_data.occupancy, 0); i >= 0; i = pool_next(&game->enemies_data.occupancy, i + 1))
+    {
+        const Enemy_t *ENEMY = &game->enemies_data.enemies[i];
+        int type = ENEMY->type;
+        hash_bytes(&hash, &type, sizeof(type));
+        int current_health = ENEMY->current_health;
+        hash_bytes(&hash, &current_health, sizeof(current_health));
+        hash_bytes(&hash, &ENEMY->spawn_position, sizeof(ENEMY->spawn_position));
+        hash_bytes(&hash, &ENEMY->time_spawned, sizeof(ENEMY->time_spawned));
+        hash_bytes(&hash, &ENEMY->time_last_fired, sizeof(ENEMY->time_last_fired));
+        bool has_attempted_first_shot = flags_has(ENEMY->flags, ENEMY_FLAG_HAS_ATTEMPTED_FIRST_SHOT);
+        hash_bytes(&hash, &has_attempted_first_shot, sizeof(has_attempted_first_shot));
+    }
+
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
+    {
+        const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[i];
+        int type = PROJECTILE->type;
+        hash_bytes(&hash, &type, sizeof(type));
+        hash_bytes(&hash, &PROJECTILE->position, sizeof(PROJECTILE->position));
+        hash_bytes(&hash, &PROJECTILE->velocity, sizeof(PROJECTILE->velocity));
+        hash_bytes(&hash, &PROJECTILE->time_wait, sizeof(PROJECTILE->time_wait));
+        bool is_launched = flags_has(PROJECTILE->flags, PROJECTILE_FLAG_IS_LAUNCHED);
+        hash_bytes(&hash, &is_launched, sizeof(is_launched));
+        hash_bytes(&hash, &PROJECTILE->time_launched, sizeof(PROJECTILE->time_launched));
+        hash_bytes(&hash, &PROJECTILE->launch_position, sizeof(PROJECTILE->launch_position));
+    }
+
+    for (int i = pool_next(&game->projectiles_data.enemy_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.enemy_occupancy, i + 1))
+    {
+        const Projectile_Enemy_t *PROJECTILE = &game->projectiles_data.enemy_projectiles[i];
+        int type = PROJECTILE->type;
+        hash_bytes(&hash, &type, sizeof(type));
+        int health = PROJECTILE->health;
+        hash_bytes(&hash, &health, sizeof(health));
+        hash_bytes(&hash, &PROJECTILE->position, sizeof(PROJECTILE->position));
+        hash_bytes(&hash, &PROJECTILE->velocity, sizeof(PROJECTILE->velocity));
+    }
+
+    hash_bytes(&hash, &game->enemies_data.time_elapsed, sizeof(game->enemies_data.time_elapsed));
+    hash_bytes(&hash, &game->spawn_schedule.seed, sizeof(game->spawn_schedule.seed));
+    hash_bytes(&hash, &game->spawn_schedule.entry_next, sizeof(game->spawn_schedule.entry_next));
+
+    return hash_end(&hash);
+}
+
+void replay_stop_recording(Game_t *game, const char *reason)
+{
+    if (game->recorders == NULL || !g_replay.is_recording)
+    {
+        return;
+    }
+
+    printf("Stopped recording the replay, %s\n", reason);
+    g_replay.is_recording = false;
+}
+
+// Called right before the first simulation step of every tick
+void replay_record_tick_begin(Game_t *game)
+{
+    if (game->recorders == NULL || !g_replay.is_recording || g_replay.tick_count > 0)
+    {
+        return;
+    }
+
+    save_state_capture(game, &g_replay.state_initial);
+}
+
+// Called with the input and time step of a tick that just completed
+void replay_record_tick_end(Game_t *game)
+{
+    if (game->recorders == NULL || !g_replay.is_recording)
+    {
+        return;
+    }
+
+    if (g_replay.tick_count == g_replay.tick_capacity)
+    {
+        int capacity = g_replay.tick_capacity ? g_replay.tick_capacity * 2 : 4096;
+        Replay_Tick_t *ticks = realloc(g_replay.ticks, capacity * sizeof(Replay_Tick_t));
+
+        if (ticks == NULL)
+        {
+            replay_stop_recording(game, "out of memory");
+            return;
+        }
+
+        g_replay.ticks = ticks;
+        g_replay.tick_capacity = capacity;
+    }
+
+    g_replay.ticks[g_replay.tick_count++] = (Replay_Tick_t){
+        .frame_time = game->frame_time,
+        .input = game->sim_input,
+        .checksum = sim_state_checksum(game)};
+}
+
+void replay_write_file(Game_t *game)
+{
+    if (game->recorders == NULL || !g_replay.is_recording)
+    {
+        return;
+    }
+
+    g_replay.is_recording = false;
+
+    Replay_Header_t header = {.version = g_replay.VERSION, .state_size = sizeof(Save_State_t), .tick_size = sizeof(Replay_Tick_t), .tick_count = g_replay.tick_count, .is_fixed_point = SIM_FIXED_POINT, .is_impact_events = SIM_IMPACT_EVENTS};
+    memcpy(header.magic, g_replay.MAGIC, sizeof(header.magic));
+
+    FILE *file = fopen(game->recorders->replay_path, "wb");
+    if (file == NULL)
+    {
+        printf("Could not open %s for the replay\n", game->recorders->replay_path);
+        return;
+    }
+
+    bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&g_replay.state_initial, sizeof(Save_State_t), 1, file) == 1 && fwrite(g_replay.ticks, sizeof(Replay_Tick_t), g_replay.tick_count, file) == (size_t)g_replay.tick_count;
+    fclose(file);
+
+    printf("%s replay of %d ticks to %s\n", is_written ? "Wrote" : "Could not write", g_replay.tick_count, game->recorders->replay_path);
+}
+
+// Loads a replay into g_replay, returns false if it is missing or was written by a different version
+bool replay_read_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    Replay_Header_t header = {0};
+    bool is_read = fread(&header, sizeof(header), 1, file) == 1;
+
+    if (is_read && (memcmp(header.magic, g_replay.MAGIC, sizeof(header.magic)) != 0 || header.version != g_replay.VERSION || header.state_size != sizeof(Save_State_t) || header.tick_size != sizeof(Replay_Tick_t)))
+    {
+        printf("%s is not a version %u replay\n", path, g_replay.VERSION);
+        is_read = false;
+    }
+
+    if (is_read && header.is_fixed_point != SIM_FIXED_POINT)
+    {
+        printf("%s was recorded by a %s build\n", path, header.is_fixed_point ? "fixed point" : "float");
+        is_read = false;
+    }
+
+    if (is_read && header.is_impact_events != SIM_IMPACT_EVENTS)
+    {
+        printf("%s was recorded by a build %s scheduled impacts\n", path, header.is_impact_events ? "with" : "without");
+        is_read = false;
+    }
+
+    if (is_read)
+    {
+        free(g_replay.ticks);
+        g_replay.ticks = malloc(header.tick_count * sizeof(Replay_Tick_t) + 1);
+        g_replay.tick_capacity = header.tick_count;
+        g_replay.tick_count = header.tick_count;
+
+        is_read = g_replay.ticks != NULL && fread(&g_replay.state_initial, sizeof(Save_State_t), 1, file) == 1 && fread(g_replay.ticks, sizeof(Replay_Tick_t), header.tick_count, file) == header.tick_count;
+    }
+
+    fclose(file);
+    return is_read;
+}
+
+void sim_input_poll(Game_t *game, Sim_Input_t *input)
+{
+    input->mouse_position = GetMousePosition();
+
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        input->weapons_fired[i] = IsKeyPressed(game->weapons_data.weapons[i].firing_key);
+    }
+
+    input->time_scale = 1;
+    if (IsKeyDown(KEY_K))
+    {
+        input->time_scale = 5;
+    }
+    else if (IsKeyDown(KEY_J))
+    {
+        input->time_scale = 10;
+    }
+
+    input->cheat_money = IsKeyPressed(KEY_L);
+    input->cheat_kill_all = IsKeyPressed(KEY_O);
+    input->cheat_end_level = IsKeyPressed(KEY_P);
+    input->cheat_player_health = IsKeyPressed(KEY_N);
+    input->cheat_planet_health = IsKeyPressed(KEY_M);
+    input->cheat_next_level = IsKeyPressed(KEY_G);
+    input->cheat_all_levels = IsKeyPressed(KEY_T);
+    input->cheat_reset_levels = IsKeyPressed(KEY_R);
+
+    input->debug_save_state = IsKeyPressed(KEY_F5);
+    input->debug_load_state = IsKeyPressed(KEY_F9);
+    input->debug_rewind_toggle = IsKeyPressed(KEY_F6);
+    input->debug_rewind_steps = (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) - (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT));
+}
+
+// Adds the key presses of NEW_INPUT to the presses in input that have not been consumed yet
+void sim_input_merge(Sim_Input_t *input, const Sim_Input_t *NEW_INPUT)
+{
+    input->mouse_position = NEW_INPUT->mouse_position;
+    input->time_scale = NEW_INPUT->time_scale;
+
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        input->weapons_fired[i] |= NEW_INPUT->weapons_fired[i];
+    }
+
+    input->cheat_money |= NEW_INPUT->cheat_money;
+    input->cheat_kill_all |= NEW_INPUT->cheat_kill_all;
+    input->cheat_end_level |= NEW_INPUT->cheat_end_level;
+    input->cheat_player_health |= NEW_INPUT->cheat_player_health;
+    input->cheat_planet_health |= NEW_INPUT->cheat_planet_health;
+    input->cheat_next_level |= NEW_INPUT->cheat_next_level;
+    input->cheat_all_levels |= NEW_INPUT->cheat_all_levels;
+    input->cheat_reset_levels |= NEW_INPUT->cheat_reset_levels;
+
+    input->debug_save_state |= NEW_INPUT->debug_save_state;
+    input->debug_load_state |= NEW_INPUT->debug_load_state;
+    input->debug_rewind_toggle ^= NEW_INPUT->debug_rewind_toggle;
+    input->debug_rewind_steps += NEW_INPUT->debug_rewind_steps;
+}
+
+void sim_input_apply_cheats(Game_t *game)
+{
+    if (game->sim_input.cheat_money)
+    {
+        money_add(game, 1000);
+    }
+
+    if (game->sim_input.cheat_next_level)
+    {
+        game->enemy_spawn_director.next_level++;
+
+        if (game->enemy_spawn_director.next_level > game->enemy_spawn_director.max_level)
+        {
+            game->enemy_spawn_director.next_level = game->enemy_spawn_director.max_level;
+        }
+    }
+
+    if (game->sim_input.cheat_all_levels)
+    {
+        game->enemy_spawn_director.next_level = game->enemy_spawn_director.max_level;
+    }
+
+    if (game->sim_input.cheat_reset_levels)
+    {
+        game->enemy_spawn_director.next_level = 0;
+    }
+
+    if (game->sim_input.debug_save_state)
+    {
+        save_state_write_file(game, g_save_files.QUICKSAVE_PATH);
+    }
+
+    // A quicksave holds a level in progress, restoring it anywhere else would leave the game in an odd state
+    if (game->sim_input.debug_load_state && game->gamestate_current == STATE_LEVEL)
+    {
+        save_state_read_file(game, g_save_files.QUICKSAVE_PATH);
+        replay_stop_recording(game, "a save state was loaded");
+    }
+}
+
+void sim_hud_capture(Game_t *game, Sim_Hud_t *hud)
+{
+    hud->player_current_health = game->player_data.player_current_health;
+    hud->player_max_health = game->player_data.player_max_health;
+    hud->planet_current_health = game->player_data.planet_current_health;
+    hud->planet_max_health = game->player_data.planet_max_health;
+    hud->money_displayed = game->player_data.money + game->player_data.transaction_money_remaining;
+    hud->player_rotation = game->player_data.rotation;
+    hud->player_color = game->player_data.color;
+
+    hud->is_rewinding = g_rewind.is_scrubbing;
+    hud->rewind_ticks_behind = g_rewind.entry_count - 1 - g_rewind.scrub_index;
+    hud->rewind_ticks_recorded = g_rewind.entry_count;
+
+    hud->turbo_speedup = g_turbo.speedup;
+
+    hud->is_menu = game->gamestate_current != STATE_LEVEL && game->transition_time >= game->transition_duration;
+}
+
+// A level is running once its intro transition is over and until it is won or lost
+bool sim_level_is_running(Game_t *game)
+{
+    return game->gamestate_current == STATE_LEVEL && game->transition_time >= game->transition_duration;
+}
+
+void sim_snapshot_capture(Game_t *game, Sim_Snapshot_t *snapshot)
+{
+    snapshot->tick = g_sim_thread.tick;
+    snapshot->is_final = !sim_level_is_running(game);
+
+    memcpy(snapshot->enemies, game->enemies_data.enemies, sizeof(snapshot->enemies));
+    memcpy(snapshot->player_projectiles, game->projectiles_data.player_projectiles, sizeof(snapshot->player_projectiles));
+    memcpy(snapshot->enemy_projectiles, game->projectiles_data.enemy_projectiles, sizeof(snapshot->enemy_projectiles));
+    snapshot->enemies_occupancy = game->enemies_data.occupancy;
+    snapshot->player_projectiles_occupancy = game->projectiles_data.player_occupancy;
+    snapshot->enemy_projectiles_occupancy = game->projectiles_data.enemy_occupancy;
+    particles_copy_live(&snapshot->particles, &game->particles_data.pool);
+    memcpy(snapshot->stars, game->stars_data.stars, sizeof(snapshot->stars));
+    memcpy(snapshot->weapons, game->weapons_data.weapons, sizeof(snapshot->weapons));
+    memcpy(snapshot->symbol_alert_timers, game->weapons_data.symbol_alert_timers, sizeof(snapshot->symbol_alert_timers));
+
+    snapshot->enemies_time_elapsed = game->enemies_data.time_elapsed;
+    snapshot->twinkle_x = game->stars_data.twinkle_x;
+    sim_hud_capture(game, &snapshot->hud);
+}
+
+// Draw from the live game state, only valid while the main thread owns it
+void render_view_use_live(Game_t *game)
+{
+    g_render_view.enemies = game->enemies_data.enemies;
+    g_render_view.player_projectiles = game->projectiles_data.player_projectiles;
+    g_render_view.enemy_projectiles = game->projectiles_data.enemy_projectiles;
+    g_render_view.enemies_occupancy = &game->enemies_data.occupancy;
+    g_render_view.player_projectiles_occupancy = &game->projectiles_data.player_occupancy;
+    g_render_view.enemy_projectiles_occupancy = &game->projectiles_data.enemy_occupancy;
+    g_render_view.particles = &game->particles_data.pool;
+    g_render_view.stars = game->stars_data.stars;
+    g_render_view.weapons = game->weapons_data.weapons;
+    g_render_view.symbol_alert_timers = game->weapons_data.symbol_alert_timers;
+    g_render_view.enemies_time_elapsed = game->enemies_data.time_elapsed;
+    g_render_view.twinkle_x = game->stars_data.twinkle_x;
+    sim_hud_capture(game, &g_render_view.hud);
+}
+
+void render_view_use_snapshot(const Sim_Snapshot_t *SNAPSHOT)
+{
+    g_render_view.enemies = SNAPSHOT->enemies;
+    g_render_view.player_projectiles = SNAPSHOT->player_projectiles;
+    g_render_view.enemy_projectiles = SNAPSHOT->enemy_projectiles;
+    g_render_view.enemies_occupancy = &SNAPSHOT->enemies_occupancy;
+    g_render_view.player_projectiles_occupancy = &SNAPSHOT->player_projectiles_occupancy;
+    g_render_view.enemy_projectiles_occupancy = &SNAPSHOT->enemy_projectiles_occupancy;
+    g_render_view.particles = &SNAPSHOT->particles;
+    g_render_view.stars = SNAPSHOT->stars;
+    g_render_view.weapons = SNAPSHOT->weapons;
+    g_render_view.symbol_alert_timers = SNAPSHOT->symbol_alert_timers;
+    g_render_view.enemies_time_elapsed = SNAPSHOT->enemies_time_elapsed;
+    g_render_view.twinkle_x = SNAPSHOT->twinkle_x;
+    g_render_view.hud = SNAPSHOT->hud;
+}
+
+void telemetry_sample_occupancy(Game_t *game)
+{
+    int enemies = game->enemies_data.occupancy.live_count;
+    int player_projectiles = game->projectiles_data.player_occupancy.live_count;
+    int enemy_projectiles = game->projectiles_data.enemy_occupancy.live_count;
+    int particles = game->particles_data.pool.alive_count;
+
+    Telemetry_Counters_t *counters = &game->telemetry_counters;
+    counters->ticks++;
+    counters->peak_enemies = enemies > counters->peak_enemies ? enemies : counters->peak_enemies;
+    counters->peak_player_projectiles = player_projectiles > counters->peak_player_projectiles ? player_projectiles : counters->peak_player_projectiles;
+    counters->peak_enemy_projectiles = enemy_projectiles > counters->peak_enemy_projectiles ? enemy_projectiles : counters->peak_enemy_projectiles;
+    counters->peak_particles = particles > counters->peak_particles ? particles : counters->peak_particles;
+}
+
+// Appends the counters of the level attempt that just ended, the header is written when the file is new
+void telemetry_write_row(Game_t *game)
+{
+    if (game->recorders == NULL || game->recorders->telemetry_path == NULL)
+    {
+        return;
+    }
+
+    FILE *file = fopen(game->recorders->telemetry_path, "a");
+    if (file == NULL)
+    {
+        printf("Could not open %s for the telemetry\n", game->recorders->telemetry_path);
+        return;
+    }
+
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "level,result,ticks,collision_tests,hits,overkill_damage,particles_evicted,enemy_spawns_rejected,player_projectiles_dropped,enemy_projectiles_dropped,projectiles_culled,peak_enemies,peak_player_projectiles,peak_enemy_projectiles,peak_particles\n");
+    }
+
+    const Telemetry_Counters_t *COUNTERS = &game->telemetry_counters;
+    fprintf(file, "%d,%s,%llu,%llu,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n",
+            game->enemy_spawn_director.current_level,
+            game->gamestate_current == STATE_GAMEOVER ? "lost" : "won",
+            COUNTERS->ticks,
+            COUNTERS->collision_tests,
+            COUNTERS->hits,
+            COUNTERS->overkill_damage,
+            COUNTERS->particles_evicted,
+            COUNTERS->enemy_spawns_rejected,
+            COUNTERS->player_projectiles_dropped,
+            COUNTERS->enemy_projectiles_dropped,
+            COUNTERS->projectiles_culled,
+            COUNTERS->peak_enemies,
+            COUNTERS->peak_player_projectiles,
+            COUNTERS->peak_enemy_projectiles,
+            COUNTERS->peak_particles);
+
+    fclose(file);
+}
+
+// What a policy sees of the game on a tick
+typedef struct
+{
+    const Enemy_t *enemies;
+    const Pool_Occupancy_t *enemies_occupancy;
+    const Projectile_Enemy_t *enemy_projectiles;
+    const Pool_Occupancy_t *enemy_projectiles_occupancy;
+    const Weapon_t *weapons; // Ammo counts and reload timers
+    Vector2 player_center;
+    float time_elapsed;
+} Player_Policy_View_t;
+
+// What a policy decides on a tick, it replaces the aim and firing keys of the input
+typedef struct
+{
+    Vector2 aim_position;
+    bool weapons_fired[WEAPON_TYPE_COUNT];
+} Player_Policy_Action_t;
+
+// Scripted players for headless runs, benchmarks and balancing, each game plays with the one in its player_policy
+struct
+{
+    const char *NAMES[PLAYER_POLICY_COUNT];
+} g_player_policy = {
+    .NAMES = {"none", "nearest-threat", "lowest-health", "greedy-area"}};
+
+// Returns -1 for an unknown name
+int player_policy_find(const char *name)
+{
+    for (int i = 0; i < PLAYER_POLICY_COUNT; i++)
+    {
+        if (strcmp(name, g_player_policy.NAMES[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void player_policy_view_live(Game_t *game, Player_Policy_View_t *view)
+{
+    view->enemies = game->enemies_data.enemies;
+    view->enemies_occupancy = &game->enemies_data.occupancy;
+    view->enemy_projectiles = game->projectiles_data.enemy_projectiles;
+    view->enemy_projectiles_occupancy = &game->projectiles_data.enemy_occupancy;
+    view->weapons = game->weapons_data.weapons;
+    view->player_center = game->player_data.center;
+    view->time_elapsed = game->enemies_data.time_elapsed;
+}
+
+// Only enemies on screen can be hit before they move on
+bool player_policy_is_targetable(const Player_Policy_View_t *VIEW, int enemy_i)
+{
+    return enemy_get_center(VIEW->enemies[enemy_i], VIEW->time_elapsed).y > 0;
+}
+
+// Aims at an enemy and fires every loaded weapon
+void player_policy_attack(Game_t *game, const Player_Policy_View_t *VIEW, int enemy_i, Player_Policy_Action_t *action)
+{
+    const Enemy_t *ENEMY = &VIEW->enemies[enemy_i];
+    Vector2 center = enemy_get_center(*ENEMY, VIEW->time_elapsed);
+
+    // Leads by the flight time of a cannon shell, the other weapons are close enough
+    float flight_time = Vector2Distance(VIEW->player_center, center) / game->weapons_data.base_stats[WEAPON_TYPE_CANNON].start_velocity;
+    center.y += g_enemy_database[ENEMY->type].speed * flight_time;
+
+    action->aim_position = center;
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        action->weapons_fired[i] = VIEW->weapons[i].is_unlocked && VIEW->weapons[i].ammo_count > 0;
+    }
+}
+
+// The enemy closest to the station
+int player_policy_nearest_threat(const Player_Policy_View_t *VIEW)
+{
+    int target_i = -1;
+    float target_distance = INFINITY;
+
+    for (int i = pool_next(VIEW->enemies_occupancy, 0); i >= 0; i = pool_next(VIEW->enemies_occupancy, i + 1))
+    {
+        float distance = Vector2Distance(VIEW->player_center, enemy_get_center(VIEW->enemies[i], VIEW->time_elapsed));
+        if (player_policy_is_targetable(VIEW, i) && distance < target_distance)
+        {
+            target_i = i;
+            target_distance = distance;
+        }
+    }
+
+    return target_i;
+}
+
+// The enemy closest to dying, ties go to the one closest to the planet
+int player_policy_lowest_health(const Player_Policy_View_t *VIEW)
+{
+    int target_i = -1;
+
+    for (int i = pool_next(VIEW->enemies_occupancy, 0); i >= 0; i = pool_next(VIEW->enemies_occupancy, i + 1))
+    {
+        if (!player_policy_is_targetable(VIEW, i))
+        {
+            continue;
+        }
+
+        if (target_i < 0 || VIEW->enemies[i].current_health < VIEW->enemies[target_i].current_health ||
+            (VIEW->enemies[i].current_health == VIEW->enemies[target_i].current_health && enemy_get_center(VIEW->enemies[i], VIEW->time_elapsed).y > enemy_get_center(VIEW->enemies[target_i], VIEW->time_elapsed).y))
+        {
+            target_i = i;
+        }
+    }
+
+    return target_i;
+}
+
+// The enemy with the most other enemies inside a torpedo explosion around it
+int player_policy_greedy_area(const Player_Policy_View_t *VIEW)
+{
+    const float RADIUS = g_player_projectile_database[PROJECTILE_TYPE_PLAYER_TORPEDO].explosion.size;
+
+    int target_i = -1;
+    int target_count = -1;
+
+    for (int i = pool_next(VIEW->enemies_occupancy, 0); i >= 0; i = pool_next(VIEW->enemies_occupancy, i + 1))
+    {
+        if (!player_policy_is_targetable(VIEW, i))
+        {
+            continue;
+        }
+
+        Vector2 center = enemy_get_center(VIEW->enemies[i], VIEW->time_elapsed);
+
+        int count = 0;
+        for (int j = pool_next(VIEW->enemies_occupancy, 0); j >= 0; j = pool_next(VIEW->enemies_occupancy, j + 1))
+        {
+            count += Vector2Distance(center, enemy_get_center(VIEW->enemies[j], VIEW->time_elapsed)) < RADIUS;
+        }
+
+        if (count > target_count)
+        {
+            target_i = i;
+            target_count = count;
+        }
+    }
+
+    return target_i;
+}
+
+void player_policy_decide(Game_t *game, Player_Policy_e policy, const Player_Policy_View_t *VIEW, Player_Policy_Action_t *action)
+{
+    *action = (Player_Policy_Action_t){.aim_position = {.x = VIEW->player_center.x, .y = 0}};
+
+    int target_i = -1;
+    switch (policy)
+    {
+    case PLAYER_POLICY_NEAREST_THREAT:
+        target_i = player_policy_nearest_threat(VIEW);
+        break;
+
+    case PLAYER_POLICY_LOWEST_HEALTH:
+        target_i = player_policy_lowest_health(VIEW);
+        break;
+
+    case PLAYER_POLICY_GREEDY_AREA:
+        target_i = player_policy_greedy_area(VIEW);
+        break;
+
+    default:
+        break;
+    }
+
+    if (target_i >= 0)
+    {
+        player_policy_attack(game, VIEW, target_i, action);
+    }
+}
+
+// Replaces the aim and firing keys of the sim input with the decision of the game's policy
+void player_policy_apply(Game_t *game)
+{
+    if (game->player_policy == PLAYER_POLICY_NONE)
+    {
+        return;
+    }
+
+    Player_Policy_View_t view;
+    player_policy_view_live(game, &view);
+
+    Player_Policy_Action_t action;
+    player_policy_decide(game, game->player_policy, &view, &action);
+
+    game->sim_input.mouse_position = action.aim_position;
+    memcpy(game->sim_input.weapons_fired, action.weapons_fired, sizeof(game->sim_input.weapons_fired));
+}
+
+// Advances a running level by the frame time of the game using its sim input
+void level_update(Game_t *game)
+{
+    if (rewind_update(game))
+    {
+        replay_stop_recording(game, "the level was rewound");
+        return;
+    }
+
+    money_update(game);
+    if (!game->is_unseen)
+    {
+        background_update(game);
+    }
+    player_update(game);
+
+    weapons_update(game);
+    enemies_update(game);
+    projectiles_update(game);
+    if (!game->is_unseen)
     {
-        g_explosions_data.explosions[i].time_lifetime = -1;
-        g_explosions_data.explosions[i].time_alive = 1;
+        particles_update(game);
     }
+    enemies_update_spawn_conditions(game);
+
+    telemetry_sample_occupancy(game);
+    rewind_record(game);
 }
 
-void enemy_take_damage(int enemy_i, int damage)
+// One tick of a running level including the cheat keys, everything a replay needs to reproduce it
+void level_tick(Game_t *game)
 {
-    Enemy_t *enemy = &g_enemies_data.enemies[enemy_i];
+    replay_record_tick_begin(game);
 
-    enemy->current_health -= damage;
-    enemy->time_healthbar_visible = 0;
-}
+    player_policy_apply(game);
+    sim_input_apply_cheats(game);
+    level_update(game);
 
-float enemies_find_tallest_height()
-{
-    float height = 0;
-    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
-    {
-        if (height > g_enemies_data.enemy_database[i].height)
-        {
-            continue;
-        }
+    replay_record_tick_end(game);
 
-        height = g_enemies_data.enemy_database[i].height;
+    if (!sim_level_is_running(game))
+    {
+        replay_write_file(game);
+        telemetry_write_row(game);
     }
-    return height;
 }
 
-void enemies_init()
+double sim_clock_seconds()
 {
-    for (int i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
-    {
-        g_enemies_data.enemies[i].type = ENEMY_TYPE_NONE;
-        g_enemies_data.enemies[i].current_health = 0;
-        g_enemies_data.enemies[i].time_healthbar_visible = 0;
-    }
+    struct timespec time_now;
+    clock_gettime(CLOCK_MONOTONIC, &time_now);
 
-    g_enemies_data.tallest_enemy_height = enemies_find_tallest_height();
+    return time_now.tv_sec + time_now.tv_nsec / 1e9;
 }
 
-void enemy_spawn_director_init_level(int level)
+typedef enum
+{
+    DRAW_TIMING_PROJECTILES,
+    DRAW_TIMING_ENEMIES,
+    DRAW_TIMING_PARTICLES,
+    DRAW_TIMING_WEAPON_SYMBOLS,
+    DRAW_TIMING_COUNT
+} Draw_Timing_e;
+
+// CPU time spent building draw batches, only measured by the golden frame renderer
+struct
+{
+    const char *NAMES[DRAW_TIMING_COUNT];
+    bool is_enabled;
+    double seconds[DRAW_TIMING_COUNT];
+} g_draw_timings = {
+    .NAMES = {"projectiles_draw", "enemies_draw", "particles_draw", "weapons_draw_symbols"},
+};
+
+double draw_timing_begin()
 {
-    if (level > g_enemy_spawn_director.max_level)
+    return g_draw_timings.is_enabled ? sim_clock_seconds() : 0;
+}
+
+void draw_timing_end(Draw_Timing_e timing, double time_start)
+{
+    if (g_draw_timings.is_enabled)
     {
-        level = g_enemy_spawn_director.max_level;
+        g_draw_timings.seconds[timing] += sim_clock_seconds() - time_start;
     }
-    g_enemy_spawn_director.current_level = level;
+}
 
-    g_gamestate_current = STATE_LEVEL;
+void level_draw(Game_t *game)
+{
+    render_target_world_begin();
 
-    for (int i = 0; i < ENEMY_TYPE_COUNT - 1; i++)
-    {
-        g_enemy_spawn_director.enemy_spawn_chances[i] = g_levels_data.levels[g_enemy_spawn_director.current_level].enemy_spawn_chances[i];
-    }
+    background_draw(game);
+    player_draw(game);
 
-    g_enemy_spawn_director.spawn_y = g_enemy_spawn_director.spawn_y_min;
-    g_enemy_spawn_director.time_next_wave = 0;
-    g_enemy_spawn_director.spawn_credits = g_levels_data.levels[level].time_next_wave_min * g_levels_data.levels[level].spawn_credits_build_rate;
-    g_enemy_spawn_director.total_spawn_credits = 0;
+    // DrawText(TextFormat("%d", GetFPS()), 50, 50, 40, WHITE);
+    double time_start = draw_timing_begin();
+    projectiles_draw();
+    draw_timing_end(DRAW_TIMING_PROJECTILES, time_start);
 
-    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
-    {
-        g_enemy_spawn_director.enemy_spawn_chances[i] = g_levels_data.levels[g_enemy_spawn_director.current_level].enemy_spawn_chances[i];
-    }
+    time_start = draw_timing_begin();
+    enemies_draw(game);
+    draw_timing_end(DRAW_TIMING_ENEMIES, time_start);
+
+    time_start = draw_timing_begin();
+    particles_draw();
+    draw_timing_end(DRAW_TIMING_PARTICLES, time_start);
+
+    render_target_world_end();
 
-    for (int i = 0; i < g_projectiles_data.player_projectile_count; i++)
+    time_start = draw_timing_begin();
+    weapons_draw_symbols(game);
+    draw_timing_end(DRAW_TIMING_WEAPON_SYMBOLS, time_start);
+
+    draw_player_health();
+    money_draw_ingame();
+    rewind_draw();
+    turbo_draw();
+}
+
+// Must only be called by the thread currently writing snapshots
+void sim_snapshot_publish(Game_t *game)
+{
+    sim_snapshot_capture(game, &g_sim_thread.snapshots[g_sim_thread.snapshot_back]);
+
+    g_sim_thread.snapshot_back = atomic_exchange(&g_sim_thread.snapshot_shared, g_sim_thread.snapshot_back | SIM_SNAPSHOT_FRESH) & SIM_SNAPSHOT_INDEX_MASK;
+}
+
+// Returns the most recently published snapshot, it stays valid until the next call
+const Sim_Snapshot_t *sim_snapshot_acquire()
+{
+    if (atomic_load(&g_sim_thread.snapshot_shared) & SIM_SNAPSHOT_FRESH)
     {
-        g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
+        g_sim_thread.snapshot_front = atomic_exchange(&g_sim_thread.snapshot_shared, g_sim_thread.snapshot_front) & SIM_SNAPSHOT_INDEX_MASK;
     }
 
-    player_init();
-    projectiles_init();
-    enemies_init();
-    weapons_init();
+    return &g_sim_thread.snapshots[g_sim_thread.snapshot_front];
 }
 
-Vector2 enemy_get_center(Enemy_t enemy)
+void sim_sleep_seconds(double seconds)
 {
-    float width = g_enemies_data.enemy_database[enemy.type].width;
-    float height = g_enemies_data.enemy_database[enemy.type].height;
+    struct timespec duration = {.tv_sec = (time_t)seconds, .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&duration, NULL);
+}
 
-    Vector2 center = Vector2Subtract(Vector2Add((Vector2){.x = width, .y = height}, enemy.position), enemy.position); // Points towards the center of the enemy
-    center = Vector2Normalize(center);
+void sim_tick(Game_t *game)
+{
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    game->sim_input = g_sim_thread.pending_input;
 
-    float distance = hypotf(width, height) / 2; // The distance between the position of the enemy and its center
+    // Key presses are consumed by exactly one tick, the aim and time scale carry over
+    g_sim_thread.pending_input = (Sim_Input_t){
+        .mouse_position = game->sim_input.mouse_position,
+        .time_scale = game->sim_input.time_scale};
+    pthread_mutex_unlock(&g_sim_thread.mutex);
 
-    center = Vector2Scale(center, distance);     // Scale the vector so that the vector end point is in the center of the enemy
-    center = Vector2Add(center, enemy.position); // Add the vector to get absolute position of enemy center
+    game->frame_time = game->sim_input.time_scale / g_sim_thread.TICK_RATE;
 
-    return center;
+    level_tick(game);
+
+    g_sim_thread.tick++;
 }
 
-void enemies_update()
+// A tick on the main thread when the simulation thread is not used, key presses only count for the first tick of a frame
+void sim_tick_live(Game_t *game)
 {
-    for (unsigned char i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
-    {
-        Enemy_t *current_enemy = &g_enemies_data.enemies[i];
+    game->frame_time = game->sim_input.time_scale / g_sim_thread.TICK_RATE;
 
-        // DrawCircleV(enemy_get_center(g_enemies_data.enemies[i]), 8, PURPLE);
+    level_tick(game);
 
-        if (current_enemy->type == ENEMY_TYPE_NONE)
+    game->sim_input = (Sim_Input_t){
+        .mouse_position = game->sim_input.mouse_position,
+        .time_scale = game->sim_input.time_scale};
+}
+
+// Runs ticks back to back for one slice of wall-clock time or until the level ends, and measures the speed-up
+void turbo_run_slice(Game_t *game, bool is_on_sim_thread)
+{
+    double time_start = sim_clock_seconds();
+    double time_simulated = 0;
+
+    do
+    {
+        if (is_on_sim_thread)
         {
-            continue;
+            sim_tick(game);
         }
-
-        if (current_enemy->current_health <= 0)
+        else
         {
-            explosion_spawn(enemy_get_center(*current_enemy), 0.30f, 60, ORANGE);
+            sim_tick_live(game);
+        }
 
-            money_add((int)floor(g_enemy_spawn_director.enemy_spawn_costs[current_enemy->type]));
-            current_enemy->type = ENEMY_TYPE_NONE;
-            current_enemy->current_health = 1;
+        // A tick held on a rewound frame simulates nothing
+        if (!g_rewind.is_scrubbing)
+        {
+            time_simulated += game->frame_time;
         }
+    } while (sim_level_is_running(game) && sim_clock_seconds() - time_start < g_turbo.SLICE_SECONDS);
+
+    float speedup = time_simulated / fmax(sim_clock_seconds() - time_start, 1e-9);
+
+    // Smoothed so the number on screen is readable, a slice spent rewinding hides it
+    g_turbo.speedup = g_turbo.speedup > 0 && speedup > 0 ? g_turbo.speedup * 0.9f + speedup * 0.1f : speedup;
+}
+
+void *sim_thread_main(void *argument)
+{
+    Game_t *game = argument;
 
-        current_enemy->time_healthbar_visible += g_frame_time;
-        current_enemy->position.y += g_enemies_data.enemy_database[current_enemy->type].speed * g_frame_time;
+    const double TICK_DURATION = 1.0 / g_sim_thread.TICK_RATE;
 
-        if (current_enemy->position.y > 0 && g_enemies_data.enemy_database[current_enemy->type].can_shoot)
+    double time_accumulated = 0;
+    double time_previous = 0;
+
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    while (true)
+    {
+        if (!g_sim_thread.run_requested)
         {
-            current_enemy->time_last_fired += g_frame_time;
+            g_sim_thread.is_running = false;
+            pthread_cond_broadcast(&g_sim_thread.condition);
 
-            Vector2 enemy_to_player = Vector2Subtract(g_player_data.center, enemy_get_center(*current_enemy));
-            if (Vector2Length(enemy_to_player) < g_enemies_data.enemy_database[current_enemy->type].shoot_range && current_enemy->time_last_fired > g_enemies_data.enemy_database[current_enemy->type].time_firing_interval && (current_enemy->position.y < g_player_data.center.y || current_enemy->has_attempted_first_shot))
+            while (!g_sim_thread.run_requested && !g_sim_thread.should_quit)
             {
-                if(!current_enemy->has_attempted_first_shot)
-                {
-                    current_enemy->has_attempted_first_shot = true;
-                    current_enemy->time_last_fired = g_enemies_data.enemy_database[current_enemy->type].time_firing_interval - 3 * rand_float();
-                    continue;
-                }
+                pthread_cond_wait(&g_sim_thread.condition, &g_sim_thread.mutex);
+            }
 
-                for (int j = 0; j < g_projectiles_data.enemy_projectile_count; j++)
-                {
-                    if (g_projectiles_data.enemy_projectiles[j].type != PROJECTILE_TYPE_ENEMY_NONE)
-                    {
-                        continue;
-                    }
+            if (g_sim_thread.should_quit)
+            {
+                break;
+            }
 
-                    Projectile_Type_Enemy_e new_type = g_enemies_data.enemy_database[current_enemy->type].projectile_type;
-                    Vector2 new_position = enemy_get_center(*current_enemy);
-                    Projectile_Enemy_t new_projectile = {
-                        .position = new_position,
-                        .should_remove = false,
-                        .health = g_projectiles_data.enemy_projectile_database[new_type].max_health,
-                        .type = new_type,
-                        .velocity = Vector2Scale(Vector2Normalize(Vector2Subtract(g_player_data.center, new_position)), g_projectiles_data.enemy_projectile_database[g_enemies_data.enemy_database[g_enemies_data.enemies[i].type].projectile_type].speed)};
+            g_sim_thread.is_running = true;
+            time_accumulated = 0;
+            time_previous = sim_clock_seconds();
+        }
+        pthread_mutex_unlock(&g_sim_thread.mutex);
 
-                    g_projectiles_data.enemy_projectiles[j] = new_projectile;
-                    current_enemy->time_last_fired -= g_enemies_data.enemy_database[current_enemy->type].time_firing_interval;
+        bool is_level_running = true;
 
-                    break;
-                }
+        if (atomic_load(&g_turbo.is_requested))
+        {
+            // Publishing every tick would cost more than the ticks, the main thread only sees the last one of each slice
+            turbo_run_slice(game, true);
+            is_level_running = sim_level_is_running(game);
+            sim_snapshot_publish(game);
+
+            time_accumulated = 0;
+            time_previous = sim_clock_seconds();
+        }
+        else
+        {
+            g_turbo.speedup = 0;
+
+            double time_current = sim_clock_seconds();
+            time_accumulated += time_current - time_previous;
+            time_previous = time_current;
+
+            // Drop time instead of trying to catch up after a long stall
+            if (time_accumulated > TICK_DURATION * g_sim_thread.MAX_TICKS_PER_UPDATE)
+            {
+                time_accumulated = TICK_DURATION * g_sim_thread.MAX_TICKS_PER_UPDATE;
+            }
+
+            while (time_accumulated >= TICK_DURATION && is_level_running)
+            {
+                sim_tick(game);
+                time_accumulated -= TICK_DURATION;
+
+                is_level_running = sim_level_is_running(game);
+                sim_snapshot_publish(game);
+            }
+
+            if (is_level_running)
+            {
+                sim_sleep_seconds(TICK_DURATION - time_accumulated);
             }
         }
 
-        if (current_enemy->position.y > g_weapons_data.symbol_draw_area_y)
+        pthread_mutex_lock(&g_sim_thread.mutex);
+        if (!is_level_running)
         {
-            g_player_data.planet_current_health -= g_enemies_data.enemy_database[current_enemy->type].damage;
-            current_enemy->type = ENEMY_TYPE_NONE;
+            // The level was won or lost, hand the game state back to the main thread for the transition
+            g_sim_thread.run_requested = false;
         }
     }
+    pthread_mutex_unlock(&g_sim_thread.mutex);
+
+    return NULL;
+}
+
+// The simulation thread runs the levels of this game until it is stopped
+void sim_thread_start(Game_t *game)
+{
+    pthread_create(&g_sim_thread.thread, NULL, sim_thread_main, game);
+    g_sim_thread.is_started = true;
 }
 
-void enemies_kill_all()
+void sim_thread_stop()
 {
-    for (int i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
+    if (!g_sim_thread.is_started)
     {
-        g_enemies_data.enemies[i].type = ENEMY_TYPE_NONE;
+        return;
     }
+
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    g_sim_thread.should_quit = true;
+    pthread_cond_broadcast(&g_sim_thread.condition);
+    pthread_mutex_unlock(&g_sim_thread.mutex);
+
+    pthread_join(g_sim_thread.thread, NULL);
+    g_sim_thread.is_started = false;
+    g_sim_thread.owns_simulation = false;
 }
 
-void enemies_end_level()
+// Hands the game state over to the simulation thread
+void sim_thread_resume(Game_t *game)
 {
-    enemies_kill_all();
-    g_enemy_spawn_director.spawn_credits = -1;
-    g_enemy_spawn_director.total_spawn_credits = 999999;
+    if (g_sim_thread.owns_simulation)
+    {
+        return;
+    }
+
+    // While the simulation thread is parked the main thread is the snapshot writer
+    sim_snapshot_publish(game);
+
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    g_sim_thread.pending_input = game->sim_input;
+    g_sim_thread.run_requested = true;
+    pthread_cond_broadcast(&g_sim_thread.condition);
+    pthread_mutex_unlock(&g_sim_thread.mutex);
+
+    g_sim_thread.owns_simulation = true;
 }
 
-bool enemies_all_dead()
+// Blocks until the simulation thread has parked, the game state belongs to the main thread afterwards
+void sim_thread_pause()
 {
-    for (int i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
+    if (!g_sim_thread.owns_simulation)
     {
-        if (g_enemies_data.enemies[i].type != ENEMY_TYPE_NONE)
-        {
-            return false;
-        }
+        return;
     }
 
-    return true;
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    g_sim_thread.run_requested = false;
+    while (g_sim_thread.is_running)
+    {
+        pthread_cond_wait(&g_sim_thread.condition, &g_sim_thread.mutex);
+    }
+    pthread_mutex_unlock(&g_sim_thread.mutex);
+
+    g_sim_thread.owns_simulation = false;
 }
 
-void enemies_spawn_wave()
+void sim_thread_push_input(const Sim_Input_t *INPUT)
 {
-    // TODO
-    // Don't store enemy_type_none in affordable_enemies
+    pthread_mutex_lock(&g_sim_thread.mutex);
+    sim_input_merge(&g_sim_thread.pending_input, INPUT);
+    pthread_mutex_unlock(&g_sim_thread.mutex);
+}
 
-    // clang-format off
-    enum { SPAWN_ATTEMPTS = 3 };
-    enum { ENEMIES_PER_INTERVAL = 5 };
-    const float SPAWN_INTERVAL_Y = g_enemies_data.ENEMY_SPEED * g_enemy_spawn_director.time_next_wave;
-    enum { ENEMY_SPAWN_PADDING = 10 };
-    // clang-format on
+// Fills every entity pool of the last level and times saving and restoring it
+int save_state_benchmark(Game_t *game)
+{
+    enum
+    {
+        ITERATIONS = 10000
+    };
 
-    struct
+    enemy_spawn_director_init_level(game, game->enemy_spawn_director.max_level);
+
+    for (int i = 0; i < game->enemies_data.ENEMIES_COUNT; i++)
     {
-        float spawn_chance;
-        Enemy_Type_e enemy_type;
-    } affordable_enemies[ENEMY_TYPE_COUNT] = {0}; // A list of all enemies that can be afforded
+        game->enemies_data.enemies[i] = (Enemy_t){.type = ENEMY_TYPE_LIGHT + i % (ENEMY_TYPE_COUNT - 1), .current_health = 10, .spawn_position = {.x = i * 4, .y = i}};
+    }
 
-    int afford_count = 0;
-    for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
     {
-        if (g_enemy_spawn_director.enemy_spawn_costs[i] > g_enemy_spawn_director.spawn_credits)
-        {
-            continue;
-        }
+        game->projectiles_data.player_projectiles[i] = (Projectile_Player_t){.type = PROJECTILE_TYPE_PLAYER_BURST, .position = {.x = i, .y = 400}, .velocity = {.x = 0, .y = -200}};
+    }
 
-        affordable_enemies[afford_count].enemy_type = i;
-        affordable_enemies[afford_count].spawn_chance = g_levels_data.levels[g_enemy_spawn_director.current_level].enemy_spawn_chances[i];
+    for (int i = 0; i < game->projectiles_data.enemy_projectile_count; i++)
+    {
+        game->projectiles_data.enemy_projectiles[i] = (Projectile_Enemy_t){.type = PROJECTILE_TYPE_ENEMY_SHOOTER, .position = {.x = i * 4, .y = 200}, .velocity = {.x = 0, .y = 60}};
+    }
 
-        afford_count++;
+    static Save_State_t state;
+
+    double time_save_max = 0;
+    double time_restore_max = 0;
+    double time_start = sim_clock_seconds();
+
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        double time_before = sim_clock_seconds();
+        save_state_capture(game, &state);
+        double time_between = sim_clock_seconds();
+        save_state_restore(game, &state);
+        double time_after = sim_clock_seconds();
+
+        time_save_max = fmax(time_save_max, time_between - time_before);
+        time_restore_max = fmax(time_restore_max, time_after - time_between);
     }
 
-    while (afford_count)
+    double time_total = sim_clock_seconds() - time_start;
+
+    // A file of its own in the temp directory, the player's quicksave is left alone
+    char path[] = P_tmpdir "/aegis_save_state_XXXXXX";
+    int file_descriptor = mkstemp(path);
+    if (file_descriptor >= 0)
     {
-        {
-            // Balance affordable enemies
-            float total_chance = 0;
-            for (int i = 0; i < afford_count; i++)
-            {
-                total_chance += affordable_enemies[i].spawn_chance;
-            }
+        close(file_descriptor);
+    }
 
-            float difference = 1.0f / total_chance;
+    double time_file_start = sim_clock_seconds();
+    bool is_file_ok = file_descriptor >= 0 && save_state_write_file(game, path) && save_state_read_file(game, path);
+    double time_file = sim_clock_seconds() - time_file_start;
 
-            for (int i = 0; i < afford_count; i++)
-            {
-                affordable_enemies[i].spawn_chance *= difference;
-            }
-        }
+    if (file_descriptor >= 0)
+    {
+        remove(path);
+    }
 
-        // TODO
-        // "spawn_weight" is not descriptive enough
-        float spawn_weight = rand() / (float)RAND_MAX;
+    printf("Save state: %zu bytes\n", sizeof(Save_State_t));
+    printf("Save + restore: %.2f us average over %d iterations\n", time_total / ITERATIONS * 1e6, ITERATIONS);
+    printf("Save max: %.2f us, restore max: %.2f us\n", time_save_max * 1e6, time_restore_max * 1e6);
+    printf("File write + read: %.2f us (%s)\n", time_file * 1e6, is_file_ok ? "ok" : "failed");
+    printf("State checksum: %016llx\n", sim_state_checksum(game));
 
-        Enemy_Type_e new_enemy_type = ENEMY_TYPE_NONE;
+    return (time_save_max < 1e-3 && time_restore_max < 1e-3 && is_file_ok) ? 0 : 1;
+}
 
-        float running_total = 0;
+// Compares the float and fixed point versions of the simulation's vector math, whichever one the build uses
+int sim_math_benchmark(Game_t *game)
+{
+    enum
+    {
+        VECTORS = 4096,
+        PASSES = 500
+    };
 
-        for (int i = 0; i < afford_count; i++)
-        {
-            if (spawn_weight < running_total || spawn_weight > running_total + affordable_enemies[i].spawn_chance)
-            {
-                running_total += affordable_enemies[i].spawn_chance;
-                continue;
-            }
+    static Vector2 vectors[VECTORS];
+    static float angles[VECTORS];
 
-            // running_total += affordable_enemies[i].spawn_chance;
-            new_enemy_type = affordable_enemies[i].enemy_type;
+    for (int i = 0; i < VECTORS; i++)
+    {
+        vectors[i] = (Vector2){.x = rand_range_float(game, -600, 600), .y = rand_range_float(game, -800, 800)};
+        angles[i] = rand_range_float(game, -PI, PI);
+    }
 
-            break;
-        }
+    Vector2 sum_float = {0};
+    double time_start = sim_clock_seconds();
 
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        for (int i = 0; i < VECTORS; i++)
         {
-            g_enemy_spawn_director.enemy_spawn_chances[new_enemy_type] *= g_levels_data.levels[g_enemy_spawn_director.current_level].enemy_spawn_chance_factor[new_enemy_type];
+            Vector2 direction = Vector2Rotate(Vector2Normalize(vectors[i]), angles[i]);
+            sum_float = Vector2Add(sum_float, Vector2Scale(direction, Vector2Length(vectors[i])));
+        }
+    }
 
-            // Balance absolute spawn chances
-            float total_chance = 0;
-            for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
-            {
-                total_chance += g_enemy_spawn_director.enemy_spawn_chances[i];
-            }
+    double time_float = sim_clock_seconds() - time_start;
 
-            float difference = 1.0f / total_chance;
+    long long sum_fixed = 0;
+    float error_max = 0;
+    time_start = sim_clock_seconds();
 
-            for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
-            {
-                g_enemy_spawn_director.enemy_spawn_chances[i] *= difference;
-            }
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        for (int i = 0; i < VECTORS; i++)
+        {
+            Fixed_t x = fixed_from_float(vectors[i].x);
+            Fixed_t y = fixed_from_float(vectors[i].y);
+            Fixed_t length = fixed_length(x, y);
+            Fixed_t sin_angle;
+            Fixed_t cos_angle;
+            fixed_sin_cos(fixed_from_float(angles[i]), &sin_angle, &cos_angle);
+
+            Fixed_t normal_x = fixed_div(x, length);
+            Fixed_t normal_y = fixed_div(y, length);
+            sum_fixed += fixed_mul(fixed_mul(normal_x, cos_angle) - fixed_mul(normal_y, sin_angle), length);
+            sum_fixed += fixed_mul(fixed_mul(normal_x, sin_angle) + fixed_mul(normal_y, cos_angle), length);
         }
+    }
 
-        // Find a free enemy index:
-        for (int i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
-        {
-            // If at last index, return: else continue
-            if (g_enemies_data.enemies[i].type != ENEMY_TYPE_NONE)
-            {
-                if (i == g_enemies_data.ENEMIES_COUNT - 1)
-                {
-                    return;
-                }
+    double time_fixed = sim_clock_seconds() - time_start;
 
-                continue;
-            }
+    for (int i = 0; i < VECTORS; i++)
+    {
+        Fixed_t sin_angle;
+        Fixed_t cos_angle;
+        fixed_sin_cos(fixed_from_float(angles[i]), &sin_angle, &cos_angle);
 
-            float new_x = rand_range_int(0, (g_window.width - g_enemies_data.enemy_database[new_enemy_type].width));
-            float new_y = -rand_range_int((-1) * g_enemy_spawn_director.spawn_y, (-1) * g_enemy_spawn_director.spawn_y + SPAWN_INTERVAL_Y);
+        Vector2 expected = Vector2Rotate(vectors[i], angles[i]);
+        Vector2 actual = {
+            .x = fixed_to_float(fixed_mul(fixed_from_float(vectors[i].x), cos_angle) - fixed_mul(fixed_from_float(vectors[i].y), sin_angle)),
+            .y = fixed_to_float(fixed_mul(fixed_from_float(vectors[i].x), sin_angle) + fixed_mul(fixed_from_float(vectors[i].y), cos_angle))};
 
-            // Move new enemy if it collides with any pre-existing ones
-            for (int i = 0; i < 10; i++)
-            {
-                bool is_colliding = false;
+        error_max = fmax(error_max, Vector2Length(Vector2Subtract(expected, actual)));
+    }
 
-                Rectangle current_enemy_hitbox;
-                Rectangle new_enemy_hitbox;
+    printf("Simulation math is %s in this build\n", SIM_FIXED_POINT ? "fixed point" : "float");
+    printf("Float normalize + rotate + length: %.2f ns per vector\n", time_float / ((double)PASSES * VECTORS) * 1e9);
+    printf("Fixed normalize + rotate + length: %.2f ns per vector\n", time_fixed / ((double)PASSES * VECTORS) * 1e9);
+    printf("Largest rotation difference: %.4f px, checks %.1f %.1f\n", error_max, sum_float.x + sum_float.y, sum_fixed / (double)FIXED_ONE);
 
-                for (int j = 0; j < g_enemies_data.ENEMIES_COUNT; j++)
-                {
-                    current_enemy_hitbox = (Rectangle){
-                        .x = g_enemies_data.enemies[j].position.x,
-                        .y = g_enemies_data.enemies[j].position.y,
-                        .width = g_enemies_data.enemy_database[g_enemies_data.enemies[j].type].width,
-                        .height = g_enemies_data.enemy_database[g_enemies_data.enemies[j].type].height};
-
-                    new_enemy_hitbox = (Rectangle){
-                        .x = new_x,
-                        .y = new_y,
-                        .width = g_enemies_data.enemy_database[new_enemy_type].width,
-                        .height = g_enemies_data.enemy_database[new_enemy_type].height};
-
-                    if (CheckCollisionRecs(current_enemy_hitbox, new_enemy_hitbox))
-                    {
-                        is_colliding = true;
-                        break;
-                    }
-                }
+    return 0;
+}
 
-                if (!is_colliding)
-                {
-                    break;
-                }
+// Re-simulates a replay and compares the state checksum after every tick with the recorded one
+// Restores the recorded starting state, playing a replay back is not a level attempt
+void replay_begin_playback(Game_t *game)
+{
+    save_state_restore(game, &g_replay.state_initial);
 
-                new_x = rand_range_int(0, (g_window.width - g_enemies_data.enemy_database[new_enemy_type].width));
-                new_y = -rand_range_int((-1) * g_enemy_spawn_director.spawn_y, (-1) * g_enemy_spawn_director.spawn_y + SPAWN_INTERVAL_Y);
-            }
+    // Nothing of a playback is recorded
+    game->recorders = NULL;
 
-            Enemy_t new_enemy = {
-                .type = new_enemy_type,
-                .current_health = g_enemies_data.enemy_database[new_enemy_type].max_health,
-                .time_last_fired = g_enemies_data.enemy_database[new_enemy_type].time_firing_interval,
-                .has_attempted_first_shot = false,
-                .position = (Vector2){.x = new_x,
-                                      .y = new_y}};
+    game->gamestate_current = STATE_LEVEL;
+    game->transition_time = 0;
+    game->transition_duration = 0;
+}
 
-            g_enemies_data.enemies[i] = new_enemy;
-            g_enemy_spawn_director.spawn_credits -= g_enemy_spawn_director.enemy_spawn_costs[new_enemy_type];
+void replay_play_tick(Game_t *game, int tick_index)
+{
+    game->sim_input = g_replay.ticks[tick_index].input;
+    game->frame_time = g_replay.ticks[tick_index].frame_time;
 
-            break;
-        }
+    // Debug keys were either harmless or stopped the recording
+    game->sim_input.debug_save_state = false;
+    game->sim_input.debug_load_state = false;
+    game->sim_input.debug_rewind_toggle = false;
+    game->sim_input.debug_rewind_steps = 0;
 
-        for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
+    level_tick(game);
+}
+
+int replay_verify(Game_t *game, const char *path)
+{
+    if (!replay_read_file(path))
+    {
+        return 1;
+    }
+
+    replay_begin_playback(game);
+
+    double time_start = sim_clock_seconds();
+
+    for (int i = 0; i < g_replay.tick_count; i++)
+    {
+        replay_play_tick(game, i);
+
+        unsigned long long checksum = sim_state_checksum(game);
+        if (checksum != g_replay.ticks[i].checksum)
         {
-            affordable_enemies[i].enemy_type = ENEMY_TYPE_NONE;
-            affordable_enemies[i].spawn_chance = 0;
+            printf("Replay diverged at tick %d of %d: checksum %016llx, recorded %016llx\n", i, g_replay.tick_count, checksum, g_replay.ticks[i].checksum);
+            return 1;
         }
+    }
 
-        afford_count = 0;
-        for (int i = 0; i < ENEMY_TYPE_COUNT; i++)
-        {
-            if (g_enemy_spawn_director.enemy_spawn_costs[i] > g_enemy_spawn_director.spawn_credits)
-            {
-                continue;
-            }
+    double time_total = sim_clock_seconds() - time_start;
+
+    printf("Replay verified: %d ticks, final checksum %016llx\n", g_replay.tick_count, g_replay.tick_count ? g_replay.ticks[g_replay.tick_count - 1].checksum : 0ULL);
+    printf("Simulation: %.2f us per tick, %.0f ticks per second\n", time_total / (g_replay.tick_count ? g_replay.tick_count : 1) * 1e6, g_replay.tick_count / (time_total > 0 ? time_total : 1e-9));
+
+    return 0;
+}
+
+// Renders a replay through a hidden window and compares evenly spaced frames against golden PNGs. The reference is
+// golden/reference.rep, the first level played by the tuner's policy. It is drawn by Mesa's software rasterizer, so the
+// goldens do not depend on the GPU and driver of the machine:
+//   --golden-replay golden/reference.rep                  records the reference replay again once the replay version changes
+//   --golden-frames golden/reference.rep golden --update  writes frame_000.png and up into golden
+// Later runs without --update compare against them
+struct
+{
+    const int LEVEL;
+    const unsigned long long SEED;
+
+    const int FRAMES_COUNT;
+    const int CHANNEL_TOLERANCE;     // Per color channel, absorbs rasterizer rounding differences between Mesa versions
+    const float PIXELS_TOLERANCE;    // Fraction of pixels allowed to differ before a frame fails
+} g_golden_frames = {
+    .LEVEL = 0,
+    .SEED = 1,
+
+    .FRAMES_COUNT = 16,
+    .CHANNEL_TOLERANCE = 8,
+    .PIXELS_TOLERANCE = 0.001f,
+};
+
+// Returns how many pixels differ by more than the channel tolerance, every pixel when the sizes differ
+int golden_frames_compare(Image actual, Image golden)
+{
+    if (actual.width != golden.width || actual.height != golden.height)
+    {
+        return actual.width * actual.height;
+    }
+
+    Color *actual_colors = LoadImageColors(actual);
+    Color *golden_colors = LoadImageColors(golden);
+
+    int pixels_different = 0;
+
+    for (int i = 0; i < actual.width * actual.height; i++)
+    {
+        int difference = abs(actual_colors[i].r - golden_colors[i].r);
+        difference = fmax(difference, abs(actual_colors[i].g - golden_colors[i].g));
+        difference = fmax(difference, abs(actual_colors[i].b - golden_colors[i].b));
+
+        pixels_different += difference > g_golden_frames.CHANNEL_TOLERANCE;
+    }
+
+    UnloadImageColors(actual_colors);
+    UnloadImageColors(golden_colors);
+
+    return pixels_different;
+}
+
+// Returns true when the frame matches its golden, or was written as the new golden
+bool golden_frames_check(Image actual, const char *directory, int frame_index, bool is_updating)
+{
+    const char *golden_path = TextFormat("%s/frame_%03d.png", directory, frame_index);
+
+    if (is_updating)
+    {
+        return ExportImage(actual, golden_path);
+    }
+
+    if (!FileExists(golden_path))
+    {
+        printf("Frame %d: missing golden %s\n", frame_index, golden_path);
+        return false;
+    }
 
-            affordable_enemies[afford_count].enemy_type = i;
-            affordable_enemies[afford_count].spawn_chance = g_enemy_spawn_director.enemy_spawn_chances[i];
+    Image golden = LoadImage(golden_path);
+    int pixels_different = golden_frames_compare(actual, golden);
+    UnloadImage(golden);
 
-            afford_count++;
-        }
+    if (pixels_different <= g_golden_frames.PIXELS_TOLERANCE * actual.width * actual.height)
+    {
+        return true;
     }
 
-    g_enemy_spawn_director.spawn_y -= SPAWN_INTERVAL_Y;
+    const char *actual_path = TextFormat("%s/frame_%03d.actual.png", directory, frame_index);
+    ExportImage(actual, actual_path);
+    printf("Frame %d: %d pixels differ from the golden, wrote %s\n", frame_index, pixels_different, actual_path);
+
+    return false;
 }
 
-void enemies_update_spawn_conditions()
+int golden_frames_run(Game_t *game, const char *replay_path, const char *directory, bool is_updating)
 {
-    if (IsKeyPressed(KEY_O))
+    if (!replay_read_file(replay_path))
     {
-        enemies_kill_all();
+        return 1;
     }
 
-    if (IsKeyPressed(KEY_P))
-    {
-        enemies_end_level();
-    }
+    // Pins the software rasterizer, it has to be set before the GL context is created
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(g_window.width, g_window.height, "Arcade Project");
+    atlas_bake(game);
+    render_target_update();
 
-    if (g_enemy_spawn_director.total_spawn_credits > g_levels_data.levels[g_enemy_spawn_director.current_level].spawn_credits_target)
+    replay_begin_playback(game);
+
+    memset(g_draw_timings.seconds, 0, sizeof(g_draw_timings.seconds));
+    g_draw_timings.is_enabled = true;
+
+    // Every tick is drawn for the timings, only the captured ones are compared
+    int capture_interval = fmax(g_replay.tick_count / g_golden_frames.FRAMES_COUNT, 1);
+    int frames_captured = 0;
+    int frames_failed = 0;
+
+    for (int i = 0; i < g_replay.tick_count; i++)
     {
-        if (g_enemy_spawn_director.spawn_credits < 0)
+        replay_play_tick(game, i);
+
+        render_target_begin_frame();
+        render_view_use_live(game);
+        level_draw(game);
+
+        // Flushes the batch so the read back sees the whole frame
+        EndMode2D();
+
+        if ((i + 1) % capture_interval == 0 && frames_captured < g_golden_frames.FRAMES_COUNT)
         {
-            if (enemies_all_dead())
-            {
-                g_gamestate_previous = STATE_LEVEL;
-                g_gamestate_current = STATE_UPGRADE;
-                g_transition_time = 0;
-                g_transition_duration = 4;
-                g_enemy_spawn_director.next_level++;
-                if (g_enemy_spawn_director.next_level > g_enemy_spawn_director.max_level)
-                {
-                    g_enemy_spawn_director.next_level = g_enemy_spawn_director.max_level;
-                }
-                projectiles_init();
-            }
-            return;
+            Image actual = LoadImageFromScreen();
+            frames_failed += !golden_frames_check(actual, directory, frames_captured, is_updating);
+            UnloadImage(actual);
+
+            frames_captured++;
         }
 
-        g_enemy_spawn_director.time_next_wave += rand_range_float(g_levels_data.levels[g_enemy_spawn_director.current_level].time_next_wave_min, g_levels_data.levels[g_enemy_spawn_director.current_level].time_next_wave_max);
-        enemies_spawn_wave();
-        g_enemy_spawn_director.spawn_credits = -1;
-        return;
+        EndDrawing();
     }
 
-    (g_enemy_spawn_director.spawn_y) += g_enemies_data.ENEMY_SPEED * g_frame_time;
-    if (g_enemy_spawn_director.spawn_y > g_enemy_spawn_director.spawn_y_min)
+    g_draw_timings.is_enabled = false;
+    CloseWindow();
+
+    for (int i = 0; i < DRAW_TIMING_COUNT; i++)
     {
-        g_enemy_spawn_director.spawn_y = g_enemy_spawn_director.spawn_y_min;
+        printf("%s: %.2f us per frame\n", g_draw_timings.NAMES[i], g_draw_timings.seconds[i] / (g_replay.tick_count ? g_replay.tick_count : 1) * 1e6);
     }
 
-    g_enemy_spawn_director.time_next_wave -= g_frame_time;
-
-    g_enemy_spawn_director.spawn_credits += g_levels_data.levels[g_enemy_spawn_director.current_level].spawn_credits_build_rate * g_frame_time;
-    g_enemy_spawn_director.total_spawn_credits += g_levels_data.levels[g_enemy_spawn_director.current_level].spawn_credits_build_rate * g_frame_time;
-
-    if (g_enemy_spawn_director.time_next_wave > 0)
+    if (is_updating)
     {
-        return;
+        printf("Golden frames: wrote %d frames to %s\n", frames_captured, directory);
+        return frames_failed > 0;
     }
 
-    g_enemy_spawn_director.time_next_wave += rand_range_float(g_levels_data.levels[g_enemy_spawn_director.current_level].time_next_wave_min, g_levels_data.levels[g_enemy_spawn_director.current_level].time_next_wave_max);
-    enemies_spawn_wave();
+    printf("Golden frames: %d of %d frames match\n", frames_captured - frames_failed, frames_captured);
+
+    return frames_failed > 0;
 }
 
-void enemies_draw()
+// The numbers of a level that the tuner searches over
+typedef enum
 {
-    for (int i = 0; i < g_enemies_data.ENEMIES_COUNT; i++)
-    {
-        Enemy_t *current_enemy = &g_enemies_data.enemies[i];
-        if (g_enemies_data.enemies[i].type == ENEMY_TYPE_NONE)
-        {
-            continue;
-        }
+    LEVEL_TUNER_PARAM_BUILD_RATE,
+    LEVEL_TUNER_PARAM_CREDITS_TARGET,
+    LEVEL_TUNER_PARAM_WAVE_TIME_MIN,
+    LEVEL_TUNER_PARAM_WAVE_TIME_SPREAD,    // time_next_wave_max - time_next_wave_min
+    LEVEL_TUNER_PARAM_CHANCE_FACTOR_FIRST, // One per enemy type except none
+    LEVEL_TUNER_PARAM_COUNT = LEVEL_TUNER_PARAM_CHANCE_FACTOR_FIRST + ENEMY_TYPE_COUNT - 1
+} Level_Tuner_Param_e;
+
+// Offline evolution strategy over the level table. Every level keeps a parent and tries mutated children against
+// the same attempt seeds, the attempts run on a thread per core with a game each that plays its candidate in a level table of its own
+struct
+{
+    const float PARAMS_MIN[LEVEL_TUNER_PARAM_COUNT];
+    const float PARAMS_MAX[LEVEL_TUNER_PARAM_COUNT];
+    const float SIGMA_START; // Mutation size as a fraction of each parameter's range
+    const float SIGMA_MIN;
+    const float SIGMA_MAX;
 
-        // Enemy
-        DrawRectangle(
-            current_enemy->position.x,
-            current_enemy->position.y,
-            g_enemies_data.enemy_database[current_enemy->type].width,
-            g_enemies_data.enemy_database[current_enemy->type].height,
-            g_enemies_data.enemy_database[current_enemy->type].color);
+    // The policy should win the first level this often, falling linearly to the last level
+    const float WIN_RATE_FIRST;
+    const float WIN_RATE_LAST;
 
-        if (current_enemy->time_healthbar_visible < g_enemies_data.health_bar_visibility_duration)
-        {
-            // Healthbar base
-            DrawRectangle(
-                enemy_get_center(*current_enemy).x - g_enemies_data.healthbar_width / 2,
-                current_enemy->position.y - 10,
-                g_enemies_data.healthbar_width,
-                8,
-                RED);
+    const Player_Policy_e POLICY;
 
-            // Healthbar fill
-            DrawRectangle(
-                enemy_get_center(*current_enemy).x - g_enemies_data.healthbar_width / 2,
-                current_enemy->position.y - 10,
-                Clamp((float)g_enemies_data.healthbar_width * (current_enemy->current_health / (float)g_enemies_data.enemy_database[current_enemy->type].max_health), 0, g_enemies_data.healthbar_width),
-                8,
-                GREEN);
-        }
-    }
+    // The loadout assumed at a level, one more weapon unlocked every UNLOCK_INTERVAL levels and one upgrade every UPGRADE_INTERVAL after that
+    const int UNLOCK_INTERVAL;
+    const int UPGRADE_INTERVAL;
+
+    const float SECONDS_MAX; // Level time after which an attempt counts as lost
+
+    unsigned long long rng_state;
+} g_level_tuner = {
+    .PARAMS_MIN = {1, 40, 3, 0, 0.25f, 0.25f, 0.25f, 0.25f},
+    .PARAMS_MAX = {30, 800, 20, 10, 2, 2, 2, 2},
+    .SIGMA_START = 0.15f,
+    .SIGMA_MIN = 0.01f,
+    .SIGMA_MAX = 0.5f,
+
+    .WIN_RATE_FIRST = 0.95f,
+    .WIN_RATE_LAST = 0.4f,
+
+    .POLICY = PLAYER_POLICY_NEAREST_THREAT,
+
+    .UNLOCK_INTERVAL = 5,
+    .UPGRADE_INTERVAL = 2,
+
+    .SECONDS_MAX = 600,
+
+    .rng_state = 0x2545F4914F6CDD1DULL};
+
+float level_tuner_get_target_win_rate(int level)
+{
+    return Lerp(g_level_tuner.WIN_RATE_FIRST, g_level_tuner.WIN_RATE_LAST, level / (float)(g_levels_data.LEVEL_COUNT - 1));
 }
 
-void explosion_spawn_expl(const Explosion_t EXPLOSION)
+void level_tuner_get_params(const Level_Data_t *LEVEL, float params[])
 {
-    for (int i = 0; i < g_explosions_data.EXPLOSIONS_COUNT; i++)
+    params[LEVEL_TUNER_PARAM_BUILD_RATE] = LEVEL->spawn_credits_build_rate;
+    params[LEVEL_TUNER_PARAM_CREDITS_TARGET] = LEVEL->spawn_credits_target;
+    params[LEVEL_TUNER_PARAM_WAVE_TIME_MIN] = LEVEL->time_next_wave_min;
+    params[LEVEL_TUNER_PARAM_WAVE_TIME_SPREAD] = LEVEL->time_next_wave_max - LEVEL->time_next_wave_min;
+    for (int i = 1; i < ENEMY_TYPE_COUNT; i++)
     {
-        if (g_explosions_data.explosions[i].time_alive < g_explosions_data.explosions[i].time_lifetime)
-        {
-            continue;
-        }
-
-        g_explosions_data.explosions[i] = EXPLOSION;
-        break;
+        params[LEVEL_TUNER_PARAM_CHANCE_FACTOR_FIRST + i - 1] = LEVEL->enemy_spawn_chance_factor[i];
     }
 }
 
-bool create_button_text(bool disabled, int center_x, int center_y, int width, int height, Color button_color, bool change_on_hover, Color hover_color, char *text, int font_size, Color text_color, int spacing)
+// Enemy types a level never spawns keep their factor, so the tuner does not change which enemies a level has
+void level_tuner_set_params(Level_Data_t *level, const float PARAMS[])
 {
-    int origin_x = center_x - width / 2;
-    int origin_y = center_y - height / 2;
-
-    if (change_on_hover && CheckCollisionPointRec(g_mouse_position, (Rectangle){origin_x, origin_y, width, height}))
+    level->spawn_credits_build_rate = PARAMS[LEVEL_TUNER_PARAM_BUILD_RATE];
+    level->spawn_credits_target = PARAMS[LEVEL_TUNER_PARAM_CREDITS_TARGET];
+    level->time_next_wave_min = PARAMS[LEVEL_TUNER_PARAM_WAVE_TIME_MIN];
+    level->time_next_wave_max = PARAMS[LEVEL_TUNER_PARAM_WAVE_TIME_MIN] + PARAMS[LEVEL_TUNER_PARAM_WAVE_TIME_SPREAD];
+    for (int i = 1; i < ENEMY_TYPE_COUNT; i++)
     {
-        button_color = hover_color;
+        if (level->enemy_spawn_chances[i] > 0)
+        {
+            level->enemy_spawn_chance_factor[i] = PARAMS[LEVEL_TUNER_PARAM_CHANCE_FACTOR_FIRST + i - 1];
+        }
     }
+}
 
-    DrawRectangle(origin_x, origin_y, width, height, button_color);
+float level_tuner_rand_gaussian()
+{
+    // Box-Muller, the first uniform is kept away from zero for the logarithm
+    float u = (rand_next_from(&g_level_tuner.rng_state) + 1.0f) / ((float)RAND_NEXT_MAX + 1.0f);
+    float v = rand_float_from(&g_level_tuner.rng_state);
+    return sqrtf(-2 * logf(u)) * cosf(2 * PI * v);
+}
 
-    Vector2 text_size = MeasureTextEx(GetFontDefault(), text, font_size, spacing);
-    DrawTextEx(GetFontDefault(), text, (Vector2){.x = center_x - (text_size.x / 2), .y = center_y - (text_size.y / 2)}, font_size, spacing, text_color);
+void level_tuner_mutate(const Level_Data_t *PARENT, Level_Data_t *child, float sigma)
+{
+    float params[LEVEL_TUNER_PARAM_COUNT];
+    level_tuner_get_params(PARENT, params);
 
-    if (disabled)
+    for (int i = 0; i < LEVEL_TUNER_PARAM_COUNT; i++)
     {
-        return false;
+        float range = g_level_tuner.PARAMS_MAX[i] - g_level_tuner.PARAMS_MIN[i];
+        params[i] = Clamp(params[i] + level_tuner_rand_gaussian() * sigma * range, g_level_tuner.PARAMS_MIN[i], g_level_tuner.PARAMS_MAX[i]);
     }
 
-    if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    *child = *PARENT;
+    level_tuner_set_params(child, params);
+}
+
+void level_tuner_apply_loadout(Game_t *game, int level)
+{
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
     {
-        return false;
+        int levels_owned = level - i * g_level_tuner.UNLOCK_INTERVAL;
+        game->weapons_data.weapons[i].is_unlocked = levels_owned >= 0;
+        game->weapons_data.weapons[i].level_current = Clamp(levels_owned / g_level_tuner.UPGRADE_INTERVAL, 0, game->weapons_data.level_max);
     }
-    return CheckCollisionPointRec(g_mouse_position, (Rectangle){.x = origin_x, .y = origin_y, .width = width, .height = height});
 }
 
-bool create_button_text_border(bool disabled, int center_x, int center_y, int width, int height, Color button_color, bool change_on_hover, Color hover_color, const char *text, int font_size, Color text_color, int spacing, int border_thickness, Color border_color)
+// Starts a level without the transition and with the tuner's loadout, for the tools that play levels without a window
+void level_start_headless(Game_t *game, int level, unsigned long long seed)
 {
-    int origin_x = center_x - width / 2;
-    int origin_y = center_y - height / 2;
+    level_tuner_apply_loadout(game, level);
 
-    if (change_on_hover && CheckCollisionPointRec(g_mouse_position, (Rectangle){origin_x, origin_y, width, height}))
-    {
-        button_color = hover_color;
-    }
+    rand_seed(game, seed);
+    enemy_spawn_director_init_level(game, level);
+    game->transition_time = 0;
+    game->transition_duration = 0;
 
-    DrawRectangle(origin_x, origin_y, width, height, button_color);
-    DrawRectangleLinesEx(
-        (Rectangle){.x = origin_x, .y = origin_y, .width = width, .height = height},
-        border_thickness,
-        border_color);
+    game->frame_time = 1.0f / g_sim_thread.TICK_RATE;
+}
 
-    Vector2 text_size = MeasureTextEx(GetFontDefault(), text, font_size, spacing);
-    DrawTextEx(GetFontDefault(), text, (Vector2){.x = center_x - (text_size.x / 2), .y = center_y - (text_size.y / 2)}, font_size, spacing, text_color);
+// Plays one attempt of a level with the active player policy, returns true if it was won
+bool level_tuner_play_attempt(Game_t *game, int level, unsigned long long seed)
+{
+    level_start_headless(game, level, seed);
 
-    if (disabled)
-    {
-        return false;
-    }
+    int ticks_max = g_level_tuner.SECONDS_MAX * g_sim_thread.TICK_RATE;
 
-    if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    for (int tick = 0; tick < ticks_max && sim_level_is_running(game); tick++)
     {
-        return false;
+        game->sim_input = (Sim_Input_t){.time_scale = 1};
+        level_tick(game);
     }
-    return CheckCollisionPointRec(g_mouse_position, (Rectangle){.x = origin_x, .y = origin_y, .width = width, .height = height});
+
+    return game->gamestate_current == STATE_UPGRADE;
 }
 
-bool create_button_border(bool disabled, int center_x, int center_y, int width, int height, Color button_color, bool change_on_hover, Color hover_color, int border_thickness, Color border_color)
+// Records the reference replay of the golden frames, the same level, seed and policy always play out the same
+int golden_frames_record_replay(Game_t *game, const char *path)
 {
-    int origin_x = center_x - width / 2;
-    int origin_y = center_y - height / 2;
+    Game_Recorders_t recorders = {.replay_path = path, .telemetry_path = NULL};
+
+    game->recorders = &recorders;
+    game->player_policy = g_level_tuner.POLICY;
+    level_tuner_play_attempt(game, g_golden_frames.LEVEL, g_golden_frames.SEED);
+    game->recorders = NULL;
 
-    if (CheckCollisionPointRec(g_mouse_position, (Rectangle){.x = origin_x, origin_y, width, height}) && change_on_hover)
+    // The replay is only written when the level ends
+    if (sim_level_is_running(game))
     {
-        button_color = hover_color;
+        printf("Level %d did not end within %.0f seconds, no replay was written\n", g_golden_frames.LEVEL + 1, g_level_tuner.SECONDS_MAX);
+        return 1;
     }
 
-    DrawRectangle(origin_x, origin_y, width, height, button_color);
-    DrawRectangleLinesEx(
-        (Rectangle){.x = origin_x, .y = origin_y, .width = width, .height = height},
-        border_thickness,
-        border_color);
+    return 0;
+}
 
-    if (disabled)
-    {
-        return false;
-    }
+// Plays one attempt of a candidate, which replaces the level in a copy of the level table played by this game only
+bool level_tuner_play(Game_t *game, const Level_Data_t *LEVEL, int level, unsigned long long seed)
+{
+    Level_Data_t levels[sizeof(g_levels_data.levels) / sizeof(g_levels_data.levels[0])];
+    memcpy(levels, g_levels_data.levels, sizeof(levels));
+    levels[level] = *LEVEL;
 
-    if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
-    {
-        return false;
-    }
-    return CheckCollisionPointRec(g_mouse_position, (Rectangle){.x = origin_x, .y = origin_y, .width = width, .height = height});
+    game->levels = levels;
+    bool is_won = level_tuner_play_attempt(game, level, seed);
+    game->levels = g_levels_data.levels;
+
+    return is_won;
 }
 
-void projectile_check_collision(Projectile_Player_t *projectile)
+// One attempt played by the workers, a candidate level replaces its level in the table of that attempt's game only
+typedef struct
 {
-    // TODO
-    // Enemies outside the screen should not be able to be damaged by projectiles, only their explosions
+    const Level_Data_t *LEVEL; // NULL plays the level of the built in table
+    int level;
+    unsigned long long seed;
+} Game_Attempt_t;
 
-    for (int enemy_index = 0; enemy_index < g_enemies_data.ENEMIES_COUNT; enemy_index++)
-    {
-        Enemy_t *current_enemy = &g_enemies_data.enemies[enemy_index];
+// A worker of games_run_workers(), it plays every attempt_stride-th attempt on a game of its own
+typedef struct
+{
+    pthread_t thread;
+    Game_t *game;
 
-        if (current_enemy->type == ENEMY_TYPE_NONE)
-        {
-            continue;
-        }
+    const Game_Attempt_t *ATTEMPTS;
+    int attempt_first;
+    int attempt_stride;
+    int attempt_count;
 
-        if (current_enemy->current_health <= 0)
-        {
-            continue;
-        }
+    bool *wins; // One per attempt, the workers write disjoint entries
+    long long ticks;
+} Game_Worker_t;
+
+void *game_worker_main(void *argument)
+{
+    Game_Worker_t *worker = argument;
 
-        if (current_enemy->position.y <= -g_enemies_data.enemy_database[current_enemy->type].height)
+    for (int i = worker->attempt_first; i < worker->attempt_count; i += worker->attempt_stride)
+    {
+        const Game_Attempt_t *ATTEMPT = &worker->ATTEMPTS[i];
+        if (ATTEMPT->LEVEL != NULL)
         {
-            continue;
+            worker->wins[i] = level_tuner_play(worker->game, ATTEMPT->LEVEL, ATTEMPT->level, ATTEMPT->seed);
         }
-
-        // Check collision
-        if (CheckCollisionCircleRec(
-                projectile->position,
-                g_projectiles_data.player_projectile_database[projectile->type].radius,
-                (Rectangle){
-                    .height = g_enemies_data.enemy_database[current_enemy->type].height,
-                    .width = g_enemies_data.enemy_database[current_enemy->type].width,
-                    .x = current_enemy->position.x,
-                    .y = current_enemy->position.y}))
+        else
         {
-            Explosion_t new_explosion = g_projectiles_data.player_projectile_database[projectile->type].explosion;
-            new_explosion.position = projectile->position;
+            worker->wins[i] = level_tuner_play_attempt(worker->game, ATTEMPT->level, ATTEMPT->seed);
+        }
+        worker->ticks += roundf(worker->game->enemies_data.time_elapsed * g_sim_thread.TICK_RATE);
+    }
 
-            explosion_spawn_expl(new_explosion);
+    return NULL;
+}
 
-            // If the projectile is explosive
-            if (g_projectiles_data.player_projectile_database[projectile->type].is_explosive)
-            {
-                // Damage all enemies inside the explosion
-                for (int explosion_check_enemy_index = 0; explosion_check_enemy_index < g_enemies_data.ENEMIES_COUNT; explosion_check_enemy_index++)
-                {
-                    if (CheckCollisionCircleRec(
-                            projectile->position,
-                            g_projectiles_data.player_projectile_database[projectile->type].explosion.size,
-                            (Rectangle){
-                                .height = g_enemies_data.enemy_database[g_enemies_data.enemies[explosion_check_enemy_index].type].height,
-                                .width = g_enemies_data.enemy_database[g_enemies_data.enemies[explosion_check_enemy_index].type].width,
-                                .x = g_enemies_data.enemies[explosion_check_enemy_index].position.x,
-                                .y = g_enemies_data.enemies[explosion_check_enemy_index].position.y}))
-                    {
-                        Vector2 enemy_center = enemy_get_center(g_enemies_data.enemies[explosion_check_enemy_index]);
-
-                        float distance = Vector2Distance(enemy_center, projectile->position); // The distance between the enemy center and the projectile center
-
-                        float factor = 1 - (distance / g_projectiles_data.player_projectile_database[projectile->type].explosion.size); // How close to the origin of the explosion radius the enemy is
-                        factor = Clamp(factor, 0, 1);
-
-                        enemy_take_damage(explosion_check_enemy_index, g_projectiles_data.player_projectile_database[projectile->type].damage * (factor));
-                    }
-                }
-            }
-            // If the projectile is not explosive
-            else
-            {
-                enemy_take_damage(enemy_index, g_projectiles_data.player_projectile_database[projectile->type].damage);
-            }
+// Plays the attempts spread over worker_count threads with the tuner's policy, returns the wall-clock seconds or a negative value on failure
+double games_run_workers(int worker_count, const Game_Attempt_t ATTEMPTS[], int attempt_count, bool wins[], long long *ticks)
+{
+    Game_Worker_t *workers = calloc(worker_count, sizeof(Game_Worker_t));
+    if (workers == NULL)
+    {
+        return -1;
+    }
 
-            projectile->should_remove = true;
-            break;
+    bool is_ok = true;
+    for (int i = 0; i < worker_count && is_ok; i++)
+    {
+        workers[i] = (Game_Worker_t){.game = game_create(), .ATTEMPTS = ATTEMPTS, .attempt_first = i, .attempt_stride = worker_count, .attempt_count = attempt_count, .wins = wins};
+        is_ok = workers[i].game != NULL;
+        if (is_ok)
+        {
+            workers[i].game->player_policy = g_level_tuner.POLICY;
         }
     }
-}
 
-void projectile_player_spawn(const int WEAPON_INDEX, const float TIME_WAIT)
-{
-    Projectile_Player_t new_projectile = {0};
+    double time_start = sim_clock_seconds();
 
-    new_projectile.time_wait = TIME_WAIT;
-    new_projectile.type = g_weapons_data.weapons[WEAPON_INDEX].projectile_type;
-    new_projectile.should_remove = false;
+    int started_count = 0;
+    for (; started_count < worker_count && is_ok; started_count++)
+    {
+        if (pthread_create(&workers[started_count].thread, NULL, game_worker_main, &workers[started_count]) != 0)
+        {
+            printf("Could not start benchmark thread %d\n", started_count);
+            is_ok = false;
+            break;
+        }
+    }
 
-    new_projectile.position = g_player_data.center;
+    *ticks = 0;
+    for (int i = 0; i < started_count; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        *ticks += workers[i].ticks;
+    }
 
-    new_projectile.velocity = Vector2Subtract(g_mouse_position, new_projectile.position);
-    new_projectile.velocity = Vector2Normalize(new_projectile.velocity);
-    new_projectile.velocity = Vector2Scale(new_projectile.velocity, g_weapons_data.weapons[WEAPON_INDEX].start_velocity);
+    double time_total = sim_clock_seconds() - time_start;
 
-    if (g_weapons_data.weapons[WEAPON_INDEX].spread > 0)
+    for (int i = 0; i < worker_count; i++)
     {
-        float angle = rand() % g_weapons_data.weapons[WEAPON_INDEX].spread;
-        angle -= g_weapons_data.weapons[WEAPON_INDEX].spread / 2;
-        angle *= (rand() / (float)RAND_MAX);
+        free(workers[i].game);
+    }
+    free(workers);
 
-        // Convert to radians
-        angle *= (3.14f / 180);
+    return is_ok ? time_total : -1;
+}
+
+// Plays every attempt of every candidate on every core, attempt seeds are shared by all candidates of a generation so they are compared on the same waves
+bool level_tuner_evaluate(const Level_Data_t CANDIDATES[], const int CANDIDATE_LEVELS[], int candidate_count, int attempt_count, int generation, float win_rates[])
+{
+    int task_count = candidate_count * attempt_count;
 
-        new_projectile.velocity = Vector2Rotate(new_projectile.velocity, angle);
+    Game_Attempt_t *attempts = calloc(task_count, sizeof(Game_Attempt_t));
+    bool *wins = calloc(task_count, sizeof(bool));
+    if (attempts == NULL || wins == NULL)
+    {
+        printf("Could not allocate %d tuner attempts\n", task_count);
+        free(attempts);
+        free(wins);
+        return false;
     }
-    else
+
+    for (int task = 0; task < task_count; task++)
     {
-        new_projectile.velocity = Vector2Rotate(new_projectile.velocity, 0);
+        int candidate = task / attempt_count;
+        int attempt = task % attempt_count;
+        unsigned long long seed = (unsigned long long)(generation + 1) * 0x9E3779B97F4A7C15ULL ^ (unsigned long long)(attempt + 1) * 0xD1B54A32D192ED03ULL;
+        attempts[task] = (Game_Attempt_t){.LEVEL = &CANDIDATES[candidate], .level = CANDIDATE_LEVELS[candidate], .seed = seed};
     }
 
-    for (int i = 0; i < g_projectiles_data.player_projectile_count; i++)
+    int worker_count = Clamp(sysconf(_SC_NPROCESSORS_ONLN), 1, task_count);
+    long long ticks = 0;
+    bool is_ok = games_run_workers(worker_count, attempts, task_count, wins, &ticks) >= 0;
+
+    for (int candidate = 0; candidate < candidate_count; candidate++)
     {
-        if (PROJECTILE_TYPE_PLAYER_NONE == g_projectiles_data.player_projectiles[i].type)
+        int won = 0;
+        for (int attempt = 0; attempt < attempt_count; attempt++)
         {
-            g_projectiles_data.player_projectiles[i] = new_projectile;
-            break;
+            won += wins[candidate * attempt_count + attempt];
         }
+        win_rates[candidate] = won / (float)attempt_count;
     }
+
+    free(attempts);
+    free(wins);
+    return is_ok;
 }
 
-void projectiles_update()
+// Writes a level table in the layout of g_levels_data, to be pasted over it
+bool level_tuner_write_table(const char *path, const Level_Data_t LEVELS[])
 {
-    for (int i = 0; i < g_projectiles_data.player_projectile_count; i++)
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
     {
-        if (PROJECTILE_TYPE_PLAYER_NONE == g_projectiles_data.player_projectiles[i].type)
-        {
-            // printf("Projectile index %d - Type %d\n", i, (*projectiles)[i].type);
-            continue;
-        }
+        printf("Could not open %s for the tuned levels\n", path);
+        return false;
+    }
 
-        if (g_projectiles_data.player_projectiles[i].should_remove)
+    fprintf(file, "    .levels = {\n");
+    for (int i = 0; i < g_levels_data.LEVEL_COUNT; i++)
+    {
+        const Level_Data_t *LEVEL = &LEVELS[i];
+
+        fprintf(file, "    {   // Level %d\n", i + 1);
+        fprintf(file, "        .spawn_credits_build_rate = %.2ff,\n", LEVEL->spawn_credits_build_rate);
+        fprintf(file, "        .spawn_credits_target = %.0f,\n\n", LEVEL->spawn_credits_target);
+        fprintf(file, "        .time_next_wave_min = %.2ff,\n", LEVEL->time_next_wave_min);
+        fprintf(file, "        .time_next_wave_max = %.2ff,\n\n", LEVEL->time_next_wave_max);
+
+        fprintf(file, "        .enemy_spawn_chances = {");
+        for (int type = 0; type < ENEMY_TYPE_COUNT; type++)
         {
-            g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-            continue;
+            fprintf(file, " %.4ff%s", LEVEL->enemy_spawn_chances[type], type < ENEMY_TYPE_COUNT - 1 ? "," : "");
         }
-
-        if (0 < g_projectiles_data.player_projectiles[i].time_wait)
+        fprintf(file, "},\n        .enemy_spawn_chance_factor = {");
+        for (int type = 0; type < ENEMY_TYPE_COUNT; type++)
         {
-            g_projectiles_data.player_projectiles[i].time_wait -= g_frame_time;
-            // printf("Projectile index %d - Decreased time_wait to %f\n", i, (*projectiles)[i].time_wait);
-            continue;
+            fprintf(file, " %.2ff%s", LEVEL->enemy_spawn_chance_factor[type], type < ENEMY_TYPE_COUNT - 1 ? "," : "");
         }
+        fprintf(file, "},\n    }%s\n", i < g_levels_data.LEVEL_COUNT - 1 ? "," : "}};");
+    }
 
-        Vector2 scaled_velocity = Vector2Scale(g_projectiles_data.player_projectiles[i].velocity, g_frame_time);
-        g_projectiles_data.player_projectiles[i].position = Vector2Add(g_projectiles_data.player_projectiles[i].position, scaled_velocity);
-
-        float radius = g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius;
+    bool is_written = ferror(file) == 0;
+    fclose(file);
+    return is_written;
+}
 
-        // Check if out of bounds
-        // Left
-        if (g_projectiles_data.player_projectiles[i].position.x + radius < 0)
-        {
-            g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-        }
+int level_tuner_run(const char *path, int generation_count, int child_count, int attempt_count)
+{
+    const int LEVELS_COUNT = g_levels_data.LEVEL_COUNT;
+    const int CANDIDATES_PER_LEVEL = child_count + 1; // The parent is evaluated again with every generation's seeds
+    const int CANDIDATE_COUNT = LEVELS_COUNT * CANDIDATES_PER_LEVEL;
 
-        // Right
-        if (g_projectiles_data.player_projectiles[i].position.x - radius >= g_window.width)
-        {
-            g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-        }
+    Level_Data_t *candidates = malloc(CANDIDATE_COUNT * sizeof(*candidates));
+    int *candidate_levels = malloc(CANDIDATE_COUNT * sizeof(*candidate_levels));
+    float *win_rates = malloc(CANDIDATE_COUNT * sizeof(*win_rates));
+    float *sigmas = malloc(LEVELS_COUNT * sizeof(*sigmas));
+    float *level_win_rates = calloc(LEVELS_COUNT, sizeof(*level_win_rates));
 
-        // Top
-        if (g_projectiles_data.player_projectiles[i].position.y + radius < 0)
-        {
-            g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-        }
+    // The parents of the search, the built in table is only read
+    Level_Data_t *levels = malloc(LEVELS_COUNT * sizeof(*levels));
 
-        // Bottom
-        if (g_projectiles_data.player_projectiles[i].position.y - radius >= g_window.height)
-        {
-            g_projectiles_data.player_projectiles[i].type = PROJECTILE_TYPE_PLAYER_NONE;
-        }
+    if (candidates == NULL || candidate_levels == NULL || win_rates == NULL || sigmas == NULL || level_win_rates == NULL || levels == NULL)
+    {
+        printf("Could not allocate the tuner's candidates\n");
+        free(candidates);
+        free(candidate_levels);
+        free(win_rates);
+        free(sigmas);
+        free(level_win_rates);
+        free(levels);
+        return 1;
+    }
 
-        projectile_check_collision(&g_projectiles_data.player_projectiles[i]);
+    memcpy(levels, g_levels_data.levels, LEVELS_COUNT * sizeof(*levels));
+    for (int level = 0; level < LEVELS_COUNT; level++)
+    {
+        sigmas[level] = g_level_tuner.SIGMA_START;
     }
 
-    for (int i = 0; i < g_projectiles_data.enemy_projectile_count; i++)
+    int exit_code = 0;
+
+    for (int generation = 0; generation < generation_count; generation++)
     {
-        Projectile_Enemy_t *current_projectile = &g_projectiles_data.enemy_projectiles[i];
-        if (PROJECTILE_TYPE_ENEMY_NONE == current_projectile->type)
-        {
-            continue;
-        }
+        double time_start = sim_clock_seconds();
 
-        if(current_projectile->type == PROJECTILE_TYPE_ENEMY_HEAVY_SHOOTER)
+        for (int level = 0; level < LEVELS_COUNT; level++)
         {
-            for (int j = 0; j < g_projectiles_data.player_projectile_count; j++)
+            Level_Data_t *level_candidates = &candidates[level * CANDIDATES_PER_LEVEL];
+            level_candidates[0] = levels[level];
+            for (int child = 1; child < CANDIDATES_PER_LEVEL; child++)
             {
-                if(g_projectiles_data.player_projectiles[j].type != PROJECTILE_TYPE_PLAYER_BURST)
-                {
-                    continue;
-                }
+                level_tuner_mutate(&level_candidates[0], &level_candidates[child], sigmas[level]);
+            }
 
-                if(CheckCollisionCircles(current_projectile->position, g_projectiles_data.enemy_projectile_database[current_projectile->type].radius, g_projectiles_data.player_projectiles[j].position, g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[j].type].radius))
-                {
-                    current_projectile->health -= g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[j].type].damage;
-                    
-                    Explosion_t new_explosion = g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[j].type].explosion;
-                    new_explosion.position = g_projectiles_data.player_projectiles[j].position;
-                    explosion_spawn_expl(new_explosion);
-
-                    g_projectiles_data.player_projectiles[j].type = PROJECTILE_TYPE_PLAYER_NONE;
-
-                    if(current_projectile->health <= 0)
-                    {
-                        current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
-                    }
-                }
+            for (int candidate = 0; candidate < CANDIDATES_PER_LEVEL; candidate++)
+            {
+                candidate_levels[level * CANDIDATES_PER_LEVEL + candidate] = level;
             }
         }
 
-        // printf("Enemy projectile index %d has velocity (%f, %f) and position (%f, %f)\n", i, current_projectile->velocity.x, current_projectile->velocity.y, current_projectile->position.x, current_projectile->position.y);
-
-        current_projectile->position = Vector2Add(current_projectile->position, Vector2Scale(current_projectile->velocity, g_frame_time));
-
-        float radius = g_projectiles_data.enemy_projectile_database[current_projectile->type].radius;
-
-        // Check if out of bounds
-        // Left
-        if (current_projectile->position.x + radius < 0)
+        if (!level_tuner_evaluate(candidates, candidate_levels, CANDIDATE_COUNT, attempt_count, generation, win_rates))
         {
-            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
+            printf("A tuner worker failed in generation %d\n", generation + 1);
+            exit_code = 1;
+            break;
         }
 
-        // Right
-        if (current_projectile->position.x - radius >= g_window.width)
+        // Keep the closest child if it beats the parent, widening the search on success and narrowing it on failure
+        float error_total = 0;
+        for (int level = 0; level < LEVELS_COUNT; level++)
         {
-            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
-        }
+            const float TARGET = level_tuner_get_target_win_rate(level);
+            const float *LEVEL_WIN_RATES = &win_rates[level * CANDIDATES_PER_LEVEL];
 
-        // Top
-        if (current_projectile->position.y + radius < 0)
-        {
-            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
-        }
+            int best = 0;
+            for (int candidate = 1; candidate < CANDIDATES_PER_LEVEL; candidate++)
+            {
+                if (fabsf(LEVEL_WIN_RATES[candidate] - TARGET) < fabsf(LEVEL_WIN_RATES[best] - TARGET))
+                {
+                    best = candidate;
+                }
+            }
 
-        // Bottom
-        if (current_projectile->position.y - radius >= g_window.height)
-        {
-            current_projectile->type = PROJECTILE_TYPE_ENEMY_NONE;
-        }
+            if (best > 0)
+            {
+                levels[level] = candidates[level * CANDIDATES_PER_LEVEL + best];
+                sigmas[level] = fminf(sigmas[level] * 1.5f, g_level_tuner.SIGMA_MAX);
+            }
+            else
+            {
+                sigmas[level] = fmaxf(sigmas[level] * 0.82f, g_level_tuner.SIGMA_MIN);
+            }
 
-        if (CheckCollisionCircles(current_projectile->position, g_projectiles_data.enemy_projectile_database[current_projectile->type].radius, g_player_data.center, g_player_data.hitbox_radius))
-        {
-            g_player_data.player_current_health -= g_projectiles_data.enemy_projectile_database[current_projectile->type].damage;
-            g_projectiles_data.enemy_projectiles[i].type = PROJECTILE_TYPE_ENEMY_NONE;
+            level_win_rates[level] = LEVEL_WIN_RATES[best];
+            error_total += fabsf(LEVEL_WIN_RATES[best] - TARGET);
         }
+
+        double time_generation = sim_clock_seconds() - time_start;
+        printf("Generation %d: mean win rate error %.3f, %d attempts in %.1f s (%.0f per second)\n",
+               generation + 1, error_total / LEVELS_COUNT, CANDIDATE_COUNT * attempt_count, time_generation, CANDIDATE_COUNT * attempt_count / time_generation);
     }
-}
 
-void projectiles_draw()
-{
-    for (int i = 0; i < g_projectiles_data.player_projectile_count; i++)
+    for (int level = 0; level < LEVELS_COUNT && exit_code == 0; level++)
     {
-        if (PROJECTILE_TYPE_PLAYER_NONE == g_projectiles_data.player_projectiles[i].type)
-        {
-            continue;
-        }
-
-        if (0 < g_projectiles_data.player_projectiles[i].time_wait)
-        {
-            continue;
-        }
-
-        // DrawCircle(
-        //     (*PROJECTILES)[i].position.x,
-        //     (*PROJECTILES)[i].position.y,
-        //     PROJECTILE_DB[(*PROJECTILES)[i].type].radius,
-        //     PROJECTILE_DB[(*PROJECTILES)[i].type].color);
+        printf("Level %d: win rate %.2f, target %.2f\n", level + 1, level_win_rates[level], level_tuner_get_target_win_rate(level));
+    }
 
-        switch (g_projectiles_data.player_projectiles[i].type)
-        {
-        case PROJECTILE_TYPE_PLAYER_NONE:
-        {
-            continue;
-        }
-        break;
+    if (exit_code == 0 && level_tuner_write_table(path, levels))
+    {
+        printf("Wrote the tuned levels to %s\n", path);
+    }
+    else
+    {
+        exit_code = 1;
+    }
 
-        case PROJECTILE_TYPE_PLAYER_BURST:
-        {
-            Vector2 start_point_direction = Vector2Scale(Vector2Normalize(g_projectiles_data.player_projectiles[i].velocity), g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius);
+    free(candidates);
+    free(candidate_levels);
+    free(win_rates);
+    free(sigmas);
+    free(level_win_rates);
+    free(levels);
 
-            Vector2 start_point = Vector2Add(g_projectiles_data.player_projectiles[i].position, start_point_direction);
-            Vector2 end_point = Vector2Add(g_projectiles_data.player_projectiles[i].position, Vector2Scale(start_point_direction, -1));
+    return exit_code;
+}
 
-            DrawLineEx(start_point, end_point, 4, WHITE);
-        }
-        break;
+// Plays a few attempts of a level with a policy and the tuner's loadout, for a realistic simulation load
+int player_policy_benchmark(Game_t *game, Player_Policy_e policy, int level)
+{
+    enum
+    {
+        ATTEMPTS = 4
+    };
 
-        case PROJECTILE_TYPE_PLAYER_CANNON:
-        {
-            Vector2 first_point_direction = Vector2Scale(Vector2Normalize(g_projectiles_data.player_projectiles[i].velocity), g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius);
+    game->player_policy = policy;
 
-            Vector2 point_1 = Vector2Add(g_projectiles_data.player_projectiles[i].position, first_point_direction);
-            Vector2 point_2 = Vector2Add(g_projectiles_data.player_projectiles[i].position, Vector2Rotate(first_point_direction, 240 * DEG2RAD));
-            Vector2 point_3 = Vector2Add(g_projectiles_data.player_projectiles[i].position, Vector2Rotate(first_point_direction, 120 * DEG2RAD));
+    int won = 0;
+    for (int attempt = 0; attempt < ATTEMPTS; attempt++)
+    {
+        double time_start = sim_clock_seconds();
+        bool is_won = level_tuner_play_attempt(game, level, attempt + 1);
+        double time_attempt = sim_clock_seconds() - time_start;
 
-            DrawTriangle(point_1, point_2, point_3, WHITE);
-        }
-        break;
+        int ticks = roundf(game->enemies_data.time_elapsed * g_sim_thread.TICK_RATE);
+        printf("Attempt %d: %s after %d ticks, %.2f us per tick\n", attempt + 1, is_won ? "won" : "lost", ticks, time_attempt / fmax(ticks, 1) * 1e6);
+        won += is_won;
+    }
 
-        case PROJECTILE_TYPE_PLAYER_AUTOCANNON:
-        {
-            Vector2 first_point_direction = Vector2Scale(Vector2Normalize(g_projectiles_data.player_projectiles[i].velocity), g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius);
+    printf("Policy %s won %d of %d attempts of level %d\n", g_player_policy.NAMES[policy], won, ATTEMPTS, level + 1);
+    return 0;
+}
 
-            Vector2 point_1 = Vector2Add(g_projectiles_data.player_projectiles[i].position, first_point_direction);
-            Vector2 point_2 = Vector2Add(g_projectiles_data.player_projectiles[i].position, Vector2Rotate(first_point_direction, 240 * DEG2RAD));
-            Vector2 point_3 = Vector2Add(g_projectiles_data.player_projectiles[i].position, Vector2Rotate(first_point_direction, 120 * DEG2RAD));
+// Plays the same attempts on one thread and then on thread_count threads with a game each, both runs must agree
+int games_benchmark_threads(int thread_count, int level, int attempt_count)
+{
+    Game_Attempt_t *attempts = calloc(attempt_count, sizeof(Game_Attempt_t));
+    bool *wins_single = calloc(attempt_count, sizeof(bool));
+    bool *wins_threaded = calloc(attempt_count, sizeof(bool));
+    if (attempts == NULL || wins_single == NULL || wins_threaded == NULL)
+    {
+        printf("Could not allocate %d attempts\n", attempt_count);
+        free(attempts);
+        free(wins_single);
+        free(wins_threaded);
+        return 1;
+    }
 
-            DrawTriangle(point_1, point_2, point_3, WHITE);
-        }
-        break;
+    for (int attempt = 0; attempt < attempt_count; attempt++)
+    {
+        attempts[attempt] = (Game_Attempt_t){.level = level, .seed = attempt + 1};
+    }
 
-        case PROJECTILE_TYPE_PLAYER_TORPEDO:
-        {
-            Vector2 rectangle_position_direction = Vector2Scale(Vector2Normalize(g_projectiles_data.player_projectiles[i].velocity), g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius);
-            Vector2 rectangle_position = Vector2Rotate(rectangle_position_direction, -30 * DEG2RAD);
-            rectangle_position = Vector2Add(rectangle_position, g_projectiles_data.player_projectiles[i].position);
+    long long ticks_single = 0;
+    long long ticks_threaded = 0;
+    double time_single = games_run_workers(1, attempts, attempt_count, wins_single, &ticks_single);
+    double time_threaded = games_run_workers(thread_count, attempts, attempt_count, wins_threaded, &ticks_threaded);
 
-            DrawRectanglePro(
-                (Rectangle){.width = cos(240 * DEG2RAD) * 2 * g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius,
-                            .height = sin(240 * DEG2RAD) * 2 * g_projectiles_data.player_projectile_database[g_projectiles_data.player_projectiles[i].type].radius,
-                            .x = rectangle_position.x,
-                            .y = rectangle_position.y},
-                (Vector2){.x = 0, .y = 0},
-                Vector2Angle((Vector2){.x = 0, .y = 1}, Vector2Normalize(g_projectiles_data.player_projectiles[i].velocity)) * RAD2DEG,
-                WHITE);
-        }
-        break;
+    bool is_matching = ticks_single == ticks_threaded && memcmp(wins_single, wins_threaded, attempt_count * sizeof(bool)) == 0;
 
-        default:
-            DrawCircle(g_projectiles_data.player_projectiles[i].position.x, g_projectiles_data.player_projectiles[i].position.y, 50, PURPLE);
-            break;
-        }
+    int won = 0;
+    for (int attempt = 0; attempt < attempt_count; attempt++)
+    {
+        won += wins_single[attempt];
     }
 
-    for (int i = 0; i < g_projectiles_data.enemy_projectile_count; i++)
+    free(attempts);
+    free(wins_single);
+    free(wins_threaded);
+
+    if (time_single < 0 || time_threaded < 0)
     {
-        Projectile_Enemy_t *current_projectile = &g_projectiles_data.enemy_projectiles[i];
+        return 1;
+    }
+
+    printf("%d attempts of level %d, %d won, %lld ticks\n", attempt_count, level + 1, won, ticks_single);
+    printf("1 thread: %.2f s, %.0f ticks per second\n", time_single, ticks_single / time_single);
+    printf("%d threads: %.2f s, %.0f ticks per second, %.2fx\n", thread_count, time_threaded, ticks_threaded / time_threaded, time_single / time_threaded);
+    printf("Threaded results %s\n", is_matching ? "match" : "DIFFER");
+
+    return is_matching ? 0 : 1;
+}
 
-        if (current_projectile->type == PROJECTILE_TYPE_ENEMY_NONE)
+// Copies the slots of a pool that are occupied in either game, in spans of up to 64 slots.
+// Every other slot is empty in both games and an empty slot is overwritten whole when it is taken, so it is skipped
+void game_fork_pool(unsigned char *fork_slots, const unsigned char *SOURCE_SLOTS, Pool_Occupancy_t *fork_pool, const Pool_Occupancy_t *SOURCE_POOL, int slot_size)
+{
+    for (int word = 0; word < POOL_WORDS_COUNT; word++)
+    {
+        unsigned long long bits = fork_pool->words[word] | SOURCE_POOL->words[word];
+        if (bits == 0)
         {
             continue;
         }
 
-        switch (current_projectile->type)
-        {
-        case PROJECTILE_TYPE_ENEMY_SHOOTER:
-        {
-            DrawCircle(current_projectile->position.x, current_projectile->position.y, g_projectiles_data.enemy_projectile_database[current_projectile->type].radius, RED);
-        }
-        break;
+        int slot_first = word * 64 + __builtin_ctzll(bits);
+        int slot_last = word * 64 + 63 - __builtin_clzll(bits);
+        memcpy(fork_slots + slot_first * slot_size, SOURCE_SLOTS + slot_first * slot_size, (slot_last - slot_first + 1) * slot_size);
+    }
 
-        case PROJECTILE_TYPE_ENEMY_HEAVY_SHOOTER:
-        {
-            Vector2 rectangle_position_direction = Vector2Scale(Vector2Normalize(current_projectile->velocity), g_projectiles_data.enemy_projectile_database[current_projectile->type].radius);
-            Vector2 rectangle_position = Vector2Rotate(rectangle_position_direction, -30 * DEG2RAD);
-            rectangle_position = Vector2Add(rectangle_position, current_projectile->position);
+    *fork_pool = *SOURCE_POOL;
+}
 
-            DrawRectanglePro(
-                (Rectangle){.width = cos(240 * DEG2RAD) * 2 * g_projectiles_data.enemy_projectile_database[current_projectile->type].radius,
-                            .height = sin(240 * DEG2RAD) * 2 * g_projectiles_data.enemy_projectile_database[current_projectile->type].radius,
-                            .x = rectangle_position.x,
-                            .y = rectangle_position.y},
-                (Vector2){.x = 0, .y = 0},
-                Vector2Angle((Vector2){.x = 0, .y = 1}, Vector2Normalize(current_projectile->velocity)) * RAD2DEG,
-                PURPLE);
-        }
-        break;
+// Makes fork play on exactly like SOURCE, for lookahead rollouts. The fork is reused between calls and only what it
+// can differ in is copied: the live spans of the entity pools, the queued impacts and the small structs.
+// The particles and stars are not copied as a fork never draws, and the spawn schedule only when the level or seed differs
+void game_fork(Game_t *fork, const Game_t *SOURCE)
+{
+    fork->frame_time = SOURCE->frame_time;
+    fork->transition_time = SOURCE->transition_time;
+    fork->transition_duration = SOURCE->transition_duration;
+    fork->transition_progress = SOURCE->transition_progress;
+    fork->gamestate_previous = SOURCE->gamestate_previous;
+    fork->gamestate_current = SOURCE->gamestate_current;
+    fork->sim_input = SOURCE->sim_input;
+    fork->rng = SOURCE->rng;
+    fork->telemetry_counters = SOURCE->telemetry_counters;
+    fork->player_policy = SOURCE->player_policy;
+    fork->recorders = NULL;
+    fork->is_unseen = true;
+
+    memcpy(&fork->weapons_data, &SOURCE->weapons_data, sizeof(fork->weapons_data));
+    memcpy(&fork->player_data, &SOURCE->player_data, sizeof(fork->player_data));
+    memcpy(&fork->enemy_spawn_director, &SOURCE->enemy_spawn_director, sizeof(fork->enemy_spawn_director));
+
+    Enemies_Data_t *enemies = &fork->enemies_data;
+    const Enemies_Data_t *SOURCE_ENEMIES = &SOURCE->enemies_data;
+    game_fork_pool((unsigned char *)enemies->enemies, (const unsigned char *)SOURCE_ENEMIES->enemies, &enemies->occupancy, &SOURCE_ENEMIES->occupancy, sizeof(Enemy_t));
+    enemies->tallest_enemy_height = SOURCE_ENEMIES->tallest_enemy_height;
+    enemies->time_elapsed = SOURCE_ENEMIES->time_elapsed;
+    enemies->active_count = SOURCE_ENEMIES->active_count;
+    enemies->dormant_count = SOURCE_ENEMIES->dormant_count;
+    memcpy(enemies->active_indices, SOURCE_ENEMIES->active_indices, SOURCE_ENEMIES->active_count);
+    memcpy(enemies->dormant_indices, SOURCE_ENEMIES->dormant_indices, SOURCE_ENEMIES->dormant_count);
+
+    Projectiles_Data_t *projectiles = &fork->projectiles_data;
+    const Projectiles_Data_t *SOURCE_PROJECTILES = &SOURCE->projectiles_data;
+    game_fork_pool((unsigned char *)projectiles->player_projectiles, (const unsigned char *)SOURCE_PROJECTILES->player_projectiles, &projectiles->player_occupancy, &SOURCE_PROJECTILES->player_occupancy, sizeof(Projectile_Player_t));
+    game_fork_pool((unsigned char *)projectiles->enemy_projectiles, (const unsigned char *)SOURCE_PROJECTILES->enemy_projectiles, &projectiles->enemy_occupancy, &SOURCE_PROJECTILES->enemy_occupancy, sizeof(Projectile_Enemy_t));
+    memcpy(projectiles->player_projectile_damage, SOURCE_PROJECTILES->player_projectile_damage, sizeof(projectiles->player_projectile_damage));
+
+    // Stale events may still name empty slots, so the per projectile arrays are copied whole for their generations to match
+    Impact_Schedule_t *impacts = &fork->impact_schedule;
+    const Impact_Schedule_t *SOURCE_IMPACTS = &SOURCE->impact_schedule;
+    memcpy(impacts->impact_times, SOURCE_IMPACTS->impact_times, sizeof(impacts->impact_times));
+    memcpy(impacts->impact_enemies, SOURCE_IMPACTS->impact_enemies, sizeof(impacts->impact_enemies));
+    memcpy(impacts->generations, SOURCE_IMPACTS->generations, sizeof(impacts->generations));
+    memcpy(impacts->events, SOURCE_IMPACTS->events, SOURCE_IMPACTS->event_count * sizeof(Impact_Event_t));
+    impacts->event_count = SOURCE_IMPACTS->event_count;
+
+    Spawn_Schedule_t *schedule = &fork->spawn_schedule;
+    const Spawn_Schedule_t *SOURCE_SCHEDULE = &SOURCE->spawn_schedule;
+    if (!schedule->is_compiled || fork->levels != SOURCE->levels || schedule->level != SOURCE_SCHEDULE->level || schedule->seed != SOURCE_SCHEDULE->seed)
+    {
+        memcpy(schedule->entries, SOURCE_SCHEDULE->entries, SOURCE_SCHEDULE->entry_count * sizeof(Spawn_Entry_t));
+    }
+    schedule->entry_count = SOURCE_SCHEDULE->entry_count;
+    schedule->entry_next = SOURCE_SCHEDULE->entry_next;
+    schedule->is_compiled = SOURCE_SCHEDULE->is_compiled;
+    schedule->level = SOURCE_SCHEDULE->level;
+    schedule->seed = SOURCE_SCHEDULE->seed;
+    fork->levels = SOURCE->levels;
+}
 
-        default:
-            DrawCircle(current_projectile->position.x, current_projectile->position.y, 50, PURPLE);
-            break;
+// Plays a fork forward at the tick rate, it takes the action on the first tick and keeps aiming after.
+// Returns the ticks played, fewer if the level ended
+int game_rollout(Game_t *fork, const Player_Policy_Action_t *ACTION, int tick_count)
+{
+    fork->frame_time = 1.0f / g_sim_thread.TICK_RATE;
+
+    int tick = 0;
+    for (; tick < tick_count && sim_level_is_running(fork); tick++)
+    {
+        fork->sim_input = (Sim_Input_t){.time_scale = 1, .mouse_position = ACTION->aim_position};
+        if (tick == 0)
+        {
+            memcpy(fork->sim_input.weapons_fired, ACTION->weapons_fired, sizeof(fork->sim_input.weapons_fired));
         }
+
+        level_update(fork);
     }
+
+    return tick;
 }
 
-void money_draw_ingame()
+// Previews an action, the money its kills would bring in over the next ticks
+int game_preview_action(Game_t *fork, const Game_t *SOURCE, const Player_Policy_Action_t *ACTION, int tick_count)
 {
-    DrawText(TextFormat("$%d", g_player_data.money + g_player_data.transaction_money_remaining), 10, 20, 40, SKYBLUE);
+    game_fork(fork, SOURCE);
+    game_rollout(fork, ACTION, tick_count);
+
+    return fork->player_data.money + fork->player_data.transaction_money_remaining - (SOURCE->player_data.money + SOURCE->player_data.transaction_money_remaining);
 }
 
-void weapons_update()
+// Plays a level with the tuner's policy and every few ticks previews firing each weapon at what the policy aims at.
+// A reused fork must end every rollout exactly like a full copy of the game does
+int game_fork_benchmark(int level)
 {
-    for (unsigned char i = 0; i < WEAPON_TYPE_COUNT; i++)
+    enum
     {
-        Weapon_t *current_weapon = &g_weapons_data.weapons[i];
+        PREVIEW_INTERVAL = 30,
+        ROLLOUT_TICKS = 60
+    };
+
+    Game_t *game = game_create();
+    Game_t *fork = game_create();
+    Game_t *copy = game_create();
+    if (game == NULL || fork == NULL || copy == NULL)
+    {
+        free(game);
+        free(fork);
+        free(copy);
+        return 1;
+    }
 
-        if (!current_weapon->is_unlocked)
-        {
-            continue;
-        }
+    game->player_policy = g_level_tuner.POLICY;
+    level_start_headless(game, level, 1);
 
-        g_weapons_data.symbol_alert_timers[i] += g_frame_time;
+    int preview_count = 0;
+    int mismatch_count = 0;
+    int money_previewed = 0;
+    double time_fork = 0;
+    double time_copy = 0;
+    double time_rollout = 0;
 
-        if (!(current_weapon->ammo_count >= current_weapon->ammo_count_max))
+    int ticks_max = g_level_tuner.SECONDS_MAX * g_sim_thread.TICK_RATE;
+    for (int tick = 0; tick < ticks_max && sim_level_is_running(game); tick++)
+    {
+        if (tick % PREVIEW_INTERVAL == 0)
         {
-            current_weapon->time_last_reload += g_frame_time;
-        }
+            Player_Policy_View_t view;
+            Player_Policy_Action_t aim = {0};
+            player_policy_view_live(game, &view);
+            player_policy_decide(game, g_level_tuner.POLICY, &view, &aim);
 
-        if (current_weapon->time_last_reload >= current_weapon->time_ammo_reload)
-        {
-            current_weapon->time_last_reload -= current_weapon->time_ammo_reload;
-            current_weapon->ammo_count++;
-            g_weapons_data.symbol_alert_timers[current_weapon->type] = 0;
-        }
+            for (int weapon = 0; weapon < WEAPON_TYPE_COUNT; weapon++)
+            {
+                if (!game->weapons_data.weapons[weapon].is_unlocked)
+                {
+                    continue;
+                }
 
-        if (!IsKeyPressed(current_weapon->firing_key))
-        {
-            continue;
+                Player_Policy_Action_t action = {.aim_position = aim.aim_position};
+                action.weapons_fired[weapon] = true;
+
+                double time_start = sim_clock_seconds();
+                game_fork(fork, game);
+                double time_forked = sim_clock_seconds();
+                game_rollout(fork, &action, ROLLOUT_TICKS);
+                double time_rolled = sim_clock_seconds();
+
+                memcpy(copy, game, sizeof(Game_t));
+                double time_copied = sim_clock_seconds();
+                copy->is_unseen = true;
+                game_rollout(copy, &action, ROLLOUT_TICKS);
+
+                time_fork += time_forked - time_start;
+                time_rollout += time_rolled - time_forked;
+                time_copy += time_copied - time_rolled;
+                mismatch_count += sim_state_checksum(fork) != sim_state_checksum(copy);
+                money_previewed += game_preview_action(fork, game, &action, ROLLOUT_TICKS);
+                preview_count++;
+            }
         }
 
-        if (current_weapon->ammo_count <= 0)
-        {
-            continue;
-        }
+        game->sim_input = (Sim_Input_t){.time_scale = 1};
+        level_tick(game);
+    }
 
-        current_weapon->ammo_count--;
+    printf("Level %d: %d previews of %d ticks, %s\n", level + 1, preview_count, ROLLOUT_TICKS, game->gamestate_current == STATE_UPGRADE ? "won" : "lost");
+    printf("Fork %.2f us, full copy %.2f us, rollout %.2f us\n", time_fork / fmax(preview_count, 1) * 1e6, time_copy / fmax(preview_count, 1) * 1e6, time_rollout / fmax(preview_count, 1) * 1e6);
+    printf("%d money previewed, %d rollouts differ from a full copy\n", money_previewed, mismatch_count);
 
-        for (int j = 0; j < current_weapon->projectile_count; j++)
-        {
-            projectile_player_spawn(i, current_weapon->time_projectile_interval * j);
-        }
-    }
+    free(game);
+    free(fork);
+    free(copy);
+    return mismatch_count == 0 ? 0 : 1;
 }
 
-void game_over_screen(bool disable_buttons)
+// Times the real enemy and projectile updates on the entities of a level as it is played, per live entity. Every
+// sample forks the game and updates the fork, so the level itself plays on untouched
+int entity_update_benchmark(int level)
 {
-    DrawText("GAME OVER", g_window.width / 2 - MeasureText("GAME OVER", 40) / 2, 200, 40, RED);
-    DrawText("Try again?", g_window.width / 2 - MeasureText("Try again?", 30) / 2, 275, 30, RED);
-
-    if (create_button_text_border(
-            disable_buttons,
-            g_window.width * (1 / 3.0f), g_window.height * 0.65f,
-            110, 70,
-            SKYBLUE, true, SKYBLUE_LIGHT,
-            "No", 35, BLACK, 1,
-            8, BLUE))
+    enum
     {
-        g_gamestate_previous = g_gamestate_current;
-        g_gamestate_current = STATE_UPGRADE;
-
-        g_transition_time = 0;
-        g_transition_duration = 2;
-    }
-
-    if (create_button_text_border(
-            disable_buttons,
-            g_window.width * (2 / 3.0f), g_window.height * 0.65f,
-            110, 70,
-            SKYBLUE, true, SKYBLUE_LIGHT,
-            "Yes", 35, BLACK, 1,
-            8, BLUE))
+        SAMPLE_INTERVAL = 30,
+        SAMPLE_TICKS = 60,
+        SAMPLE_REPEATS = 20
+    };
+
+    Game_t *game = game_create();
+    Game_t *fork = game_create();
+    if (game == NULL || fork == NULL)
     {
-        g_gamestate_previous = g_gamestate_current;
-        g_gamestate_current = STATE_LEVEL;
-        enemy_spawn_director_init_level(g_enemy_spawn_director.current_level);
-
-        g_transition_time = 0;
-        g_transition_duration = 4;
+        free(game);
+        free(fork);
+        return 1;
     }
-}
 
-void draw_state_selection_buttons(bool disable_buttons)
-{
-    short width = 50;
-    short height = 50;
+    game->player_policy = g_level_tuner.POLICY;
+    level_start_headless(game, level, 1);
 
-    Gamestate_e destinations[3] = {STATE_LEVEL_SELECTION, STATE_MAIN_MENU, STATE_UPGRADE};
+    long long enemy_updates = 0;
+    long long projectile_updates = 0;
+    double time_enemies = 0;
+    double time_projectiles = 0;
 
-    for (unsigned char i = 0; i < 3; i++)
+    int ticks_max = g_level_tuner.SECONDS_MAX * g_sim_thread.TICK_RATE;
+    for (int tick = 0; tick < ticks_max && sim_level_is_running(game); tick++)
     {
-        Color color = SKYBLUE;
-
-        int x = g_window.width / 2 + 120 * (i - 1);
-        int y = g_window.height * 0.9f;
-
-        if (g_gamestate_current == destinations[i])
+        for (int repeat = 0; tick % SAMPLE_INTERVAL == 0 && repeat < SAMPLE_REPEATS; repeat++)
         {
-            color.b = 200;
-            color.r = 200;
-
-            create_button_border(
-                disable_buttons,
-                x, y, width + 10, height + 10, color, false, SKYBLUE_LIGHT,
-                5, BLUE);
+            game_fork(fork, game);
 
-            continue;
-        }
+            for (int i = 0; i < SAMPLE_TICKS; i++)
+            {
+                enemy_updates += fork->enemies_data.active_count;
+                projectile_updates += fork->projectiles_data.player_occupancy.live_count + fork->projectiles_data.enemy_occupancy.live_count;
 
-        if (create_button_border(
-                disable_buttons,
-                x, y, width, height, color, !disable_buttons, SKYBLUE_LIGHT,
-                5, BLUE))
-        {
-            g_transition_duration = 0.5f;
-            g_transition_time = 0;
+                double time_start = sim_clock_seconds();
+                enemies_update(fork);
+                double time_enemies_done = sim_clock_seconds();
+                projectiles_update(fork);
 
-            g_gamestate_previous = g_gamestate_current;
-            g_gamestate_current = destinations[i];
+                time_enemies += time_enemies_done - time_start;
+                time_projectiles += sim_clock_seconds() - time_enemies_done;
+            }
         }
+
+        game->sim_input = (Sim_Input_t){.time_scale = 1};
+        level_tick(game);
     }
-}
 
-void level_selector_update(bool disable_buttons, int offset)
-{
-    DrawText("Choose a Level:", g_window.width / 2 - MeasureText("Choose a Level:", 40) / 2 + offset, g_window.height * 0.12f, 40, SKYBLUE);
+    printf("Bytes per entity: enemy %zu, player projectile %zu, enemy projectile %zu\n", sizeof(Enemy_t), sizeof(Projectile_Player_t), sizeof(Projectile_Enemy_t));
+    printf("Level %d: %lld enemy and %lld projectile updates sampled\n", level + 1, enemy_updates, projectile_updates);
+    printf("enemies_update: %.2f ns per active enemy\n", time_enemies / fmax(enemy_updates, 1) * 1e9);
+    printf("projectiles_update: %.2f ns per live projectile\n", time_projectiles / fmax(projectile_updates, 1) * 1e9);
 
-    float width_percent = 0.6f;
-    float height_percent = 0.5f;
+    // A level rarely has more than a few dozen enemies alive, so the updates are also timed with every pool full, on
+    // enough forks to update about 10k live entities per tick
+    enum
+    {
+        FULL_GAMES = 13,
+        FULL_TICKS = 60
+    };
 
-    Rectangle background = {.x = g_window.width * 0.2f + offset, .y = g_window.height * 0.3f, .width = g_window.width * width_percent, .height = g_window.height * height_percent};
+    level_start_headless(game, level, 1);
 
-    int rows = 5;
-    int columns = 6;
+    for (int i = 0; i < game->enemies_data.ENEMIES_COUNT; i++)
+    {
+        game->enemies_data.enemies[i] = (Enemy_t){.type = ENEMY_TYPE_LIGHT + i % (ENEMY_TYPE_COUNT - 1), .current_health = 30000, .spawn_position = {.x = i * 37 % (g_window.width - 40), .y = i % 16 * 25}};
+    }
 
-    float button_width = g_window.width * width_percent / (columns + 1) * 0.8f;
-    float button_height = g_window.height * height_percent / (rows + 1) * 0.8f;
+    for (int i = 0; i < game->projectiles_data.player_projectile_count; i++)
+    {
+        Vector2 position = {.x = i * 13 % g_window.width, .y = g_window.height - i % 32 * 10};
+        game->projectiles_data.player_projectiles[i] = (Projectile_Player_t){.type = PROJECTILE_TYPE_PLAYER_BURST, .position = position, .velocity = {.x = 0, .y = -200}, .launch_position = position, .flags = PROJECTILE_FLAG_IS_LAUNCHED};
+    }
+
+    for (int i = 0; i < game->projectiles_data.enemy_projectile_count; i++)
+    {
+        game->projectiles_data.enemy_projectiles[i] = (Projectile_Enemy_t){.type = PROJECTILE_TYPE_ENEMY_SHOOTER, .position = {.x = i * 29 % g_window.width, .y = i % 8 * 25}, .velocity = {.x = 0, .y = 60}, .health = 1};
+    }
 
-    DrawRectangleRec(background, ORANGE);
-    DrawRectangleLinesEx(background, 10, BROWN);
+    enemies_rebuild_lists(game);
+    projectiles_rebuild_occupancy(game);
+    impacts_rebuild(game);
 
-    int row_num = 0;
-    for (int i = 0; i < g_levels_data.LEVEL_COUNT; i++)
+    Game_t *full_games = calloc(FULL_GAMES, sizeof(Game_t));
+    if (full_games == NULL)
+    {
+        printf("Could not allocate %d games\n", FULL_GAMES);
+        free(game);
+        free(fork);
+        return 1;
+    }
+
+    for (int i = 0; i < FULL_GAMES; i++)
     {
-        Color button_color = SKYBLUE;
-        bool can_hover = true;
+        game_prepare(&full_games[i]);
+    }
 
-        if (i > g_enemy_spawn_director.next_level)
+    long long full_entities = 0;
+    double time_full_enemies = 0;
+    double time_full_projectiles = 0;
+
+    for (int repeat = 0; repeat < SAMPLE_REPEATS; repeat++)
+    {
+        for (int i = 0; i < FULL_GAMES; i++)
         {
-            can_hover = false;
-            button_color = GRAY;
+            game_fork(&full_games[i], game);
         }
 
-        row_num = (floor(i / (float)columns)) + 1;
-
-        if (create_button_text_border(
-                disable_buttons,
-                background.x + g_window.width * (width_percent / (columns + 1)) * ((i + 1) - (row_num - 1) * columns),
-                background.y + g_window.height * (height_percent / (rows + 1)) * row_num,
-                button_width,
-                button_height,
-                button_color, can_hover, SKYBLUE_LIGHT,
-                TextFormat("%d", i + 1), 15, BLACK, 3,
-                3, DARKBLUE))
+        for (int tick = 0; tick < FULL_TICKS; tick++)
         {
-            if (i > g_enemy_spawn_director.next_level)
+            for (int i = 0; i < FULL_GAMES; i++)
             {
-                continue;
+                full_entities += full_games[i].enemies_data.active_count + full_games[i].projectiles_data.player_occupancy.live_count + full_games[i].projectiles_data.enemy_occupancy.live_count;
             }
 
-            g_transition_time = 0;
-            g_transition_duration = 4;
+            double time_start = sim_clock_seconds();
+            for (int i = 0; i < FULL_GAMES; i++)
+            {
+                enemies_update(&full_games[i]);
+            }
+            double time_enemies_done = sim_clock_seconds();
+            for (int i = 0; i < FULL_GAMES; i++)
+            {
+                projectiles_update(&full_games[i]);
+            }
 
-            g_gamestate_previous = STATE_LEVEL_SELECTION;
-            enemy_spawn_director_init_level(i);
+            time_full_enemies += time_enemies_done - time_start;
+            time_full_projectiles += sim_clock_seconds() - time_enemies_done;
         }
     }
+
+    int full_ticks = SAMPLE_REPEATS * FULL_TICKS;
+    printf("Full pools: %.0f live entities per tick on %d games\n", full_entities / (double)full_ticks, FULL_GAMES);
+    printf("enemies_update: %.2f us per tick, projectiles_update: %.2f us per tick\n", time_full_enemies / full_ticks * 1e6, time_full_projectiles / full_ticks * 1e6);
+
+    free(full_games);
+    free(game);
+    free(fork);
+    return 0;
 }
 
-void upgrade_menu_update(bool disable_buttons, int offset)
+// Layout of an environment observation, every value is roughly within -1 to 1
+enum
 {
-    DrawText("Upgrades:", g_window.width / 2 - MeasureText("Upgrades:", 40) / 2 + offset, g_window.height * 0.08f, 40, SKYBLUE);
-    DrawText(TextFormat("$%d", g_player_data.money + g_player_data.transaction_money_remaining), g_window.width / 2 - MeasureText(TextFormat("$%d", g_player_data.money + g_player_data.transaction_money_remaining), 35) / 2 + offset, g_window.height * 0.08f + 50, 35, SKYBLUE);
+    ENV_OBSERVED_ENEMIES = 16,     // The enemies closest to the station
+    ENV_OBSERVED_PROJECTILES = 16, // The enemy projectiles closest to the station
+    ENV_ENEMY_FEATURES = 4,        // x, y, type, health
+    ENV_PROJECTILE_FEATURES = 4,   // x, y, velocity x, velocity y
+    ENV_PLAYER_FEATURES = 2 + 3 * WEAPON_TYPE_COUNT, // Station and planet health, then unlocked, ammo and reload of every weapon
+    ENV_OBSERVATION_SIZE = ENV_PLAYER_FEATURES + ENV_OBSERVED_ENEMIES * ENV_ENEMY_FEATURES + ENV_OBSERVED_PROJECTILES * ENV_PROJECTILE_FEATURES
+};
+
+// The episode bookkeeping of one game of a batch, the game itself is g_envs.games at the same index
+typedef struct
+{
+    unsigned long long episode_seed;
+    int episode_ticks;
 
-    if (create_button_text_border(
-            disable_buttons,
-            g_window.width / 2 + offset, g_window.height * 0.75f, 260, 65, SKYBLUE, true, SKYBLUE_LIGHT,
-            "Next Level >>", 30, BLACK, 1,
-            5, BLUE))
-    {
-        g_gamestate_previous = g_gamestate_current;
-        enemy_spawn_director_init_level(g_enemy_spawn_director.next_level);
+    // Rewards are the changes of these between steps
+    int score;
+    short player_health;
+    short planet_health;
+} Env_Instance_t;
 
-        g_transition_time = 0;
-        g_transition_duration = 4;
+// Steps a contiguous block of instances, so the rows of different workers do not share cache lines
+typedef struct
+{
+    pthread_t thread;
+    int instance_first;
+    int instance_end;
+    int step_generation_seen;
+} Env_Worker_t;
+
+// A batch of independent games stepped in lockstep for reinforcement learning, every step repeats an action for a few ticks.
+// The games are never drawn, so they skip the cosmetic updates. The instances are split over worker threads that sleep between steps
+struct
+{
+    const int ACTION_REPEAT;
+    const float REWARD_PER_SCORE;  // Kills are rewarded by the money they bring in
+    const float REWARD_PER_DAMAGE; // Per point of station or planet health lost
+    const float REWARD_WIN;
+    const float REWARD_LOSS;
+
+    Game_t *games; // One block holding every instance's game back to back
+    Env_Instance_t *instances;
+    int instance_count;
+    int level;
+
+    // Written by every reset and step, one row per instance
+    float *observations;
+    float *rewards;
+    bool *dones;
+
+    // No workers means the caller steps every instance itself
+    Env_Worker_t *workers;
+    int worker_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    const Player_Policy_Action_t *actions; // Of the step the workers are running
+    int step_generation;                   // Bumped to start a step
+    int workers_stepping;
+    bool should_quit;
+} g_envs = {
+    .ACTION_REPEAT = 4,
+    .REWARD_PER_SCORE = 0.01f,
+    .REWARD_PER_DAMAGE = -0.05f,
+    .REWARD_WIN = 1,
+    .REWARD_LOSS = -1,
+
+    .games = NULL,
+    .instances = NULL,
+    .instance_count = 0,
+
+    .workers = NULL,
+    .worker_count = 0,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .condition = PTHREAD_COND_INITIALIZER};
+
+int env_get_score(Game_t *game)
+{
+    return game->player_data.money + game->player_data.transaction_money_remaining;
+}
+
+// Inserts into the list kept sorted by distance, dropping the farthest when it is full
+void env_observe_insert(int indices[], float distances[], int *count, int capacity, int index, float distance)
+{
+    if (*count == capacity && distance >= distances[capacity - 1])
+    {
+        return;
     }
 
-    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    int k = *count < capacity ? (*count)++ : capacity - 1;
+    while (k > 0 && distances[k - 1] > distance)
     {
-        g_weapons_data.upgrade_transitions[i] -= g_frame_time;
+        indices[k] = indices[k - 1];
+        distances[k] = distances[k - 1];
+        k--;
+    }
 
-        bool disable_button = disable_buttons;
-        int text_x = g_window.width * 0.5f + offset;
-        int text_y = g_window.height * 0.25f + 60 * i;
-        Color button_color = SKYBLUE;
-        Color weapon_name_color = SKYBLUE;
+    indices[k] = index;
+    distances[k] = distance;
+}
 
-        if (!g_weapons_data.weapons[i].is_unlocked)
-        {
-            weapon_name_color = (Color){.r = 30, .g = 50, .b = 75, .a = 255};
-        }
+// Positions are relative to the station and scaled by the window size, missing entities are all zeros
+void env_observe(Game_t *game, float observation[])
+{
+    memset(observation, 0, ENV_OBSERVATION_SIZE * sizeof(float));
 
-        DrawText(TextFormat("%s", g_weapons_data.names[i]), 50 + offset, text_y - 15, 25, weapon_name_color);
-        DrawText(TextFormat("$%d", g_weapons_data.upgrade_cost[i]), text_x - MeasureText(TextFormat("$%d", g_weapons_data.upgrade_cost[i]), 25) - 30, g_window.height * 0.25f + 60 * i - 15, 25, SKYBLUE);
+    const Vector2 CENTER = game->player_data.center;
+    const float SCALE = 1.0f / fmaxf(g_window.width, g_window.height);
 
-        if (g_player_data.money < g_weapons_data.upgrade_cost[i] || g_weapons_data.weapons[i].level_current >= g_weapons_data.level_max)
-        {
-            button_color = (Color){.r = 30, .g = 50, .b = 75, .a = 255};
-            disable_button = true;
-        }
+    float *features = observation;
+    *features++ = game->player_data.player_current_health / (float)game->player_data.player_max_health;
+    *features++ = game->player_data.planet_current_health / (float)game->player_data.planet_max_health;
+    for (int i = 0; i < WEAPON_TYPE_COUNT; i++)
+    {
+        const Weapon_t *WEAPON = &game->weapons_data.weapons[i];
+        *features++ = WEAPON->is_unlocked;
+        *features++ = WEAPON->ammo_count / fmaxf(WEAPON->ammo_count_max, 1);
+        *features++ = WEAPON->time_last_reload / fmaxf(WEAPON->time_ammo_reload, 1e-3f);
+    }
 
-        if (create_button_text(disable_button, text_x, text_y, 30, 40, button_color, !disable_button, SKYBLUE_LIGHT, "+", 40, BLACK, 0))
-        {
-            money_remove(g_weapons_data.upgrade_cost[i]);
+    int indices[ENV_OBSERVED_ENEMIES > ENV_OBSERVED_PROJECTILES ? ENV_OBSERVED_ENEMIES : ENV_OBSERVED_PROJECTILES];
+    float distances[ENV_OBSERVED_ENEMIES > ENV_OBSERVED_PROJECTILES ? ENV_OBSERVED_ENEMIES : ENV_OBSERVED_PROJECTILES];
+    int count = 0;
 
-            if (g_weapons_data.weapons[i].is_unlocked)
-            {
-                g_weapons_data.upgrade_cost[i] *= g_weapons_data.cost_scaling;
-                g_weapons_data.weapons[i].level_current++;
+    for (int i = pool_next(&game->enemies_data.occupancy, 0); i >= 0; i = pool_next(&game->enemies_data.occupancy, i + 1))
+    {
+        env_observe_insert(indices, distances, &count, ENV_OBSERVED_ENEMIES, i, Vector2Distance(CENTER, enemy_get_center(game->enemies_data.enemies[i], game->enemies_data.time_elapsed)));
+    }
 
-                if (g_weapons_data.upgrade_transitions[i] < 0)
-                {
-                    g_weapons_data.upgrade_transitions[i] = g_weapons_data.upgrade_transition_duration;
-                }
-                else
-                {
-                    g_weapons_data.upgrade_transitions[i] += g_weapons_data.upgrade_transition_duration;
-                }
-            }
-            else
-            {
-                g_weapons_data.weapons[i].is_unlocked = true;
-            }
-        }
+    for (int k = 0; k < count; k++)
+    {
+        const Enemy_t *ENEMY = &game->enemies_data.enemies[indices[k]];
+        Vector2 center = enemy_get_center(*ENEMY, game->enemies_data.time_elapsed);
+
+        float *enemy_features = &observation[ENV_PLAYER_FEATURES + k * ENV_ENEMY_FEATURES];
+        enemy_features[0] = (center.x - CENTER.x) * SCALE;
+        enemy_features[1] = (center.y - CENTER.y) * SCALE;
+        enemy_features[2] = ENEMY->type / (float)(ENEMY_TYPE_COUNT - 1);
+        enemy_features[3] = ENEMY->current_health / (float)g_enemy_database[ENEMY->type].max_health;
+    }
 
-        for (int j = 0; j < g_weapons_data.level_max; j++)
-        {
-            Color indicator_color_bought = SKYBLUE;
-            Color indicator_color_not_bought = (Color){.r = 30, .g = 50, .b = 75, .a = 255};
+    count = 0;
+    for (int i = pool_next(&game->projectiles_data.enemy_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.enemy_occupancy, i + 1))
+    {
+        env_observe_insert(indices, distances, &count, ENV_OBSERVED_PROJECTILES, i, Vector2Distance(CENTER, game->projectiles_data.enemy_projectiles[i].position));
+    }
 
-            int j_draw = (int)floor(g_weapons_data.upgrade_transitions[i] / g_weapons_data.upgrade_transition_duration);
+    for (int k = 0; k < count; k++)
+    {
+        const Projectile_Enemy_t *PROJECTILE = &game->projectiles_data.enemy_projectiles[indices[k]];
 
-            if (g_weapons_data.upgrade_transitions[i] > 0 && j >= g_weapons_data.weapons[i].level_current - (j_draw + 1) && j < g_weapons_data.weapons[i].level_current)
-            {
-                DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_not_bought);
+        float *projectile_features = &observation[ENV_PLAYER_FEATURES + ENV_OBSERVED_ENEMIES * ENV_ENEMY_FEATURES + k * ENV_PROJECTILE_FEATURES];
+        projectile_features[0] = (PROJECTILE->position.x - CENTER.x) * SCALE;
+        projectile_features[1] = (PROJECTILE->position.y - CENTER.y) * SCALE;
+        projectile_features[2] = PROJECTILE->velocity.x * SCALE;
+        projectile_features[3] = PROJECTILE->velocity.y * SCALE;
+    }
+}
 
-                if (j != g_weapons_data.weapons[i].level_current - 1)
-                {
-                    continue;
-                }
+// Starts a new episode of an instance
+void env_reset(int env_i)
+{
+    Env_Instance_t *instance = &g_envs.instances[env_i];
+    Game_t *game = &g_envs.games[env_i];
 
-                DrawRectangle(text_x + 40 + 25 * (j - j_draw), text_y - 20, 15 * (1 - Clamp(g_weapons_data.upgrade_transitions[i] / g_weapons_data.upgrade_transition_duration - j_draw, 0, 1)), 40, SKYBLUE);
-                continue;
-            }
+    level_start_headless(game, g_envs.level, instance->episode_seed++);
 
-            if (j < g_weapons_data.weapons[i].level_current)
-            {
-                DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_bought);
-                continue;
-            }
+    instance->episode_ticks = 0;
+    instance->score = env_get_score(game);
+    instance->player_health = game->player_data.player_current_health;
+    instance->planet_health = game->player_data.planet_current_health;
 
-            DrawRectangle(text_x + 40 + 25 * j, text_y - 20, 15, 40, indicator_color_not_bought);
-        }
-    }
+    env_observe(game, &g_envs.observations[env_i * ENV_OBSERVATION_SIZE]);
 }
 
-void main_menu_update(int offset)
+// Steps one instance with its action. A finished episode reports its last reward and done, and its observation is already from the next episode
+void env_step(int env_i, const Player_Policy_Action_t *ACTION)
 {
-    g_main_menu_data.bounce_timer += (g_frame_time * g_main_menu_data.bounce_speed);
-    if (g_main_menu_data.bounce_timer > PI)
+    Env_Instance_t *instance = &g_envs.instances[env_i];
+    Game_t *game = &g_envs.games[env_i];
+
+    game->sim_input = (Sim_Input_t){.time_scale = 1, .mouse_position = ACTION->aim_position};
+    memcpy(game->sim_input.weapons_fired, ACTION->weapons_fired, sizeof(game->sim_input.weapons_fired));
+
+    for (int tick = 0; tick < g_envs.ACTION_REPEAT && sim_level_is_running(game); tick++)
     {
-        g_main_menu_data.bounce_timer -= PI;
+        level_tick(game);
+        instance->episode_ticks++;
     }
 
-    float bounce = g_main_menu_data.bounce_distance * sin(g_main_menu_data.bounce_timer);
+    // Health is topped up when the game ends, so the damage of the last tick is not counted
+    bool is_done = !sim_level_is_running(game);
+    float reward = (env_get_score(game) - instance->score) * g_envs.REWARD_PER_SCORE;
+    if (!is_done)
+    {
+        reward += (instance->player_health - game->player_data.player_current_health + instance->planet_health - game->player_data.planet_current_health) * g_envs.REWARD_PER_DAMAGE;
+    }
+    else
+    {
+        reward += game->gamestate_current == STATE_UPGRADE ? g_envs.REWARD_WIN : g_envs.REWARD_LOSS;
+    }
 
-    DrawText("- Welcome -", g_window.width / 2 - MeasureText("- Welcome -", 40) / 2 + offset, g_window.height * 0.4f, 40, SKYBLUE);
+    g_envs.rewards[env_i] = reward;
+    g_envs.dones[env_i] = is_done;
 
-    DrawText("<-- Levels", 50 + offset + bounce, g_window.height * 0.20f, 40, SKYBLUE);
-    DrawText("Upgrades -->", g_window.width - MeasureText("Upgrades ->", 40) - 50 + offset - bounce, g_window.height * 0.6f, 40, SKYBLUE);
+    if (is_done)
+    {
+        env_reset(env_i);
+    }
+    else
+    {
+        instance->score = env_get_score(game);
+        instance->player_health = game->player_data.player_current_health;
+        instance->planet_health = game->player_data.planet_current_health;
+        env_observe(game, &g_envs.observations[env_i * ENV_OBSERVATION_SIZE]);
+    }
 }
 
-void background_update()
+void *envs_worker_main(void *argument)
 {
-    g_stars_data.twinkle_x += g_frame_time;
-    for (int i = 0; i < g_stars_data.star_count; i++)
-    {
-        Vector2 speed = g_stars_data.star_speeds[g_stars_data.stars[i].speed_index];
-        speed = Vector2Scale(speed, g_frame_time);
+    Env_Worker_t *worker = argument;
 
-        g_stars_data.stars[i].position = Vector2Add(g_stars_data.stars[i].position, speed);
+    pthread_mutex_lock(&g_envs.mutex);
+    while (true)
+    {
+        while (g_envs.step_generation == worker->step_generation_seen && !g_envs.should_quit)
+        {
+            pthread_cond_wait(&g_envs.condition, &g_envs.mutex);
+        }
 
-        if (g_stars_data.stars[i].position.x < -g_stars_data.padding_x - 10 || g_stars_data.stars[i].position.x > g_window.width + g_stars_data.padding_x + 10 || g_stars_data.stars[i].position.y > g_window.height + 10 || g_stars_data.stars[i].position.y < -10)
+        if (g_envs.should_quit)
         {
-            int chosen_position = rand_range_int(-g_stars_data.padding_x, g_window.width + g_stars_data.padding_x + g_window.height);
+            break;
+        }
 
-            if (chosen_position > g_window.width + g_stars_data.padding_x)
-            {
-                g_stars_data.stars[i].position = (Vector2){.x = g_window.width + g_stars_data.padding_x + 5, .y = chosen_position - g_window.width - g_stars_data.padding_x};
-                continue;
-            }
+        worker->step_generation_seen = g_envs.step_generation;
+        pthread_mutex_unlock(&g_envs.mutex);
 
-            g_stars_data.stars[i].position = (Vector2){.x = chosen_position, .y = -5};
-            continue;
+        for (int i = worker->instance_first; i < worker->instance_end; i++)
+        {
+            env_step(i, &g_envs.actions[i]);
         }
 
-        Color color = g_stars_data.star_colors[g_stars_data.stars[i].color_index];
-        DrawCircle(
-            g_stars_data.stars[i].position.x - (g_window.width * g_stars_data.screen_scroll),
-            g_stars_data.stars[i].position.y,
-            g_stars_data.stars[i].radius,
-            (Color){.a = 255 * ((sin((g_stars_data.twinkle_x + g_stars_data.stars[i].twinkle_offset) * g_stars_data.twinkle_speed) + 1) / 2), .r = color.r, .g = color.g, .b = color.b});
+        pthread_mutex_lock(&g_envs.mutex);
+        g_envs.workers_stepping--;
+        if (g_envs.workers_stepping == 0)
+        {
+            pthread_cond_broadcast(&g_envs.condition);
+        }
     }
+    pthread_mutex_unlock(&g_envs.mutex);
+
+    return NULL;
+}
+
+void envs_stop_workers()
+{
+    pthread_mutex_lock(&g_envs.mutex);
+    g_envs.should_quit = true;
+    pthread_cond_broadcast(&g_envs.condition);
+    pthread_mutex_unlock(&g_envs.mutex);
+
+    for (int i = 0; i < g_envs.worker_count; i++)
+    {
+        pthread_join(g_envs.workers[i].thread, NULL);
+    }
+
+    free(g_envs.workers);
+    g_envs.workers = NULL;
+    g_envs.worker_count = 0;
+    g_envs.should_quit = false;
 }
 
-void explosions_draw()
-{
-    for (int i = 0; i < g_explosions_data.EXPLOSIONS_COUNT; i++)
+// Splits the instances over worker_count threads, with fewer than two the caller steps them. Returns false if none started
+bool envs_start_workers(int worker_count)
+{
+    worker_count = worker_count < g_envs.instance_count ? worker_count : g_envs.instance_count;
+    if (worker_count < 2)
+    {
+        return true;
+    }
+
+    g_envs.workers = calloc(worker_count, sizeof(Env_Worker_t));
+    if (g_envs.workers == NULL)
+    {
+        return false;
+    }
+
+    for (; g_envs.worker_count < worker_count; g_envs.worker_count++)
     {
-        if (g_explosions_data.explosions[i].time_alive >= g_explosions_data.explosions[i].time_lifetime)
+        Env_Worker_t *worker = &g_envs.workers[g_envs.worker_count];
+        worker->instance_first = g_envs.instance_count * g_envs.worker_count / worker_count;
+        worker->instance_end = g_envs.instance_count * (g_envs.worker_count + 1) / worker_count;
+        worker->step_generation_seen = g_envs.step_generation;
+
+        if (pthread_create(&worker->thread, NULL, envs_worker_main, worker) != 0)
         {
-            continue;
+            printf("Could not start environment worker %d\n", g_envs.worker_count);
+            envs_stop_workers();
+            return false;
         }
-
-        DrawCircle(
-            g_explosions_data.explosions[i].position.x,
-            g_explosions_data.explosions[i].position.y,
-            Clamp(g_explosions_data.explosions[i].time_alive / g_explosions_data.explosions[i].time_lifetime, 0, 1) * g_explosions_data.explosions[i].size,
-            (Color){.a = (1 - Clamp(g_explosions_data.explosions[i].time_alive / g_explosions_data.explosions[i].time_lifetime, 0, 1)) * 255,
-                    .b = g_explosions_data.explosions[i].color.b,
-                    .g = g_explosions_data.explosions[i].color.g,
-                    .r = g_explosions_data.explosions[i].color.r});
     }
+
+    return true;
 }
 
-void draw_player_health()
+void envs_destroy()
 {
-    DrawText(TextFormat("Station: %d/%d", g_player_data.player_current_health, g_player_data.player_max_health), g_window.width * (1 / 3.0f) - MeasureText(TextFormat("Station: %d/%d", g_player_data.player_current_health, g_player_data.player_max_health), 20) / 2, 30, 20, SKYBLUE);
-    DrawText(TextFormat("Planet: %d/%d", g_player_data.planet_current_health, g_player_data.planet_max_health), g_window.width * (2 / 3.0f) - MeasureText(TextFormat("Planet: %d/%d", g_player_data.planet_current_health, g_player_data.planet_max_health), 20) / 2, 30, 20, SKYBLUE);
+    envs_stop_workers();
+
+    free(g_envs.games);
+    free(g_envs.instances);
+    free(g_envs.observations);
+    free(g_envs.rewards);
+    free(g_envs.dones);
+
+    g_envs.games = NULL;
+    g_envs.instances = NULL;
+    g_envs.observations = NULL;
+    g_envs.rewards = NULL;
+    g_envs.dones = NULL;
+    g_envs.instance_count = 0;
 }
 
-void player_update()
+// Creates a batch of games of a level and resets them all, instance i plays the seeds from seed_first + i * 2^32 on.
+// The games do not depend on each other, so the results are the same for any worker count
+bool envs_create(int instance_count, int level, unsigned long long seed_first, int worker_count)
 {
-    if (IsKeyPressed(KEY_N))
+    envs_destroy();
+
+    g_envs.instance_count = instance_count;
+    g_envs.games = malloc(instance_count * sizeof(Game_t));
+    g_envs.instances = calloc(instance_count, sizeof(Env_Instance_t));
+    g_envs.observations = calloc(instance_count * ENV_OBSERVATION_SIZE, sizeof(float));
+    g_envs.rewards = calloc(instance_count, sizeof(float));
+    g_envs.dones = calloc(instance_count, sizeof(bool));
+
+    if (g_envs.games == NULL || g_envs.instances == NULL || g_envs.observations == NULL || g_envs.rewards == NULL || g_envs.dones == NULL)
     {
-        g_player_data.player_current_health += 100;
+        printf("Could not allocate %d environments\n", instance_count);
+        envs_destroy();
+        return false;
     }
 
-    if (IsKeyPressed(KEY_M))
+    for (int i = 0; i < instance_count; i++)
     {
-        g_player_data.planet_current_health += 100;
+        game_prepare(&g_envs.games[i]);
+        g_envs.games[i].is_unseen = true;
     }
 
-    g_player_data.rotation += g_player_data.rotation_speed * g_frame_time;
+    g_envs.level = Clamp(level, 0, g_levels_data.LEVEL_COUNT - 1);
 
-    if (g_player_data.rotation > 360)
+    for (int i = 0; i < instance_count; i++)
     {
-        g_player_data.rotation -= 360;
+        g_envs.instances[i].episode_seed = seed_first + ((unsigned long long)i << 32);
+        env_reset(i);
     }
 
-    Rectangle player_graphic = {.x = g_player_data.center.x, .y = g_player_data.center.y, .width = g_player_data.hitbox_radius * 2, .height = g_player_data.hitbox_radius * 2};
-
-    DrawCircleV(g_player_data.center, g_player_data.hitbox_radius, g_player_data.color);
-    DrawRectanglePro(player_graphic, (Vector2){.x = g_player_data.hitbox_radius, .y = g_player_data.hitbox_radius}, g_player_data.rotation, g_player_data.color);
-
-    if (g_player_data.player_current_health <= 0)
+    if (!envs_start_workers(worker_count))
     {
-        g_player_data.color = (Color){.r = 255, .g = 0, .b = 0, .a = 0};
-
-        g_player_data.player_current_health += 9999;
-        g_player_data.planet_current_health += 9999;
-
-        explosion_spawn(g_player_data.center, 2.5f, 250, ORANGE);
+        envs_destroy();
+        return false;
+    }
 
-        g_gamestate_previous = g_gamestate_current;
-        g_gamestate_current = STATE_GAMEOVER;
+    return true;
+}
 
-        g_transition_time = 0;
-        g_transition_duration = 4;
+// Steps every instance with its action and returns once all of them are done, see env_step()
+void envs_step(const Player_Policy_Action_t ACTIONS[])
+{
+    if (g_envs.worker_count == 0)
+    {
+        for (int i = 0; i < g_envs.instance_count; i++)
+        {
+            env_step(i, &ACTIONS[i]);
+        }
+        return;
     }
 
-    if (g_player_data.planet_current_health <= 0)
-    {
-        g_player_data.player_current_health += 9999;
-        g_player_data.planet_current_health += 9999;
+    pthread_mutex_lock(&g_envs.mutex);
+    g_envs.actions = ACTIONS;
+    g_envs.workers_stepping = g_envs.worker_count;
+    g_envs.step_generation++;
+    pthread_cond_broadcast(&g_envs.condition);
 
-        explosion_spawn((Vector2){.x = g_window.width / 2, .y = g_window.height}, 3.0f, 800, ORANGE);
+    while (g_envs.workers_stepping > 0)
+    {
+        pthread_cond_wait(&g_envs.condition, &g_envs.mutex);
+    }
+    pthread_mutex_unlock(&g_envs.mutex);
+}
 
-        g_gamestate_previous = g_gamestate_current;
-        g_gamestate_current = STATE_GAMEOVER;
+// A downsampled occupancy grid of a game, one cell per channel, 1 where an entity covers any part of the cell.
+// Cells are bytes or floats, picked by the element size passed in. Bytes hold the same values in a quarter of the memory,
+// floats are for learners that feed the batch on as is
+enum
+{
+    RASTER_WIDTH = 84,
+    RASTER_HEIGHT = 112,
+
+    RASTER_CHANNEL_ENEMIES = 0, // One channel per enemy type, ENEMY_TYPE_NONE excluded
+    RASTER_CHANNEL_ENEMY_PROJECTILES = RASTER_CHANNEL_ENEMIES + ENEMY_TYPE_COUNT - 1,
+    RASTER_CHANNEL_PLAYER_PROJECTILES,
+    RASTER_CHANNEL_EXPLOSIONS, // The blast radius of explosive player projectiles in flight
+    RASTER_CHANNEL_STATION,
+    RASTER_CHANNEL_COUNT,
+
+    RASTER_PLANE_SIZE = RASTER_HEIGHT * RASTER_WIDTH,
+    RASTER_SIZE = RASTER_CHANNEL_COUNT * RASTER_PLANE_SIZE // In cells, times the element size in bytes
+};
+
+// element_size is sizeof(unsigned char) or sizeof(float)
+void raster_fill_cells(unsigned char plane[], int element_size, int column_first, int row_first, int column_last, int row_last)
+{
+    column_first = column_first < 0 ? 0 : column_first;
+    row_first = row_first < 0 ? 0 : row_first;
+    column_last = column_last >= RASTER_WIDTH ? RASTER_WIDTH - 1 : column_last;
+    row_last = row_last >= RASTER_HEIGHT ? RASTER_HEIGHT - 1 : row_last;
 
-        g_transition_time = 0;
-        g_transition_duration = 4;
+    for (int row = row_first; row <= row_last && column_first <= column_last; row++)
+    {
+        if (element_size == sizeof(float))
+        {
+            float *cells = (float *)&plane[(row * RASTER_WIDTH + column_first) * sizeof(float)];
+            for (int i = 0; i <= column_last - column_first; i++)
+            {
+                cells[i] = 1;
+            }
+        }
+        else
+        {
+            memset(&plane[row * RASTER_WIDTH + column_first], 1, column_last - column_first + 1);
+        }
     }
 }
 
-void draw_cheat_keys()
+// Positions and sizes are in window pixels
+void raster_fill_rectangle(unsigned char plane[], int element_size, Vector2 position, float width, float height)
 {
-    DrawRectangle(0, 0, g_window.width, g_window.height, BLACK);
-    DrawText("L: Give 1500 money", 20, 40, 25, SKYBLUE);
-    DrawText("O: Kill all enemies", 20, 80, 25, SKYBLUE);
-    DrawText("P: End level", 20, 120, 25, SKYBLUE);
-    DrawText("K: Hold to speed up time by 5x", 20, 160, 25, SKYBLUE);
-    DrawText("J: Hold to speed up time by 10x", 20, 200, 25, SKYBLUE);
-    DrawText("U: Hold to speed up time by 25x", 20, 240, 25, SKYBLUE);
-    DrawText("N: Give 100 Player Health", 20, 280, 25, SKYBLUE);
-    DrawText("M: Give 100 Planet Health", 20, 320, 25, SKYBLUE);
-    DrawText("G: Unlock next level", 20, 360, 25, SKYBLUE);
-    DrawText("T: Unlock all levels", 20, 400, 25, SKYBLUE);
-    DrawText("R: Reset all levels", 20, 440, 25, SKYBLUE);
+    const float SCALE_X = RASTER_WIDTH / (float)g_window.width;
+    const float SCALE_Y = RASTER_HEIGHT / (float)g_window.height;
+
+    raster_fill_cells(plane, element_size, floorf(position.x * SCALE_X), floorf(position.y * SCALE_Y), floorf((position.x + width) * SCALE_X), floorf((position.y + height) * SCALE_Y));
 }
 
-Color get_symbol_background_color(Weapon_Type_e type)
+// Every row is filled across the widest span of the disc inside it, so a disc smaller than a cell still marks its cell
+void raster_fill_disc(unsigned char plane[], int element_size, Vector2 center, float radius)
 {
-    Color color = g_weapons_data.symbol_color_default;
+    const float CELL_WIDTH = g_window.width / (float)RASTER_WIDTH;
+    const float CELL_HEIGHT = g_window.height / (float)RASTER_HEIGHT;
+
+    int row_first = floorf((center.y - radius) / CELL_HEIGHT);
+    int row_last = floorf((center.y + radius) / CELL_HEIGHT);
+    row_first = row_first < 0 ? 0 : row_first;
+    row_last = row_last >= RASTER_HEIGHT ? RASTER_HEIGHT - 1 : row_last;
 
-    if (g_weapons_data.weapons[type].ammo_count >= g_weapons_data.weapons[type].ammo_count_max)
+    for (int row = row_first; row <= row_last; row++)
     {
-        color = g_weapons_data.symbol_color_full;
+        float row_top = row * CELL_HEIGHT;
+        float distance_y = fmaxf(fmaxf(row_top - center.y, center.y - (row_top + CELL_HEIGHT)), 0);
+        float half_width = sqrtf(fmaxf(radius * radius - distance_y * distance_y, 0));
+
+        raster_fill_cells(plane, element_size, floorf((center.x - half_width) / CELL_WIDTH), row, floorf((center.x + half_width) / CELL_WIDTH), row);
     }
-    else if (g_weapons_data.weapons[type].ammo_count > 0)
+}
+
+// Writes the grid of a game, channels first then rows. Reads only the occupied slots of the entity pools, nothing is drawn
+void raster_write(Game_t *game, unsigned char grid[], int element_size)
+{
+    const int PLANE_BYTES = RASTER_PLANE_SIZE * element_size;
+
+    memset(grid, 0, RASTER_SIZE * element_size);
+
+    for (int i = pool_next(&game->enemies_data.occupancy, 0); i >= 0; i = pool_next(&game->enemies_data.occupancy, i + 1))
     {
-        color = g_weapons_data.symbol_color_not_empty;
+        const Enemy_t *ENEMY = &game->enemies_data.enemies[i];
+        const Enemy_Data_t *DATA = &g_enemy_database[ENEMY->type];
+        unsigned char *plane = &grid[(RASTER_CHANNEL_ENEMIES + ENEMY->type - 1) * PLANE_BYTES];
+        raster_fill_rectangle(plane, element_size, enemy_get_position(*ENEMY, game->enemies_data.time_elapsed), DATA->width, DATA->height);
     }
 
-    if (!g_player_settings.weapon_ready_alert)
+    unsigned char *enemy_projectiles_plane = &grid[RASTER_CHANNEL_ENEMY_PROJECTILES * PLANE_BYTES];
+    for (int i = pool_next(&game->projectiles_data.enemy_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.enemy_occupancy, i + 1))
     {
-        return color;
+        const Projectile_Enemy_t *PROJECTILE = &game->projectiles_data.enemy_projectiles[i];
+        raster_fill_disc(enemy_projectiles_plane, element_size, PROJECTILE->position, g_enemy_projectile_database[PROJECTILE->type].radius);
     }
 
-    if ((g_weapons_data.symbol_alert_timers[type] < g_weapons_data.symbol_alert_duration * (1 / 3.0f) || g_weapons_data.symbol_alert_timers[type] > g_weapons_data.symbol_alert_duration * (2 / 3.0f)) && g_weapons_data.symbol_alert_timers[type] < g_weapons_data.symbol_alert_duration)
+    unsigned char *player_projectiles_plane = &grid[RASTER_CHANNEL_PLAYER_PROJECTILES * PLANE_BYTES];
+    unsigned char *explosions_plane = &grid[RASTER_CHANNEL_EXPLOSIONS * PLANE_BYTES];
+    for (int i = pool_next(&game->projectiles_data.player_occupancy, 0); i >= 0; i = pool_next(&game->projectiles_data.player_occupancy, i + 1))
     {
-        color = g_weapons_data.symbol_color_alert;
+        const Projectile_Player_t *PROJECTILE = &game->projectiles_data.player_projectiles[i];
+        const Projectile_Data_Player_t *DATA = &g_player_projectile_database[PROJECTILE->type];
+        raster_fill_disc(player_projectiles_plane, element_size, PROJECTILE->position, DATA->radius);
+
+        if (DATA->is_explosive && flags_has(PROJECTILE->flags, PROJECTILE_FLAG_IS_LAUNCHED))
+        {
+            raster_fill_disc(explosions_plane, element_size, PROJECTILE->position, DATA->explosion.size);
+        }
     }
 
-    return color;
+    raster_fill_disc(&grid[RASTER_CHANNEL_STATION * PLANE_BYTES], element_size, game->player_data.center, game->player_data.hitbox_radius);
 }
 
-void weapons_draw_symbols()
+// Writes the grids of every instance of the batch back to back, element_size bytes per cell
+void envs_rasterize(unsigned char grids[], int element_size)
 {
-    // TODO
-    // Make DrawSymbol a function instead so that it is possible to draw symbols elsewhere
-
-    const short AMMO_COUNTER_Y = g_weapons_data.symbol_draw_area_y + 15;
-    const short AMMO_COUNTER_FONT_SIZE = 25;
+    for (int i = 0; i < g_envs.instance_count; i++)
+    {
+        raster_write(&g_envs.games[i], &grids[(size_t)i * RASTER_SIZE * element_size], element_size);
+    }
+}
 
-    const unsigned char RELOAD_INDICATOR_WIDTH = 20;
+// Steps the current batch with random actions, returns the wall-clock seconds or a negative value on failure
+double envs_benchmark_steps(int step_count, int *episodes, double *reward_total)
+{
+    Player_Policy_Action_t *actions = calloc(g_envs.instance_count, sizeof(*actions));
+    if (actions == NULL)
+    {
+        return -1;
+    }
 
-    DrawRectangle(0, g_weapons_data.symbol_draw_area_y, g_window.width, g_window.height, GRAY);
+    unsigned long long action_rng_state = 0xA0761D6478BD642FULL;
 
-    const unsigned char SYMBOL_OFFSET_Y = 20;
+    *episodes = 0;
+    *reward_total = 0;
+    double time_start = sim_clock_seconds();
 
-    for (Weapon_Type_e i = 0; i < WEAPON_TYPE_COUNT; i++)
+    for (int step = 0; step < step_count; step++)
     {
-        if (!g_weapons_data.weapons[i].is_unlocked)
+        for (int i = 0; i < g_envs.instance_count; i++)
         {
-            continue;
+            actions[i].aim_position = (Vector2){.x = rand_float_from(&action_rng_state) * g_window.width, .y = rand_float_from(&action_rng_state) * g_window.height * 0.5f};
+            for (int weapon = 0; weapon < WEAPON_TYPE_COUNT; weapon++)
+            {
+                actions[i].weapons_fired[weapon] = rand_float_from(&action_rng_state) < 0.5f;
+            }
         }
 
-        const int SYMBOL_X = ((float)(i + 1) / (WEAPON_TYPE_COUNT + 1)) * g_window.width - g_weapons_data.symbol_width / 2;
-        const int SYMBOL_Y = g_window.height - g_weapons_data.symbol_height - SYMBOL_OFFSET_Y;
-
-        // Symbol background
-        DrawRectangle(
-            SYMBOL_X,
-            (g_window.height - g_weapons_data.symbol_height) - 20,
-            g_weapons_data.symbol_width,
-            g_weapons_data.symbol_height,
-            get_symbol_background_color(i));
+        envs_step(actions);
 
-        // Ammo counter
-        DrawText(TextFormat("%d", g_weapons_data.weapons[i].ammo_count), SYMBOL_X, AMMO_COUNTER_Y, 25, SKYBLUE);
-        DrawText("|", SYMBOL_X + g_weapons_data.symbol_width / 2 - MeasureText("|", AMMO_COUNTER_FONT_SIZE), AMMO_COUNTER_Y, AMMO_COUNTER_FONT_SIZE, SKYBLUE);
+        for (int i = 0; i < g_envs.instance_count; i++)
         {
-            const char *text = TextFormat("%d", g_weapons_data.weapons[i].ammo_count_max);
-            DrawText(text, SYMBOL_X + g_weapons_data.symbol_width - MeasureText(text, AMMO_COUNTER_FONT_SIZE), AMMO_COUNTER_Y, 25, SKYBLUE);
+            *episodes += g_envs.dones[i];
+            *reward_total += g_envs.rewards[i];
         }
+    }
 
-        DrawRectangle(SYMBOL_X, SYMBOL_Y + g_weapons_data.symbol_height, -RELOAD_INDICATOR_WIDTH, Clamp(g_weapons_data.weapons[i].time_last_reload / g_weapons_data.weapons[i].time_ammo_reload, 0, 1) * g_weapons_data.symbol_height * -1, GREEN);
+    double time_total = sim_clock_seconds() - time_start;
 
-        // Symbols
-        switch (i)
-        {
-        case WEAPON_TYPE_BURST:
-        {
-            const int LINE_LENGTH = 20;
-            DrawLineEx(
-                (Vector2){.x = SYMBOL_X + (float)1 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + g_weapons_data.symbol_height - (g_weapons_data.symbol_height - LINE_LENGTH) / 2 + LINE_LENGTH / 2},
-                (Vector2){.x = SYMBOL_X + (float)1 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + (g_weapons_data.symbol_height - LINE_LENGTH) / 2 + LINE_LENGTH / 2},
-                4,
-                BLACK);
+    free(actions);
+    return time_total;
+}
 
-            DrawLineEx(
-                (Vector2){.x = SYMBOL_X + (float)2 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + g_weapons_data.symbol_height - (g_weapons_data.symbol_height - LINE_LENGTH) / 2},
-                (Vector2){.x = SYMBOL_X + (float)2 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + (g_weapons_data.symbol_height - LINE_LENGTH) / 2},
-                4,
-                BLACK);
+// Steps the same batch on the calling thread and then on worker_count workers, both runs must agree. Then reports the
+// environment steps and grids per second
+int envs_benchmark(int instance_count, int step_count, int worker_count)
+{
+    int episodes_single = 0;
+    int episodes = 0;
+    double reward_total_single = 0;
+    double reward_total = 0;
+
+    double time_single = envs_create(instance_count, 11, 1, 1) ? envs_benchmark_steps(step_count, &episodes_single, &reward_total_single) : -1;
+    double time_total = time_single >= 0 && envs_create(instance_count, 11, 1, worker_count) ? envs_benchmark_steps(step_count, &episodes, &reward_total) : -1;
+    if (time_total < 0)
+    {
+        envs_destroy();
+        return 1;
+    }
 
-            DrawLineEx(
-                (Vector2){.x = SYMBOL_X + (float)3 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + g_weapons_data.symbol_height - (g_weapons_data.symbol_height - LINE_LENGTH) / 2 - LINE_LENGTH / 2},
-                (Vector2){.x = SYMBOL_X + (float)3 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + (g_weapons_data.symbol_height - LINE_LENGTH) / 2 - LINE_LENGTH / 2},
-                4,
-                BLACK);
+    double steps = (double)instance_count * step_count;
+    bool is_matching = episodes == episodes_single && reward_total == reward_total_single;
 
-            DrawLineEx(
-                (Vector2){.x = SYMBOL_X + (float)4 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + g_weapons_data.symbol_height - (g_weapons_data.symbol_height - LINE_LENGTH) / 2},
-                (Vector2){.x = SYMBOL_X + (float)4 / 5 * g_weapons_data.symbol_width, .y = SYMBOL_Y + (g_weapons_data.symbol_height - LINE_LENGTH) / 2},
-                4,
-                BLACK);
-        }
-        break;
+    printf("Environments: %d instances, %d steps of %d ticks, observations of %d floats\n", instance_count, step_count, g_envs.ACTION_REPEAT, ENV_OBSERVATION_SIZE);
+    printf("1 thread: %.0f environment steps per second, %.2f us per step\n", steps / time_single, time_single / steps * 1e6);
+    printf("%d workers: %.0f environment steps per second, %.2fx\n", g_envs.worker_count > 0 ? g_envs.worker_count : 1, steps / time_total, time_single / time_total);
+    printf("%d episodes finished, mean reward per step %.4f, %s\n", episodes, reward_total / steps, is_matching ? "identical to 1 thread" : "MISMATCH with 1 thread");
 
-        case WEAPON_TYPE_CANNON:
-        {
-            const Vector2 FIRST_POINT_DIRECTION = {.x = 0, .y = -20};
-            const Vector2 TRIANGLE_CENTER = {.x = SYMBOL_X + g_weapons_data.symbol_width / 2, .y = SYMBOL_Y + g_weapons_data.symbol_height / 2};
+    enum
+    {
+        RASTER_REPEATS = 20
+    };
 
-            Vector2 point_1 = Vector2Add(TRIANGLE_CENTER, FIRST_POINT_DIRECTION);
-            Vector2 point_2 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 240 * (3.14f / 180)));
-            Vector2 point_3 = Vector2Add(TRIANGLE_CENTER, Vector2Rotate(FIRST_POINT_DIRECTION, 120 * (3.14f / 180)));
+    // Byte grids first, then float grids, which must cover the same cells
+    unsigned char *grids = malloc((size_t)instance_count * RASTER_SIZE * sizeof(float));
+    if (grids == NULL)
+    {
+        printf("Could not allocate %d grids\n", instance_count);
+        envs_destroy();
+        return 1;
+    }
 
-            DrawTriangle(point_1, point_2, point_3, BLACK);
-        }
-        break;
+    long long cells_covered[2] = {0};
+    for (int format = 0; format < 2; format++)
+    {
+        const int ELEMENT_SIZE = format == 0 ? sizeof(unsigned char) : sizeof(float);
 
-        case WEAPON_TYPE_AUTOCANNON:
+        double time_start = sim_clock_seconds();
+        for (int repeat = 0; repeat < RASTER_REPEATS; repeat++)
         {
-            // TODO
-            // Make a symbol for the autocannon
+            envs_rasterize(grids, ELEMENT_SIZE);
         }
-        break;
+        time_total = sim_clock_seconds() - time_start;
 
-        case WEAPON_TYPE_TORPEDO:
+        for (long long i = 0; i < (long long)instance_count * RASTER_SIZE; i++)
         {
-            // TODO
-            // Make a symbol for the torpedo
+            cells_covered[format] += ELEMENT_SIZE == sizeof(float) ? ((float *)grids)[i] : grids[i];
         }
-        break;
 
-        default:
-            break;
-        }
+        printf("Grids of %dx%d with %d channels, %s cells: %.2f us per grid, %.1f cells covered per grid\n", RASTER_WIDTH, RASTER_HEIGHT, RASTER_CHANNEL_COUNT, format == 0 ? "byte" : "float",
+               time_total / (RASTER_REPEATS * instance_count) * 1e6, cells_covered[format] / (double)instance_count);
     }
+
+    is_matching = is_matching && cells_covered[0] == cells_covered[1];
+    free(grids);
+    envs_destroy();
+    return is_matching ? 0 : 1;
 }
 
-void transition_update()
+void transition_update(Game_t *game)
 {
     // TODO
     // Re-factor this function
 
     // Instead of calling each function in each step of the transition, instead call a function to toggle specific functions when entering a new step of a transition
 
-    g_transition_time += g_frame_time;
-    g_transition_progress = Clamp(g_transition_time / g_transition_duration, 0, 1);
+    game->transition_time += game->frame_time;
+    game->transition_progress = Clamp(game->transition_time / game->transition_duration, 0, 1);
 
-    switch (g_gamestate_previous)
+    switch (game->gamestate_previous)
     {
     case STATE_LEVEL:
     {
-        switch (g_gamestate_current)
+        switch (game->gamestate_current)
         {
         case STATE_GAMEOVER:
         {
-            background_update();
-            money_update();
+            background_update(game);
+            background_draw(game);
+            money_update(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.25f)
+            if (game->transition_progress <= 0.25f)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                enemies_update();
-                enemies_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                enemies_update(game);
+                enemies_draw(game);
+                weapons_draw_symbols(game);
 
                 DrawText(
-                    TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * g_transition_progress * 4, .r = RED.r, .g = RED.g, .b = RED.b});
+                    (Color){.a = 255 * game->transition_progress * 4, .r = RED.r, .g = RED.g, .b = RED.b});
             }
-            else if (g_transition_progress <= 0.5f)
+            else if (game->transition_progress <= 0.5f)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                enemies_update();
-                enemies_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                enemies_update(game);
+                enemies_draw(game);
+                weapons_draw_symbols(game);
 
                 DrawText(
-                    TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
                     RED);
             }
-            else if (g_transition_progress <= 0.75)
+            else if (game->transition_progress <= 0.75)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                enemies_update();
-                enemies_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                enemies_update(game);
+                enemies_draw(game);
+                weapons_draw_symbols(game);
 
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress - 0.5f) * 4, .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress - 0.5f) * 4, .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
                 DrawText(
-                    TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Failed...", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (1.0f - ((g_transition_progress - 0.5f) * 4)), .r = RED.r, .g = RED.g, .b = RED.b});
+                    (Color){.a = 255 * (1.0f - ((game->transition_progress - 0.5f) * 4)), .r = RED.r, .g = RED.g, .b = RED.b});
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
-                game_over_screen(true);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (g_transition_progress - 0.75f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                game_over_screen(game, true);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (game->transition_progress - 0.75f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
         }
         break;
 
         case STATE_UPGRADE:
         {
-            background_update();
+            background_update(game);
+            background_draw(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.25f)
+            if (game->transition_progress <= 0.25f)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                weapons_draw_symbols(game);
 
                 DrawText(
-                    TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * g_transition_progress * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * game->transition_progress * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
-            else if (g_transition_progress <= 0.5f)
+            else if (game->transition_progress <= 0.5f)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                weapons_draw_symbols(game);
 
                 DrawText(
-                    TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
                     BLUE);
             }
-            else if (g_transition_progress <= 0.75)
+            else if (game->transition_progress <= 0.75)
             {
-                projectiles_update();
-                explosions_update();
-                weapons_update();
+                projectiles_update(game);
+                particles_update(game);
+                weapons_update(game);
 
                 money_draw_ingame();
-                player_update();
+                player_update(game);
+                player_draw(game);
                 projectiles_draw();
-                explosions_draw();
-                weapons_draw_symbols();
+                particles_draw();
+                weapons_draw_symbols(game);
 
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress - 0.5f) * 4, .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress - 0.5f) * 4, .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
                 DrawText(
-                    TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d Cleared", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (1.0f - ((g_transition_progress - 0.5f) * 4)), .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (1.0f - ((game->transition_progress - 0.5f) * 4)), .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
-                g_stars_data.screen_scroll = 0.5f;
-                upgrade_menu_update(false, 0);
-                draw_state_selection_buttons(true);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (g_transition_progress - 0.75f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                game->stars_data.screen_scroll = 0.5f;
+                upgrade_menu_update(game, false, 0);
+                draw_state_selection_buttons(game, true);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (game->transition_progress - 0.75f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
         }
         break;
@@ -2822,93 +8358,99 @@ void transition_update()
 
     case STATE_LEVEL_SELECTION:
     {
-        switch (g_gamestate_current)
+        switch (game->gamestate_current)
         {
         case STATE_LEVEL:
         {
 
-            background_update();
+            background_update(game);
+            background_draw(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.25f)
+            if (game->transition_progress <= 0.25f)
             {
-                draw_state_selection_buttons(true);
-                level_selector_update(true, 0);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                draw_state_selection_buttons(game, true);
+                level_selector_update(game, true, 0);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
-            else if (g_transition_progress <= 0.5f)
+            else if (game->transition_progress <= 0.5f)
             {
-                g_stars_data.screen_scroll = 0;
+                game->stars_data.screen_scroll = 0;
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (g_transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (game->transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (g_transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (game->transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
-            else if (g_transition_progress <= 0.75)
+            else if (game->transition_progress <= 0.75)
             {
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
                     BLUE);
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
                 // TODO
                 // Sometimes at the end of this section of the transition, the level label occasionally pops up for a split second
 
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (1.0f - (g_transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (1.0f - (game->transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
         }
         break;
 
         case STATE_MAIN_MENU:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = -0.5f + 0.5f * scroll_factor;
-            background_update();
-            draw_state_selection_buttons(true);
-
-            level_selector_update(true, -g_window.width * scroll_factor);
-            main_menu_update(g_window.width * (1 - scroll_factor));
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = -0.5f + 0.5f * scroll_factor;
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            level_selector_update(game, true, -g_window.width * scroll_factor);
+            main_menu_update(game, g_window.width * (1 - scroll_factor));
         }
         break;
 
         case STATE_UPGRADE:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = -0.5f + scroll_factor;
-            background_update();
-            draw_state_selection_buttons(true);
-
-            level_selector_update(true, -g_window.width * scroll_factor * 2);
-            main_menu_update(g_window.width * (1 - scroll_factor * 2));
-            upgrade_menu_update(true, g_window.width * (2 - scroll_factor * 2));
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = -0.5f + scroll_factor;
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            level_selector_update(game, true, -g_window.width * scroll_factor * 2);
+            main_menu_update(game, g_window.width * (1 - scroll_factor * 2));
+            upgrade_menu_update(game, true, g_window.width * (2 - scroll_factor * 2));
         }
 
         default:
@@ -2919,29 +8461,31 @@ void transition_update()
 
     case STATE_MAIN_MENU:
     {
-        switch (g_gamestate_current)
+        switch (game->gamestate_current)
         {
         case STATE_LEVEL_SELECTION:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = -0.5f * scroll_factor;
-            background_update();
-            draw_state_selection_buttons(true);
-
-            level_selector_update(true, -g_window.width * (1 - scroll_factor));
-            main_menu_update(g_window.width * scroll_factor);
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = -0.5f * scroll_factor;
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            level_selector_update(game, true, -g_window.width * (1 - scroll_factor));
+            main_menu_update(game, g_window.width * scroll_factor);
         }
         break;
 
         case STATE_UPGRADE:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = 0.5f * scroll_factor;
-            background_update();
-            draw_state_selection_buttons(true);
-
-            main_menu_update(-g_window.width * scroll_factor);
-            upgrade_menu_update(true, g_window.width * (1 - scroll_factor));
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = 0.5f * scroll_factor;
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            main_menu_update(game, -g_window.width * scroll_factor);
+            upgrade_menu_update(game, true, g_window.width * (1 - scroll_factor));
         }
         break;
 
@@ -2953,88 +8497,94 @@ void transition_update()
 
     case STATE_UPGRADE:
     {
-        switch (g_gamestate_current)
+        switch (game->gamestate_current)
         {
         case STATE_MAIN_MENU:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = 0.5f * (1 - scroll_factor);
-            background_update();
-            draw_state_selection_buttons(true);
-
-            main_menu_update(-g_window.width * (1 - scroll_factor));
-            upgrade_menu_update(true, g_window.width * scroll_factor);
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = 0.5f * (1 - scroll_factor);
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            main_menu_update(game, -g_window.width * (1 - scroll_factor));
+            upgrade_menu_update(game, true, g_window.width * scroll_factor);
         }
 
         break;
         case STATE_LEVEL_SELECTION:
         {
-            float scroll_factor = (sin((PI / 2 - PI) + PI * g_transition_progress) + 1) / 2;
-            g_stars_data.screen_scroll = 0.5 - scroll_factor;
-            background_update();
-            draw_state_selection_buttons(true);
-
-            level_selector_update(true, -g_window.width * (2 - scroll_factor * 2));
-            main_menu_update(-g_window.width * (1 - scroll_factor * 2));
-            upgrade_menu_update(true, g_window.width * scroll_factor * 2);
+            float scroll_factor = (sin((PI / 2 - PI) + PI * game->transition_progress) + 1) / 2;
+            game->stars_data.screen_scroll = 0.5 - scroll_factor;
+            background_update(game);
+            background_draw(game);
+            draw_state_selection_buttons(game, true);
+
+            level_selector_update(game, true, -g_window.width * (2 - scroll_factor * 2));
+            main_menu_update(game, -g_window.width * (1 - scroll_factor * 2));
+            upgrade_menu_update(game, true, g_window.width * scroll_factor * 2);
         }
         break;
 
         case STATE_LEVEL:
         {
-            background_update();
+            background_update(game);
+            background_draw(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.25f)
+            if (game->transition_progress <= 0.25f)
             {
-                draw_state_selection_buttons(true);
-                upgrade_menu_update(true, 0);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                draw_state_selection_buttons(game, true);
+                upgrade_menu_update(game, true, 0);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
-            else if (g_transition_progress <= 0.5f)
+            else if (game->transition_progress <= 0.5f)
             {
                 draw_player_health();
-                g_stars_data.screen_scroll = 0;
+                game->stars_data.screen_scroll = 0;
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (g_transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (game->transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (g_transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (game->transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
-            else if (g_transition_progress <= 0.75)
+            else if (game->transition_progress <= 0.75)
             {
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
                     BLUE);
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (1.0f - (g_transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (1.0f - (game->transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
         }
         break;
@@ -3047,86 +8597,91 @@ void transition_update()
 
     case STATE_GAMEOVER:
     {
-        switch (g_gamestate_current)
+        switch (game->gamestate_current)
         {
         case STATE_LEVEL:
         {
-            background_update();
+            background_update(game);
+            background_draw(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.25f)
+            if (game->transition_progress <= 0.25f)
             {
-                game_over_screen(true);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                game_over_screen(game, true);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
-            else if (g_transition_progress <= 0.5f)
+            else if (game->transition_progress <= 0.5f)
             {
                 draw_player_health();
-                g_stars_data.screen_scroll = 0;
+                game->stars_data.screen_scroll = 0;
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (g_transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1.0f - (game->transition_progress - 0.25f) * 4), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (g_transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (game->transition_progress - 0.25f) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
-            else if (g_transition_progress <= 0.75)
+            else if (game->transition_progress <= 0.75)
             {
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
                     BLUE);
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
                 draw_player_health();
                 money_draw_ingame();
-                player_update();
-                weapons_draw_symbols();
+                player_update(game);
+                player_draw(game);
+                weapons_draw_symbols(game);
                 DrawText(
-                    TextFormat("Level %d", g_enemy_spawn_director.current_level + 1),
-                    g_window.width / 2 - MeasureText(TextFormat("Level %d", g_enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
+                    TextFormat("Level %d", game->enemy_spawn_director.current_level + 1),
+                    g_window.width / 2 - MeasureText(TextFormat("Level %d", game->enemy_spawn_director.current_level + 1), FONT_SIZE) / 2,
                     g_window.height * 0.35f,
                     FONT_SIZE,
-                    (Color){.a = 255 * (1.0f - (g_transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
+                    (Color){.a = 255 * (1.0f - (game->transition_progress - 0.75f)) * 4, .r = BLUE.r, .g = BLUE.g, .b = BLUE.b});
             }
         }
         break;
 
         case STATE_UPGRADE:
         {
-            background_update();
+            background_update(game);
+            background_draw(game);
 
             enum
             {
                 FONT_SIZE = 60
             };
 
-            if (g_transition_progress <= 0.5f)
+            if (game->transition_progress <= 0.5f)
             {
-                game_over_screen(true);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (g_transition_progress * 2), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                game_over_screen(game, true);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (game->transition_progress * 2), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
-            else if (g_transition_progress < 1.0f)
+            else if (game->transition_progress < 1.0f)
             {
-                g_stars_data.screen_scroll = 0.5f;
-                upgrade_menu_update(false, 0);
-                draw_state_selection_buttons(true);
-                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (g_transition_progress - 0.5f) * 2), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
+                game->stars_data.screen_scroll = 0.5f;
+                upgrade_menu_update(game, false, 0);
+                draw_state_selection_buttons(game, true);
+                DrawRectangle(0, 0, g_window.width, g_window.height, (Color){.a = 255 * (1 - (game->transition_progress - 0.5f) * 2), .r = BLACK.r, .g = BLACK.g, .b = BLACK.b});
             }
         }
         break;
@@ -3141,71 +8696,72 @@ void transition_update()
     }
 }
 
-void update_current_state()
+void update_current_state(Game_t *game)
 {
-    switch (g_gamestate_current)
+    switch (game->gamestate_current)
     {
     case STATE_LEVEL:
     {
-        money_update();
-
-        g_stars_data.screen_scroll = 0;
-        background_update();
-        player_update();
-
-        weapons_update();
-        enemies_update();
-        projectiles_update();
-        explosions_update();
-        enemies_update_spawn_conditions();
+        game->stars_data.screen_scroll = 0;
 
-        // DrawText(TextFormat("%d", GetFPS()), 50, 50, 40, WHITE);
-        projectiles_draw();
-
-        enemies_draw();
-        explosions_draw();
-
-        weapons_draw_symbols();
+        if (g_player_settings.threaded_simulation)
+        {
+            // The simulation thread takes over the game state, only its snapshots are drawn from here on
+            sim_thread_resume(game);
+            render_view_use_snapshot(sim_snapshot_acquire());
+        }
+        else if (atomic_load(&g_turbo.is_requested))
+        {
+            turbo_run_slice(game, false);
+        }
+        else
+        {
+            g_turbo.speedup = 0;
+            level_tick(game);
+        }
 
-        draw_player_health();
-        money_draw_ingame();
+        level_draw(game);
     }
     break;
 
     case STATE_MAIN_MENU:
     {
-        g_stars_data.screen_scroll = 0;
+        game->stars_data.screen_scroll = 0;
 
-        background_update();
-        draw_state_selection_buttons(false);
-        main_menu_update(0);
+        background_update(game);
+        background_draw(game);
+        draw_state_selection_buttons(game, false);
+        main_menu_update(game, 0);
     }
     break;
 
     case STATE_LEVEL_SELECTION:
     {
-        g_stars_data.screen_scroll = -0.5f;
+        game->stars_data.screen_scroll = -0.5f;
 
-        background_update();
-        draw_state_selection_buttons(false);
-        level_selector_update(false, 0);
+        background_update(game);
+        background_draw(game);
+        draw_state_selection_buttons(game, false);
+        level_selector_update(game, false, 0);
     }
     break;
 
     case STATE_UPGRADE:
     {
-        money_update();
-        g_stars_data.screen_scroll = 0.5f;
-        background_update();
-        draw_state_selection_buttons(false);
-        upgrade_menu_update(false, 0);
+        money_update(game);
+        game->stars_data.screen_scroll = 0.5f;
+        background_update(game);
+        background_draw(game);
+        draw_state_selection_buttons(game, false);
+        upgrade_menu_update(game, false, 0);
     }
     break;
 
     case STATE_GAMEOVER:
     {
-        background_update();
-        game_over_screen(false);
+        background_update(game);
+        background_draw(game);
+        game_over_screen(game, false);
     }
     break;
 
@@ -3216,90 +8772,344 @@ void update_current_state()
 
 //--------------------------------------------------
 
-int main()
+// Paces the main loop. At the refresh rate with vsync the buffer swap paces it, the slower idle and unfocused rates
+// sleep most of the remaining frame and spin the last bit, since sleeps overshoot
+struct
+{
+    const int FPS_FALLBACK;          // When the monitor refresh rate is unknown
+    const int FPS_MENU_IDLE;         // An untouched menu only has the stars drifting
+    const int FPS_UNFOCUSED;
+    const double MENU_IDLE_SECONDS;
+    const double SPIN_SECONDS;
+    const double LOG_INTERVAL_SECONDS;
+
+    double time_deadline;
+    double time_frame_previous;
+    double period_previous;
+    double time_last_input;
+
+    // Deviation of the frame intervals from their target since the last log
+    int jitter_frames;
+    double jitter_sum_squares;
+    double jitter_worst;
+    double time_last_log;
+} g_frame_limiter = {
+    .FPS_FALLBACK = 60,
+    .FPS_MENU_IDLE = 20,
+    .FPS_UNFOCUSED = 10,
+    .MENU_IDLE_SECONDS = 3,
+    .SPIN_SECONDS = 0.002,
+    .LOG_INTERVAL_SECONDS = 10,
+};
+
+int frame_limiter_get_refresh_rate()
+{
+    int refresh_rate = GetMonitorRefreshRate(GetCurrentMonitor());
+
+    return refresh_rate > 0 ? refresh_rate : g_frame_limiter.FPS_FALLBACK;
+}
+
+// The game state is read from the render view, the simulation thread may own the game
+int frame_limiter_get_target_fps(double time_now)
+{
+    if (!IsWindowFocused())
+    {
+        return g_frame_limiter.FPS_UNFOCUSED;
+    }
+
+    if (g_render_view.hud.is_menu && time_now - g_frame_limiter.time_last_input > g_frame_limiter.MENU_IDLE_SECONDS)
+    {
+        return g_frame_limiter.FPS_MENU_IDLE;
+    }
+
+    return frame_limiter_get_refresh_rate();
+}
+
+void frame_limiter_note_input()
+{
+    Vector2 mouse_delta = GetMouseDelta();
+    bool is_active = mouse_delta.x != 0 || mouse_delta.y != 0 || IsMouseButtonDown(MOUSE_BUTTON_LEFT);
+
+    // Polled key by key, taking keys from the queue with GetKeyPressed() would hide them from everything else
+    for (int key = KEY_SPACE; key <= KEY_KB_MENU && !is_active; key++)
+    {
+        is_active = IsKeyDown(key);
+    }
+
+    if (is_active)
+    {
+        g_frame_limiter.time_last_input = sim_clock_seconds();
+    }
+}
+
+void frame_limiter_log_jitter(double time_now, int target_fps)
+{
+    if (time_now - g_frame_limiter.time_last_log < g_frame_limiter.LOG_INTERVAL_SECONDS)
+    {
+        return;
+    }
+
+    if (g_frame_limiter.jitter_frames > 0)
+    {
+        printf("Frame pacing at %d fps: %d frames, jitter %.3f ms rms, %.3f ms worst\n", target_fps, g_frame_limiter.jitter_frames,
+               sqrt(g_frame_limiter.jitter_sum_squares / g_frame_limiter.jitter_frames) * 1000, g_frame_limiter.jitter_worst * 1000);
+    }
+
+    g_frame_limiter.jitter_frames = 0;
+    g_frame_limiter.jitter_sum_squares = 0;
+    g_frame_limiter.jitter_worst = 0;
+    g_frame_limiter.time_last_log = time_now;
+}
+
+void frame_limiter_wait()
+{
+    double time_now = sim_clock_seconds();
+    int target_fps = frame_limiter_get_target_fps(time_now);
+    double period = 1.0 / target_fps;
+    double time_deadline = g_frame_limiter.time_deadline + period;
+
+    // Start over instead of rushing frames after a hitch, or waiting out a slower rate
+    if (time_deadline < time_now - period || time_deadline > time_now + period)
+    {
+        time_deadline = time_now + period;
+    }
+
+    // The swap already blocks until the next refresh, waiting here as well would only make it miss one now and then
+    bool is_paced_by_vsync = IsWindowState(FLAG_VSYNC_HINT) && target_fps == frame_limiter_get_refresh_rate();
+    if (is_paced_by_vsync)
+    {
+        time_deadline = time_now;
+    }
+
+    if (time_deadline - time_now > g_frame_limiter.SPIN_SECONDS)
+    {
+        sim_sleep_seconds(time_deadline - time_now - g_frame_limiter.SPIN_SECONDS);
+    }
+
+    while (sim_clock_seconds() < time_deadline)
+    {
+    }
+
+    g_frame_limiter.time_deadline = fmax(time_deadline, time_now);
+    time_now = sim_clock_seconds();
+
+    if (period == g_frame_limiter.period_previous)
+    {
+        double jitter = fabs(time_now - g_frame_limiter.time_frame_previous - period);
+
+        g_frame_limiter.jitter_frames++;
+        g_frame_limiter.jitter_sum_squares += jitter * jitter;
+        g_frame_limiter.jitter_worst = fmax(g_frame_limiter.jitter_worst, jitter);
+    }
+
+    g_frame_limiter.time_frame_previous = time_now;
+    g_frame_limiter.period_previous = period;
+
+    frame_limiter_log_jitter(time_now, target_fps);
+}
+
+//--------------------------------------------------
+
+int main(int argc, char **argv)
 {
-    player_init();
-    explosions_init();
-    projectiles_init();
-    enemies_init();
-    background_init();
+    Game_t *game = game_create();
+    if (game == NULL)
+    {
+        return 1;
+    }
 
-    g_weapons_data.symbol_draw_area_y = g_window.height - 125;
+    rand_seed(game, time(NULL));
 
-    // SetTargetFPS(60);
-    srand(time(NULL));
+    if (argc > 1 && strcmp(argv[1], "--benchmark-save-state") == 0)
+    {
+        return save_state_benchmark(game);
+    }
 
-    InitWindow(g_window.width, g_window.height, "Arcade Project");
+    if (argc > 1 && strcmp(argv[1], "--benchmark-sim-math") == 0)
+    {
+        return sim_math_benchmark(game);
+    }
 
-    while (!WindowShouldClose())
+    // --benchmark-entities [level]
+    if (argc > 1 && strcmp(argv[1], "--benchmark-entities") == 0)
     {
-        if (IsKeyPressed(KEY_L))
-        {
-            money_add(1000);
-        }
+        int level = argc > 2 ? Clamp(atoi(argv[2]) - 1, 0, g_levels_data.LEVEL_COUNT - 1) : 11;
+        return entity_update_benchmark(level);
+    }
 
-        g_frame_time = GetFrameTime();
-        if (IsKeyDown(KEY_K))
-        {
-            g_frame_time *= 5;
-        }
-        else if (IsKeyDown(KEY_J))
+    if (argc > 2 && strcmp(argv[1], "--verify-replay") == 0)
+    {
+        return replay_verify(game, argv[2]);
+    }
+
+    // --golden-frames <replay> <directory> [--update]
+    if (argc > 3 && strcmp(argv[1], "--golden-frames") == 0)
+    {
+        return golden_frames_run(game, argv[2], argv[3], argc > 4 && strcmp(argv[4], "--update") == 0);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "--golden-replay") == 0)
+    {
+        return golden_frames_record_replay(game, argv[2]);
+    }
+
+    // --tune-levels <output> [generations] [children] [attempts]
+    if (argc > 2 && strcmp(argv[1], "--tune-levels") == 0)
+    {
+        int generation_count = argc > 3 ? atoi(argv[3]) : 20;
+        int child_count = argc > 4 ? atoi(argv[4]) : 8;
+        int attempt_count = argc > 5 ? atoi(argv[5]) : 16;
+        return level_tuner_run(argv[2], fmax(generation_count, 1), fmax(child_count, 1), fmax(attempt_count, 1));
+    }
+
+    // --benchmark-envs [instances] [steps] [threads]
+    if (argc > 1 && strcmp(argv[1], "--benchmark-envs") == 0)
+    {
+        int instance_count = argc > 2 ? atoi(argv[2]) : 64;
+        int step_count = argc > 3 ? atoi(argv[3]) : 500;
+        int worker_count = argc > 4 ? atoi(argv[4]) : sysconf(_SC_NPROCESSORS_ONLN);
+        return envs_benchmark(fmax(instance_count, 1), fmax(step_count, 1), fmax(worker_count, 1));
+    }
+
+    // --benchmark-threads [threads] [level] [attempts]
+    if (argc > 1 && strcmp(argv[1], "--benchmark-threads") == 0)
+    {
+        int thread_count = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+        int level = argc > 3 ? Clamp(atoi(argv[3]) - 1, 0, g_levels_data.LEVEL_COUNT - 1) : 11;
+        int attempt_count = argc > 4 ? atoi(argv[4]) : 8;
+        return games_benchmark_threads(fmax(thread_count, 1), level, fmax(attempt_count, 1));
+    }
+
+    // --benchmark-fork [level]
+    if (argc > 1 && strcmp(argv[1], "--benchmark-fork") == 0)
+    {
+        int level = argc > 2 ? Clamp(atoi(argv[2]) - 1, 0, g_levels_data.LEVEL_COUNT - 1) : 11;
+        return game_fork_benchmark(level);
+    }
+
+    // --benchmark-policy <policy> [level]
+    if (argc > 2 && strcmp(argv[1], "--benchmark-policy") == 0)
+    {
+        int policy = player_policy_find(argv[2]);
+        if (policy <= PLAYER_POLICY_NONE)
         {
-            g_frame_time *= 10;
+            printf("Unknown player policy %s\n", argv[2]);
+            return 1;
         }
-        else if (IsKeyDown(KEY_U))
+
+        int level = argc > 3 ? Clamp(atoi(argv[3]) - 1, 0, g_levels_data.LEVEL_COUNT - 1) : 11;
+        return player_policy_benchmark(game, policy, level);
+    }
+
+    // Only the game played in the window records, the tools above play headless games
+    game->recorders = &g_recorders;
+
+    if (argc > 2 && strcmp(argv[1], "--record-replay") == 0)
+    {
+        g_recorders.replay_path = argv[2];
+    }
+
+    // The policy plays the levels instead of the mouse and keyboard
+    if (argc > 2 && strcmp(argv[1], "--autoplay") == 0)
+    {
+        int policy = player_policy_find(argv[2]);
+        if (policy < 0)
         {
-            g_frame_time *= 25;
+            printf("Unknown player policy %s\n", argv[2]);
+            return 1;
         }
 
-        if(IsKeyPressed(KEY_G))
+        game->player_policy = policy;
+    }
+
+    progress_load(game);
+
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
+    InitWindow(g_window.width, g_window.height, "Arcade Project");
+    SetWindowMinSize(g_window.width / 4, g_window.height / 4);
+    atlas_bake(game);
+
+    sim_thread_start(game);
+
+    while (!WindowShouldClose())
+    {
+        frame_limiter_wait();
+        render_target_update();
+
+        Sim_Input_t input = {0};
+        sim_input_poll(game, &input);
+        frame_limiter_note_input();
+        atomic_store(&g_turbo.is_requested, IsKeyDown(KEY_U));
+
+        g_mouse_position = input.mouse_position;
+
+        render_target_begin_frame();
+
+        if (g_sim_thread.owns_simulation)
         {
-            g_enemy_spawn_director.next_level++;
+            sim_thread_push_input(&input);
+
+            const Sim_Snapshot_t *snapshot = sim_snapshot_acquire();
+            render_view_use_snapshot(snapshot);
+            level_draw(game);
 
-            if(g_enemy_spawn_director.next_level > g_enemy_spawn_director.max_level)
+            if (snapshot->is_final)
             {
-                g_enemy_spawn_director.next_level = g_enemy_spawn_director.max_level;
+                sim_thread_pause();
             }
-        }
 
-        if(IsKeyPressed(KEY_T))
-        {
-            g_enemy_spawn_director.next_level = g_enemy_spawn_director.max_level;
+            DrawText("Hold H to show cheats", 20, g_window.height - 30, 20, SKYBLUE);
+
+            if (IsKeyDown(KEY_H))
+            {
+                draw_cheat_keys();
+            }
+
+            render_target_end_frame();
+
+            continue;
         }
 
-        if(IsKeyPressed(KEY_R))
+        game->sim_input = input;
+        game->frame_time = GetFrameTime() * input.time_scale;
+
+        // A running level applies them in level_tick()
+        if (!sim_level_is_running(game))
         {
-            g_enemy_spawn_director.next_level = 0;
+            sim_input_apply_cheats(game);
         }
-        
-
-        g_mouse_position = GetMousePosition();
 
-        BeginDrawing();
-        ClearBackground(BLACK);
-        DrawText("Hold H to show cheats", 20, g_window.height - 30, 20, SKYBLUE);
+        render_view_use_live(game);
 
-        if (g_transition_time < g_transition_duration)
+        if (game->transition_time < game->transition_duration)
         {
-            transition_update();
+            transition_update(game);
+
+            DrawText("Hold H to show cheats", 20, g_window.height - 30, 20, SKYBLUE);
 
             if (IsKeyDown(KEY_H))
             {
                 draw_cheat_keys();
             }
 
-            EndDrawing();
+            render_target_end_frame();
 
             continue;
         }
 
-        update_current_state();
+        update_current_state(game);
+
+        DrawText("Hold H to show cheats", 20, g_window.height - 30, 20, SKYBLUE);
 
         if (IsKeyDown(KEY_H))
         {
             draw_cheat_keys();
         }
 
-        EndDrawing();
+        render_target_end_frame();
     }
+
+    sim_thread_stop();
+    progress_save(game);
+    free(game);
 }
\ No newline at end of file